@@ -67,16 +67,15 @@ int main()
 	SDL_Event e;
 	while (!quit)
 	{
+		// drain every pending event first, then draw the frame once
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
 				quit = true;
-
-			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			SDL_GL_SwapWindow( gWindow );
-
 		}
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		SDL_GL_SwapWindow( gWindow );
 	}
 
 	SDL_DestroyWindow( gWindow );
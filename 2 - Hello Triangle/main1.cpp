@@ -147,19 +147,18 @@ int main()
 	SDL_Event e;
 	while (!quit)
 	{
+		// drain every pending event first, then draw the frame once
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
 				quit = true;
-
-			glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			glUseProgram(shaderProgram);
-			glBindVertexArray(VAO);
-			glDrawArrays(GL_TRIANGLES, 0, 3);
-			SDL_GL_SwapWindow( gWindow );
-
 		}
+		glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glUseProgram(shaderProgram);
+		glBindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		SDL_GL_SwapWindow( gWindow );
 	}
 
     // optional: de-allocate all resources once they've outlived their purpose:
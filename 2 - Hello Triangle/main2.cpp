@@ -157,20 +157,19 @@ int main()
 	SDL_Event e;
 	while (!quit)
 	{
+		// drain every pending event first, then draw the frame once
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
 				quit = true;
-
-			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			glUseProgram(shaderProgram);
-			glBindVertexArray(VAO);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-			SDL_GL_SwapWindow( gWindow );
-
 		}
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glUseProgram(shaderProgram);
+		glBindVertexArray(VAO);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		SDL_GL_SwapWindow( gWindow );
 	}
 
     // optional: de-allocate all resources once they've outlived their purpose:
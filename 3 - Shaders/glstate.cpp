@@ -0,0 +1,206 @@
+#include "glstate.h"
+
+GLState gGLState;
+
+GLState::GLState()
+    : frames(0)
+{
+    invalidate();
+}
+
+void GLState::invalidate()
+{
+    program = vao = arrayBuffer = elementBuffer = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (unsigned int i = 0; i < MAX_UNITS; i++)
+        for (int t = 0; t < TEX_TARGETS; t++)
+            textures[i][t] = UNKNOWN;
+    depthTest = blend = -1;
+    clearKnown = false;
+}
+
+bool GLState::changed(GLuint &shadow, GLuint value)
+{
+    if (shadow == value)
+    {
+        frame.elided++;
+        return false;
+    }
+    shadow = value;
+    frame.issued++;
+    return true;
+}
+
+void GLState::useProgram(GLuint id)
+{
+    if (changed(program, id))
+        glUseProgram(id);
+}
+
+void GLState::bindVertexArray(GLuint id)
+{
+    if (changed(vao, id))
+    {
+        glBindVertexArray(id);
+        // the element buffer binding is part of the VAO
+        elementBuffer = UNKNOWN;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+    GLuint* shadow = target == GL_ARRAY_BUFFER ? &arrayBuffer : target == GL_ELEMENT_ARRAY_BUFFER ? &elementBuffer : NULL;
+    if (!shadow)
+    {
+        frame.issued++;
+        glBindBuffer(target, buffer);
+    }
+    else if (changed(*shadow, buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::activeTexture(GLenum unit)
+{
+    if (changed(activeUnit, unit))
+        glActiveTexture(unit);
+}
+
+void GLState::bindTexture(unsigned int unit, GLenum target, GLuint texture)
+{
+    int index = targetIndex(target);
+    if (unit >= MAX_UNITS || index < 0)
+    {
+        activeTexture(GL_TEXTURE0 + unit);
+        frame.issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (textures[unit][index] == texture)
+    {
+        frame.elided++;
+        return;
+    }
+    activeTexture(GL_TEXTURE0 + unit);
+    changed(textures[unit][index], texture);
+    glBindTexture(target, texture);
+}
+
+int* GLState::capShadow(GLenum cap)
+{
+    if (cap == GL_DEPTH_TEST)
+        return &depthTest;
+    if (cap == GL_BLEND)
+        return &blend;
+    return NULL;
+}
+
+void GLState::enable(GLenum cap)
+{
+    int* shadow = capShadow(cap);
+    if (shadow && *shadow == 1)
+    {
+        frame.elided++;
+        return;
+    }
+    if (shadow)
+        *shadow = 1;
+    frame.issued++;
+    glEnable(cap);
+}
+
+void GLState::disable(GLenum cap)
+{
+    int* shadow = capShadow(cap);
+    if (shadow && *shadow == 0)
+    {
+        frame.elided++;
+        return;
+    }
+    if (shadow)
+        *shadow = 0;
+    frame.issued++;
+    glDisable(cap);
+}
+
+void GLState::clearColor(float r, float g, float b, float a)
+{
+    if (clearKnown && clear[0] == r && clear[1] == g && clear[2] == b && clear[3] == a)
+    {
+        frame.elided++;
+        return;
+    }
+    clear[0] = r;
+    clear[1] = g;
+    clear[2] = b;
+    clear[3] = a;
+    clearKnown = true;
+    frame.issued++;
+    glClearColor(r, g, b, a);
+}
+
+// deleting a bound object reverts that binding to 0
+void GLState::deleteProgram(GLuint id)
+{
+    if (program == id)
+        program = 0;
+    glDeleteProgram(id);
+}
+
+void GLState::deleteVertexArrays(GLsizei n, const GLuint* vaos)
+{
+    for (GLsizei i = 0; i < n; i++)
+        if (vao == vaos[i])
+        {
+            vao = 0;
+            // the element buffer binding went with it, as in bindVertexArray()
+            elementBuffer = UNKNOWN;
+        }
+    glDeleteVertexArrays(n, vaos);
+}
+
+void GLState::deleteBuffers(GLsizei n, const GLuint* buffers)
+{
+    for (GLsizei i = 0; i < n; i++)
+    {
+        if (arrayBuffer == buffers[i])
+            arrayBuffer = 0;
+        if (elementBuffer == buffers[i])
+            elementBuffer = 0;
+    }
+    glDeleteBuffers(n, buffers);
+}
+
+void GLState::deleteTextures(GLsizei n, const GLuint* ids)
+{
+    for (GLsizei i = 0; i < n; i++)
+        for (unsigned int u = 0; u < MAX_UNITS; u++)
+            for (int t = 0; t < TEX_TARGETS; t++)
+                if (textures[u][t] == ids[i])
+                    textures[u][t] = 0;
+    glDeleteTextures(n, ids);
+}
+
+void GLState::endFrame()
+{
+    total.issued += frame.issued;
+    total.elided += frame.elided;
+    frame = GLStateCounters();
+    frames++;
+}
+
+void GLState::printStats(std::ostream &out) const
+{
+    double n = frames ? (double)frames : 1.0;
+    out << "GL state calls per frame: " << total.issued / n << " issued, " << total.elided / n << " elided" << std::endl;
+}
+
+int GLState::targetIndex(GLenum target)
+{
+    switch (target)
+    {
+        case GL_TEXTURE_2D: return TEX_2D;
+        case GL_TEXTURE_2D_ARRAY: return TEX_2D_ARRAY;
+        case GL_TEXTURE_CUBE_MAP: return TEX_CUBE_MAP;
+        default: return -1;
+    }
+}
@@ -1,4 +1,5 @@
 #include "glad/glad.h"
+#include "glstate.h"
 #include <SDL2/SDL.h>
 #include <iostream>
 #include <math.h>
@@ -130,50 +131,51 @@ int main()
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
+    gGLState.bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, 0); 
 
     // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0); 	
+    gGLState.bindVertexArray(0); 	
 
+	// the uniform location doesn't change after linking, look it up once
+	int vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
 	bool quit = false;
 	SDL_Event e;
 	while (!quit)
 	{
+		// drain every pending event first, then draw the frame once
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
 				quit = true;
-
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			glUseProgram(shaderProgram);
-
-            float timeValue = SDL_GetTicks() / 1000.0f;
-            float greenValue = sin(timeValue)/2.0f + 0.5f;
-            int vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
-            glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
-
-			glBindVertexArray(VAO);
-			glDrawArrays(GL_TRIANGLES, 0, 3);
-			SDL_GL_SwapWindow( gWindow );
-
 		}
+		gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		gGLState.useProgram(shaderProgram);
+
+        float timeValue = SDL_GetTicks() / 1000.0f;
+        float greenValue = sin(timeValue)/2.0f + 0.5f;
+        glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
+
+		gGLState.bindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		SDL_GL_SwapWindow( gWindow );
+		gGLState.endFrame();
 	}
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    gGLState.deleteVertexArrays(1, &VAO);
+    gGLState.deleteBuffers(1, &VBO);
 
 	SDL_DestroyWindow( gWindow );
 	gWindow = NULL;
@@ -52,6 +52,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    // cache every active uniform so the setters never have to query GL
+    uniforms.reflect(ID);
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -59,20 +61,56 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 
 void Shader::use() 
 { 
-    glUseProgram(ID);
+    gGLState.useProgram(ID);
+}
+
+GLint Shader::uniform(const std::string &name) const
+{
+    return uniforms.location(name);
+}
+
+void Shader::setBool(GLint location, bool value) const
+{
+    glUniform1i(location, (int)value);
+}
+void Shader::setInt(GLint location, int value) const
+{
+    glUniform1i(location, value);
+}
+void Shader::setFloat(GLint location, float value) const
+{
+    glUniform1f(location, value);
+}
+
+bool Shader::require(std::initializer_list<UniformId> ids) const
+{
+    return uniforms.check(ids.begin(), ids.size(), ID);
+}
+
+void Shader::setBool(UniformId id, bool value) const
+{
+    setBool(uniforms.location(id), value);
+}
+void Shader::setInt(UniformId id, int value) const
+{
+    setInt(uniforms.location(id), value);
+}
+void Shader::setFloat(UniformId id, float value) const
+{
+    setFloat(uniforms.location(id), value);
 }
 
 void Shader::setBool(const std::string &name, bool value) const
-{         
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+{ 
+    setBool(uniforms.location(name), value); 
 }
 void Shader::setInt(const std::string &name, int value) const
 { 
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    setInt(uniforms.location(name), value); 
 }
 void Shader::setFloat(const std::string &name, float value) const
 { 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    setFloat(uniforms.location(name), value); 
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
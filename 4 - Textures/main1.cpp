@@ -1,5 +1,7 @@
 #include "glad/glad.h"
 #include "shader.h"
+#include "texture_upload.h"
+#include "sampler_cache.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <iostream>
@@ -72,26 +74,20 @@ int main()
 		}
 	}
 
+	// Wrapping/filtering lives in one shared sampler object rather than on each texture
+	SamplerCache samplers;
+	samplers.init();
+	const SamplerDesc linearSampler(GL_REPEAT, GL_LINEAR, GL_LINEAR, false);
+
 	//Load texture
 	unsigned int texture;
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture);
 
 	SDL_Surface* image = IMG_Load("texture.jpg");
-	int mode = GL_RGB;
-	if(image->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image->pixels)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image->w, image->h, 0, mode, GL_UNSIGNED_BYTE, image->pixels);
+	// sized format and channel order come from the surface itself, see texture_upload.h
+	if(image && uploadSurface(GL_TEXTURE_2D, image))
 		glGenerateMipmap(GL_TEXTURE_2D);
-	}
 	else
 		std::cout << "Failed to load texture" << std::endl;
 
@@ -115,12 +111,12 @@ int main()
     glGenBuffers(1, &VBO);
     glGenBuffers(1,&EBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
+    gGLState.bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
     // position attribute
@@ -134,37 +130,38 @@ int main()
     glEnableVertexAttribArray(2);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, 0); 
 
     // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0); 	
+    gGLState.bindVertexArray(0); 	
 
 	bool quit = false;
 	SDL_Event e;
 	while (!quit)
 	{
+		// drain every pending event first, then draw the frame once
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
 				quit = true;
-
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			ourShader.use();
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture);
-			glBindVertexArray(VAO);
-			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-			SDL_GL_SwapWindow( gWindow );
-
 		}
+		gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		ourShader.use();
+		gGLState.bindTexture(0, GL_TEXTURE_2D, texture);
+		samplers.bind(0, linearSampler);
+		gGLState.bindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		SDL_GL_SwapWindow( gWindow );
+		gGLState.endFrame();
 	}
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    gGLState.deleteVertexArrays(1, &VAO);
+    gGLState.deleteBuffers(1, &VBO);
+    samplers.release();
 
 	SDL_DestroyWindow( gWindow );
 	gWindow = NULL;
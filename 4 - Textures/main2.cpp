@@ -1,5 +1,7 @@
 #include "glad/glad.h"
 #include "shader.h"
+#include "texture_upload.h"
+#include "sampler_cache.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <iostream>
@@ -72,46 +74,29 @@ int main()
 		}
 	}
 
+	// Wrapping/filtering lives in one shared sampler object rather than on each texture
+	SamplerCache samplers;
+	samplers.init();
+	const SamplerDesc linearSampler(GL_REPEAT, GL_LINEAR, GL_LINEAR, false);
+
 	//Load texture
 	unsigned int texture1, texture2;
 	glGenTextures(1, &texture1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
 
 	SDL_Surface* image1 = IMG_Load("texture.jpg");
-	int mode = GL_RGB;
-	if(image1->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image1->pixels)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image1->w, image1->h, 0, mode, GL_UNSIGNED_BYTE, image1->pixels);
+	// sized format and channel order come from the surface itself, see texture_upload.h
+	if(image1 && uploadSurface(GL_TEXTURE_2D, image1))
 		glGenerateMipmap(GL_TEXTURE_2D);
-	}
 	else
 		std::cout << "Failed to load texture 1" << std::endl;
 
     glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture2);
 
 	SDL_Surface* image2 = IMG_Load("awesomeface.png");
-	if(image2->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image2->pixels)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image2->w, image2->h, 0, mode, GL_UNSIGNED_BYTE, image2->pixels);
+	if(image2 && uploadSurface(GL_TEXTURE_2D, image2))
 		glGenerateMipmap(GL_TEXTURE_2D);
-	}
 	else
 		std::cout << "Failed to load texture 2" << std::endl;
 
@@ -138,12 +123,12 @@ int main()
     glGenBuffers(1, &VBO);
     glGenBuffers(1,&EBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
+    gGLState.bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
     // position attribute
@@ -157,43 +142,44 @@ int main()
     glEnableVertexAttribArray(2);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, 0); 
 
     // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0); 	
+    gGLState.bindVertexArray(0); 	
 
 	ourShader.use();
-	glUniform1i(glGetUniformLocation(ourShader.ID, "texture1"), 0);
+	ourShader.setInt("texture1", 0);
 	ourShader.setInt("texture2", 1);
 
 	bool quit = false;
 	SDL_Event e;
 	while (!quit)
 	{
+		// drain every pending event first, then draw the frame once
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
 				quit = true;
-
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture1);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texture2);
-			ourShader.use();
-			glBindVertexArray(VAO);
-			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-			SDL_GL_SwapWindow( gWindow );
-
 		}
+		gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
+		gGLState.bindTexture(1, GL_TEXTURE_2D, texture2);
+		samplers.bind(0, linearSampler);
+		samplers.bind(1, linearSampler);
+		ourShader.use();
+		gGLState.bindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		SDL_GL_SwapWindow( gWindow );
+		gGLState.endFrame();
 	}
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    gGLState.deleteVertexArrays(1, &VAO);
+    gGLState.deleteBuffers(1, &VBO);
+    samplers.release();
 
 	SDL_DestroyWindow( gWindow );
 	gWindow = NULL;
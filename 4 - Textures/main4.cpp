@@ -1,5 +1,7 @@
 #include "glad/glad.h"
 #include "shader.h"
+#include "texture_loader.h"
+#include "sampler_cache.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <iostream>
@@ -72,51 +74,17 @@ int main()
 		}
 	}
 
-	//Load texture
-	unsigned int texture1, texture2;
-	glGenTextures(1, &texture1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	SDL_Surface* image1 = IMG_Load("texture.jpg");
-	int mode = GL_RGB;
-	if(image1->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image1->pixels)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image1->w, image1->h, 0, mode, GL_UNSIGNED_BYTE, image1->pixels);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
-		std::cout << "Failed to load texture 1" << std::endl;
-
-    glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	//Load textures: images are decoded on worker threads and show a placeholder until uploaded
+	ThreadPool workers;
+	TextureLoader textures(workers);
+	textures.init();
+	unsigned int texture1 = textures.load("texture.jpg");
+	unsigned int texture2 = textures.load("awesomeface.png");
 
-	SDL_Surface* image2 = IMG_Load("awesomeface.png");
-	if(image2->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image2->pixels)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image2->w, image2->h, 0, mode, GL_UNSIGNED_BYTE, image2->pixels);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
-		std::cout << "Failed to load texture 2" << std::endl;
-
-	SDL_FreeSurface(image1);
-	SDL_FreeSurface(image2);
+	// Wrapping/filtering lives in one shared sampler object rather than on each texture
+	SamplerCache samplers;
+	samplers.init();
+	const SamplerDesc repeatSampler(GL_REPEAT);
 
 	Shader ourShader("shader.vert", "shader4.frag");
 
@@ -138,12 +106,12 @@ int main()
     glGenBuffers(1, &VBO);
     glGenBuffers(1,&EBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
+    gGLState.bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
     // position attribute
@@ -157,14 +125,14 @@ int main()
     glEnableVertexAttribArray(2);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, 0);
 
     // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0); 	
+    gGLState.bindVertexArray(0);
 
 	ourShader.use();
-	glUniform1i(glGetUniformLocation(ourShader.ID, "texture1"), 0);
+	ourShader.setInt("texture1", 0);
 	ourShader.setInt("texture2", 1);
 
 	bool quit = false;
@@ -172,6 +140,8 @@ int main()
 	float mixValue = 0.5f;
 	while (!quit)
 	{
+		// keep redrawing while textures are still streaming in, otherwise only when input arrives
+		bool redraw = textures.busy();
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
@@ -180,26 +150,34 @@ int main()
 				mixValue += 0.02;
 			if( e.key.keysym.sym == SDLK_DOWN && mixValue > 0.0f)
 				mixValue -= 0.02;
-
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+			redraw = true;
+		}
+		if (redraw)
+		{
+			textures.update();
+			gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture1);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texture2);
-			ourShader.setFloat("mixpercent", mixValue);
+			gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
+			gGLState.bindTexture(1, GL_TEXTURE_2D, texture2);
+			samplers.bind(0, repeatSampler);
+			samplers.bind(1, repeatSampler);
 			ourShader.use();
-			glBindVertexArray(VAO);
+			ourShader.setFloat("mixpercent", mixValue);
+			gGLState.bindVertexArray(VAO);
 			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 			SDL_GL_SwapWindow( gWindow );
-
+			gGLState.endFrame();
 		}
 	}
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    gGLState.deleteVertexArrays(1, &VAO);
+    gGLState.deleteBuffers(1, &VBO);
+    gGLState.printStats(std::cout);
+    textures.stats().print(std::cout);
+    textures.release();
+    samplers.release();
 
 	SDL_DestroyWindow( gWindow );
 	gWindow = NULL;
@@ -6,20 +6,37 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <initializer_list>
+#include "uniforms.h"
+#include "glstate.h"
 
 class Shader
 {
 public:
     // the program ID
     unsigned int ID;
+    // active uniforms reflected after linking
+    UniformTable uniforms;
   
     // constructor reads and builds the shader
     Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
     // use/activate the shader
     void use();
-    // utility uniform functions
-    void setBool(const std::string &name, bool value) const;  
-    void setInt(const std::string &name, int value) const;   
+    // resolve a uniform handle once, -1 if the program has no such uniform
+    GLint uniform(const std::string &name) const;
+    // utility uniform functions taking a pre-resolved handle
+    void setBool(GLint location, bool value) const;
+    void setInt(GLint location, int value) const;
+    void setFloat(GLint location, float value) const;
+    // warns about every id the linked program doesn't have, call it once after construction
+    bool require(std::initializer_list<UniformId> ids) const;
+    // utility uniform functions taking a name hashed at compile time
+    void setBool(UniformId id, bool value) const;
+    void setInt(UniformId id, int value) const;
+    void setFloat(UniformId id, float value) const;
+    // utility uniform functions looking the name up in the uniform cache
+    void setBool(const std::string &name, bool value) const;
+    void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
 
 private:
@@ -0,0 +1,205 @@
+#include "texture_loader.h"
+#include "glstate.h"
+#include <SDL2/SDL_image.h>
+#include <string.h>
+
+// magenta and black checker shown until the real image arrives
+static const unsigned char placeholder[] = {
+    255, 0, 255, 255,   0, 0, 0, 255,
+    0, 0, 0, 255,       255, 0, 255, 255
+};
+
+static double elapsedMs(Uint64 since)
+{
+    return (SDL_GetPerformanceCounter() - since) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+TextureLoaderStats::TextureLoaderStats()
+    : requested(0), uploaded(0), failed(0), bytesUploaded(0), decodeMs(0.0), uploadMs(0.0), residentMs(0.0), residentFrames(0)
+{
+}
+
+void TextureLoaderStats::print(std::ostream &out) const
+{
+    out << "Textures: " << requested << " requested, " << uploaded << " uploaded, " << failed << " failed, "
+        << bytesUploaded / 1024 << " KB staged" << std::endl;
+    out << "Texture loading (ms): decode " << decodeMs << " on workers, upload " << uploadMs << " on GL thread, all resident after "
+        << residentMs << " (" << residentFrames << " frames)" << std::endl;
+}
+
+TextureLoader::TextureLoader(ThreadPool &pool, double budgetMs, unsigned int stagingBuffers)
+    : pool(pool), budgetMs(budgetMs), staging(stagingBuffers), nextStaging(0), firstRequest(0), frames(0)
+{
+}
+
+void TextureLoader::init()
+{
+    for (size_t i = 0; i < staging.size(); i++)
+    {
+        glGenBuffers(1, &staging[i].pbo);
+        staging[i].capacity = 0;
+        staging[i].fence = 0;
+    }
+}
+
+void TextureLoader::release()
+{
+    pool.wait();
+    for (size_t i = 0; i < ready.size(); i++)
+        SDL_FreeSurface(ready[i].surface);
+    ready.clear();
+    for (size_t i = 0; i < staging.size(); i++)
+    {
+        if (staging[i].fence)
+            glDeleteSync(staging[i].fence);
+        gGLState.deleteBuffers(1, &staging[i].pbo);
+        staging[i].pbo = 0;
+        staging[i].fence = 0;
+    }
+}
+
+GLuint TextureLoader::load(const std::string &path)
+{
+    if (loaderStats.requested == 0)
+        firstRequest = SDL_GetPerformanceCounter();
+    loaderStats.requested++;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gGLState.bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    // a single level, so the placeholder stays complete under mipmapped sampler filtering
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    pool.submit([this, texture, path] { decode(texture, path); });
+    return texture;
+}
+
+bool TextureLoader::busy() const
+{
+    return loaderStats.uploaded + loaderStats.failed < loaderStats.requested;
+}
+
+void TextureLoader::decode(GLuint texture, const std::string &path)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    Decoded image;
+    image.texture = texture;
+    image.path = path;
+    image.surface = NULL;
+    image.surface = IMG_Load(path.c_str());
+    if (image.surface)
+    {
+        // most formats are handed to GL as they are, only the ones it can't read are converted here
+        GLint alignment, rowLength;
+        if (!surfaceFormat(image.surface, image.format) ||
+            !unpackPitch(image.surface->w, image.format.bytesPerPixel, image.surface->pitch, alignment, rowLength))
+        {
+            // the RGBA32 copy always has a direct GL format
+            SDL_Surface* converted = convertForUpload(image.surface);
+            SDL_FreeSurface(image.surface);
+            image.surface = converted;
+            if (converted)
+                surfaceFormat(converted, image.format);
+        }
+    }
+    image.decodeMs = elapsedMs(start);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.push_back(image);
+}
+
+void TextureLoader::update()
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    bool wasBusy = busy();
+    frames++;
+
+    unsigned int uploads = 0;
+    for (;;)
+    {
+        Decoded image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready.empty())
+                break;
+            image = ready.front();
+        }
+        if (image.surface)
+        {
+            if (uploads > 0 && elapsedMs(start) >= budgetMs)
+                break;
+            // the next staging buffer may still be read by an earlier upload, try again next frame
+            Staging &buffer = staging[nextStaging];
+            if (buffer.fence)
+            {
+                if (glClientWaitSync(buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                    break;
+                glDeleteSync(buffer.fence);
+                buffer.fence = 0;
+            }
+            upload(image, buffer);
+            nextStaging = (nextStaging + 1) % staging.size();
+            uploads++;
+        }
+        else
+        {
+            std::cout << "Failed to load texture " << image.path << std::endl;
+            loaderStats.failed++;
+        }
+        loaderStats.decodeMs += image.decodeMs;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.pop_front();
+        }
+    }
+
+    loaderStats.uploadMs += elapsedMs(start);
+    if (wasBusy && !busy())
+    {
+        loaderStats.residentMs = elapsedMs(firstRequest);
+        loaderStats.residentFrames = frames;
+    }
+}
+
+void TextureLoader::upload(const Decoded &image, Staging &buffer)
+{
+    SDL_Surface* surface = image.surface;
+    GLsizeiptr bytes = (GLsizeiptr)surface->pitch * surface->h;
+
+    gGLState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo);
+    if (buffer.capacity < bytes)
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        buffer.capacity = bytes;
+    }
+    // the fence has signalled, so invalidating lets the driver hand back the same storage without a stall
+    unsigned char* dst = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst)
+    {
+        // rows are copied with their padding, the unpack row length skips it on the GL side
+        memcpy(dst, surface->pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        // with a pixel unpack buffer bound the data pointer is an offset into it
+        gGLState.bindTexture(0, GL_TEXTURE_2D, image.texture);
+        const SurfaceFormat &format = image.format;
+        setUnpackPitch(surface->w, format.bytesPerPixel, surface->pitch);
+        glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, surface->w, surface->h, 0, format.format, format.type, (void*)0);
+        resetUnpack();
+        applySwizzle(GL_TEXTURE_2D, format);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        loaderStats.uploaded++;
+        loaderStats.bytesUploaded += bytes;
+    }
+    else
+    {
+        std::cout << "Failed to map staging buffer for " << image.path << std::endl;
+        loaderStats.failed++;
+    }
+    // leaving it bound would turn every later client-memory upload into a buffer offset
+    gGLState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    SDL_FreeSurface(surface);
+}
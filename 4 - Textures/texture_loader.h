@@ -0,0 +1,82 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include "thread_pool.h"
+#include "texture_upload.h"
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TextureLoaderStats
+{
+    unsigned int requested;
+    unsigned int uploaded;
+    unsigned int failed;
+    size_t bytesUploaded;
+    double decodeMs;            // summed over all workers
+    double uploadMs;            // time spent on the GL thread in update()
+    double residentMs;          // from the first load() until the last texture was uploaded
+    unsigned long residentFrames;
+
+    TextureLoaderStats();
+    void print(std::ostream &out) const;
+};
+
+// Decodes images on a ThreadPool and finishes the uploads on the GL thread. load() returns a texture
+// name straight away that shows a placeholder until update() has replaced its contents, so startup
+// doesn't wait for any image. Decoded pixels go through a small ring of pixel unpack buffers that are
+// reused for every upload; a fence per buffer tells when the driver is done reading it
+class TextureLoader
+{
+public:
+    // budgetMs caps the GL thread time update() spends per frame, at least one upload is always made
+    TextureLoader(ThreadPool &pool, double budgetMs = 2.0, unsigned int stagingBuffers = 2);
+
+    // create the staging buffers, needs a current context
+    void init();
+    // wait for outstanding decodes and free the staging buffers, call before the context is destroyed
+    void release();
+
+    // queue path for decoding and return its texture, bound to unit 0 so parameters can be set right away
+    GLuint load(const std::string &path);
+    // upload decoded images until the frame budget is used up, call once per frame on the GL thread
+    void update();
+    // true while some requested texture still shows the placeholder
+    bool busy() const;
+    const TextureLoaderStats& stats() const { return loaderStats; }
+
+private:
+    struct Decoded
+    {
+        GLuint texture;
+        std::string path;
+        SDL_Surface* surface;   // image in a format GL reads directly, NULL if decoding failed
+        SurfaceFormat format;   // how to describe surface to GL
+        double decodeMs;
+    };
+    struct Staging
+    {
+        GLuint pbo;
+        GLsizeiptr capacity;
+        GLsync fence;           // set after an upload, the buffer is free again once it has signalled
+    };
+
+    ThreadPool &pool;
+    double budgetMs;
+    std::vector<Staging> staging;
+    size_t nextStaging;
+    std::mutex mutex;
+    std::deque<Decoded> ready;  // filled by workers, drained by update()
+    TextureLoaderStats loaderStats;
+    Uint64 firstRequest;
+    unsigned long frames;
+
+    void decode(GLuint texture, const std::string &path);
+    void upload(const Decoded &image, Staging &buffer);
+};
+
+#endif
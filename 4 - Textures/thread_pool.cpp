@@ -0,0 +1,64 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned int threads)
+    : active(0), stopping(false)
+{
+    if (threads == 0)
+    {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 1;
+    }
+    for (unsigned int i = 0; i < threads; i++)
+        workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::submit(const std::function<void()> &job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return jobs.empty() && active == 0; });
+}
+
+void ThreadPool::work()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            // finish whatever is queued before shutting down
+            if (jobs.empty())
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+            active++;
+        }
+        job();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+            if (jobs.empty() && active == 0)
+                idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#include "sampler_cache.h"
+#include "glstate.h"
+#include <string.h>
+
+SamplerDesc::SamplerDesc(GLenum wrap, GLenum minFilter, GLenum magFilter, bool anisotropic)
+    : wrapS(wrap), wrapT(wrap), wrapR(wrap), minFilter(minFilter), magFilter(magFilter),
+      compareMode(GL_NONE), compareFunc(GL_LEQUAL), lodBias(0.0f), anisotropic(anisotropic)
+{
+}
+
+bool SamplerDesc::operator==(const SamplerDesc &other) const
+{
+    return wrapS == other.wrapS && wrapT == other.wrapT && wrapR == other.wrapR &&
+           minFilter == other.minFilter && magFilter == other.magFilter &&
+           compareMode == other.compareMode && compareFunc == other.compareFunc &&
+           lodBias == other.lodBias && anisotropic == other.anisotropic;
+}
+
+static void hashBytes(size_t &hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+}
+
+size_t SamplerDescHash::operator()(const SamplerDesc &desc) const
+{
+    // field by field, the struct's padding bytes are undefined
+    size_t hash = 2166136261u;
+    hashBytes(hash, &desc.wrapS, sizeof(desc.wrapS));
+    hashBytes(hash, &desc.wrapT, sizeof(desc.wrapT));
+    hashBytes(hash, &desc.wrapR, sizeof(desc.wrapR));
+    hashBytes(hash, &desc.minFilter, sizeof(desc.minFilter));
+    hashBytes(hash, &desc.magFilter, sizeof(desc.magFilter));
+    hashBytes(hash, &desc.compareMode, sizeof(desc.compareMode));
+    hashBytes(hash, &desc.compareFunc, sizeof(desc.compareFunc));
+    hashBytes(hash, &desc.lodBias, sizeof(desc.lodBias));
+    hashBytes(hash, &desc.anisotropic, sizeof(desc.anisotropic));
+    return hash;
+}
+
+SamplerCache::SamplerCache()
+    : level(1.0f), maxLevel(1.0f), supported(false), lookups(0)
+{
+}
+
+void SamplerCache::init()
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count && !supported; i++)
+    {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        supported = strcmp(name, "GL_EXT_texture_filter_anisotropic") == 0 || strcmp(name, "GL_ARB_texture_filter_anisotropic") == 0;
+    }
+    if (supported)
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxLevel);
+    level = maxLevel;
+}
+
+void SamplerCache::release()
+{
+    for (std::unordered_map<SamplerDesc, GLuint, SamplerDescHash>::iterator it = samplers.begin(); it != samplers.end(); ++it)
+        gGLState.deleteSamplers(1, &it->second);
+    samplers.clear();
+}
+
+GLuint SamplerCache::get(const SamplerDesc &desc)
+{
+    lookups++;
+    std::unordered_map<SamplerDesc, GLuint, SamplerDescHash>::iterator it = samplers.find(desc);
+    if (it != samplers.end())
+        return it->second;
+
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, desc.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, desc.wrapT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, desc.wrapR);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, desc.minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, desc.compareMode);
+    glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_FUNC, desc.compareFunc);
+    glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, desc.lodBias);
+    if (desc.anisotropic && supported)
+        glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, level);
+    samplers[desc] = sampler;
+    return sampler;
+}
+
+void SamplerCache::bind(unsigned int unit, const SamplerDesc &desc)
+{
+    gGLState.bindSampler(unit, get(desc));
+}
+
+void SamplerCache::setAnisotropy(float newLevel)
+{
+    newLevel = newLevel < 1.0f ? 1.0f : newLevel > maxLevel ? maxLevel : newLevel;
+    if (newLevel == level || !supported)
+        return;
+    level = newLevel;
+    for (std::unordered_map<SamplerDesc, GLuint, SamplerDescHash>::iterator it = samplers.begin(); it != samplers.end(); ++it)
+        if (it->first.anisotropic)
+            glSamplerParameterf(it->second, GL_TEXTURE_MAX_ANISOTROPY_EXT, level);
+}
+
+void SamplerCache::printStats(std::ostream &out) const
+{
+    out << "Samplers: " << samplers.size() << " shared objects for " << lookups << " lookups, anisotropy ";
+    if (supported)
+        out << level << "x (max " << maxLevel << "x)" << std::endl;
+    else
+        out << "not supported" << std::endl;
+}
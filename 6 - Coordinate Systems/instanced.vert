@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in mat4 aModel;	// per-instance, takes locations 2-5
+
+out vec2 TexCoord;
+
+// shared by every program, see frame_uniforms.h
+layout (std140) uniform PerFrame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec3 cameraPos;
+    float time;
+};
+
+void main()
+{
+    gl_Position = viewProj * aModel * vec4(aPos, 1.0);
+    TexCoord = aTexCoord;
+}
\ No newline at end of file
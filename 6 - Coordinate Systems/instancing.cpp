@@ -0,0 +1,51 @@
+#include "instancing.h"
+#include "glstate.h"
+
+InstanceBuffer::InstanceBuffer(GLuint vao, GLuint location)
+    : vao(vao), vbo(0), instances(0), capacity(0)
+{
+    glGenBuffers(1, &vbo);
+    gGLState.bindVertexArray(vao);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    // a mat4 attribute takes four consecutive vec4 locations, one per column
+    for (GLuint i = 0; i < 4; i++)
+    {
+        glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(location + i);
+        // advance once per instance instead of once per vertex
+        glVertexAttribDivisor(location + i, 1);
+    }
+    gGLState.bindVertexArray(0);
+}
+
+void InstanceBuffer::release()
+{
+    gGLState.deleteBuffers(1, &vbo);
+    vbo = 0;
+    instances = capacity = 0;
+}
+
+void InstanceBuffer::update(const glm::mat4* models, size_t n)
+{
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (n > capacity)
+    {
+        glBufferData(GL_ARRAY_BUFFER, n * sizeof(glm::mat4), models, GL_DYNAMIC_DRAW);
+        capacity = n;
+    }
+    else
+    {
+        // orphan the old storage so we don't wait for draws still reading it
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, n * sizeof(glm::mat4), models);
+    }
+    instances = n;
+}
+
+void InstanceBuffer::draw(GLenum mode, GLint first, GLsizei count) const
+{
+    if (instances == 0)
+        return;
+    gGLState.bindVertexArray(vao);
+    glDrawArraysInstanced(mode, first, count, (GLsizei)instances);
+}
@@ -0,0 +1,34 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// Per-instance model matrices stored in a VBO and attached to a VAO as a mat4 attribute with divisor 1,
+// so N copies of a mesh are drawn with a single glDrawArraysInstanced call.
+// The vertex shader reads them with "layout (location = 2) in mat4 aModel;" (locations 2-5 by default)
+class InstanceBuffer
+{
+public:
+    InstanceBuffer(GLuint vao, GLuint location = 2);
+    // free the VBO, call before the GL context is destroyed
+    void release();
+
+    // upload the model matrices, storage is only reallocated when it has to grow
+    void update(const glm::mat4* models, size_t n);
+    // draw one copy of vertices [first, first + count) per uploaded matrix
+    void draw(GLenum mode, GLint first, GLsizei count) const;
+    size_t size() const { return instances; }
+
+private:
+    GLuint vao;
+    GLuint vbo;
+    size_t instances;
+    size_t capacity;
+
+    InstanceBuffer(const InstanceBuffer&);
+    InstanceBuffer& operator=(const InstanceBuffer&);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "glad/glad.h"
 #include "shader.h"
+#include "sampler_cache.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <iostream>
@@ -75,17 +76,17 @@ int main()
 		}
 	}
 
-	glEnable(GL_DEPTH_TEST); 
+	gGLState.enable(GL_DEPTH_TEST); 
+
+	// Wrapping/filtering lives in one shared sampler object rather than on each texture
+	SamplerCache samplers;
+	samplers.init();
+	const SamplerDesc linearSampler(GL_REPEAT, GL_LINEAR, GL_LINEAR, false);
 
 	//Load texture
 	unsigned int texture1, texture2;
 	glGenTextures(1, &texture1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
 
 	SDL_Surface* image1 = IMG_Load("texture.jpg");
 	int mode = GL_RGB;
@@ -101,12 +102,7 @@ int main()
 		std::cout << "Failed to load texture 1" << std::endl;
 
     glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture2);
 
 	SDL_Surface* image2 = IMG_Load("awesomeface.png");
 	if(image2->format->BytesPerPixel == 4)
@@ -175,9 +171,9 @@ int main()
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
+    gGLState.bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     // position attribute
@@ -188,11 +184,11 @@ int main()
     glEnableVertexAttribArray(1);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, 0); 
 
     // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0);
+    gGLState.bindVertexArray(0);
 
 	ourShader.use();
 	ourShader.setInt("texture1", 0);
@@ -200,51 +196,53 @@ int main()
 
     // Transformation Matrix
     glm::mat4 transformMatrix; 
-	unsigned int transformLoc = glGetUniformLocation(ourShader.ID, "transform"); 	
+	GLint transformLoc = ourShader.uniform("transform"); 	
 	// Model Matrix
 	glm::mat4 modelMatrix;
 	modelMatrix = glm::rotate(modelMatrix, glm::radians(-60.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	unsigned int modelLoc = glGetUniformLocation(ourShader.ID, "model");
+	GLint modelLoc = ourShader.uniform("model");
 	// View Matrix (note that we're translating the scene in the reverse direction of where we want to move)
 	glm::mat4 viewMatrix;
 	viewMatrix = glm::translate(viewMatrix, glm::vec3(0.0f, 0.0f, -3.0f));
-	unsigned int viewLoc = glGetUniformLocation(ourShader.ID, "view");
+	GLint viewLoc = ourShader.uniform("view");
 	// Projection Matrix
 	glm::mat4 projectionMatrix;
 	projectionMatrix = glm::perspective(glm::radians(45.0f), float(SCREEN_WIDTH) / float(SCREEN_HEIGHT), 0.1f, 100.0f);
-	unsigned int projectionLoc = glGetUniformLocation(ourShader.ID, "projection"); 
+	GLint projectionLoc = ourShader.uniform("projection"); 
 
 	bool quit = false;
 	SDL_Event e;
 	while (!quit)
 	{
+		// drain every pending event first, then draw the frame once
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
 				quit = true;
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture1);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texture2);
-			ourShader.use();
-			modelMatrix = glm::rotate(modelMatrix, (float(SDL_GetTicks())/1000.0f) * glm::radians(0.1f), glm::vec3(0.5f, 1.0f, 0.0f));
-			glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transformMatrix));
-			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-			glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-			glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-			glBindVertexArray(VAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-			SDL_GL_SwapWindow( gWindow );
-
 		}
+		gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
+		gGLState.bindTexture(1, GL_TEXTURE_2D, texture2);
+		samplers.bind(0, linearSampler);
+		samplers.bind(1, linearSampler);
+		ourShader.use();
+		modelMatrix = glm::rotate(modelMatrix, (float(SDL_GetTicks())/1000.0f) * glm::radians(0.1f), glm::vec3(0.5f, 1.0f, 0.0f));
+		glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transformMatrix));
+		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+		glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+		gGLState.bindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLES, 0, 36);
+		SDL_GL_SwapWindow( gWindow );
+		gGLState.endFrame();
 	}
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    gGLState.deleteVertexArrays(1, &VAO);
+    gGLState.deleteBuffers(1, &VBO);
+    samplers.release();
 
 	SDL_DestroyWindow( gWindow );
 	gWindow = NULL;
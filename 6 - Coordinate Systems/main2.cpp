@@ -1,5 +1,8 @@
 #include "glad/glad.h"
 #include "shader.h"
+#include "instancing.h"
+#include "frame_uniforms.h"
+#include "sampler_cache.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <iostream>
@@ -75,17 +78,17 @@ int main()
 		}
 	}
 
-	glEnable(GL_DEPTH_TEST); 
+	gGLState.enable(GL_DEPTH_TEST);
+
+	// Wrapping/filtering lives in one shared sampler object rather than on each texture
+	SamplerCache samplers;
+	samplers.init();
+	const SamplerDesc linearSampler(GL_REPEAT, GL_LINEAR, GL_LINEAR, false);
 
 	//Load texture
 	unsigned int texture1, texture2;
 	glGenTextures(1, &texture1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
 
 	SDL_Surface* image1 = IMG_Load("texture.jpg");
 	int mode = GL_RGB;
@@ -101,12 +104,7 @@ int main()
 		std::cout << "Failed to load texture 1" << std::endl;
 
     glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture2);
 
 	SDL_Surface* image2 = IMG_Load("awesomeface.png");
 	if(image2->format->BytesPerPixel == 4)
@@ -123,7 +121,7 @@ int main()
 	SDL_FreeSurface(image1);
 	SDL_FreeSurface(image2);
 
-    Shader ourShader("shader.vert", "shader.frag");
+    Shader instancedShader("instanced.vert", "shader.frag");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -188,9 +186,9 @@ int main()
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
+    gGLState.bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     // position attribute
@@ -201,21 +199,16 @@ int main()
     glEnableVertexAttribArray(1);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, 0);
 
     // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0);
+    gGLState.bindVertexArray(0);
 
-	ourShader.use();
-	ourShader.setInt("texture1", 0);
-	ourShader.setInt("texture2", 1);
+	instancedShader.use();
+	instancedShader.setInt("texture1", 0);
+	instancedShader.setInt("texture2", 1);
 
-    // Transformation Matrix
-    glm::mat4 transformMatrix;  	
-	// Model Matrix
-	glm::mat4 modelMatrix;
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(-60.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 	// View Matrix (note that we're translating the scene in the reverse direction of where we want to move)
 	glm::mat4 viewMatrix;
 	viewMatrix = glm::translate(viewMatrix, glm::vec3(0.0f, 0.0f, -3.0f));
@@ -223,45 +216,53 @@ int main()
 	glm::mat4 projectionMatrix;
 	projectionMatrix = glm::perspective(glm::radians(45.0f), float(SCREEN_WIDTH) / float(SCREEN_HEIGHT), 0.1f, 100.0f);
 
+	// the instanced program reads view and projection from the shared per-frame uniform buffer, the
+	// camera never moves so it is uploaded once
+	FrameUniforms frameUniforms;
+	frameUniforms.init();
+	frameUniforms.update(viewMatrix, projectionMatrix, glm::vec3(0.0f, 0.0f, 3.0f), 0.0f);
+	instancedShader.bindUniformBlock("PerFrame", PER_FRAME_BINDING);
+
+	// The cubes never move, so their model matrices are uploaded once and drawn with a single call
+	InstanceBuffer instances(VAO);
+	glm::mat4 cubeModels[10];
+	for(unsigned int i = 0; i < 10; i++)
+	{
+		cubeModels[i] = glm::translate(glm::mat4(1.0f), cubePositions[i]);
+		float angle = 20.0f * i;
+		cubeModels[i] = glm::rotate(cubeModels[i], glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+	}
+	instances.update(cubeModels, 10);
+
 	bool quit = false;
-	float angle;
 	SDL_Event e;
 	while (!quit)
 	{
+		// drain every pending event first, then draw the frame once
 		while( SDL_PollEvent( &e ) != 0 )
 		{
 			if( e.key.keysym.sym == SDLK_ESCAPE )
 				quit = true;
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture1);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texture2);
-			ourShader.use();
-			ourShader.setMat4("model", modelMatrix);
-			ourShader.setMat4("view", viewMatrix);
-			ourShader.setMat4("projection", projectionMatrix);
-			ourShader.setMat4("transform", transformMatrix);
-			glBindVertexArray(VAO);
-			for(unsigned int i = 0; i < 10; i++)
-			{
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, cubePositions[i]);
-				angle = 20.0f * i;
-				modelMatrix = glm::rotate(modelMatrix, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-				ourShader.setMat4("model", modelMatrix);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}	
-			SDL_GL_SwapWindow( gWindow );
-
 		}
+		gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
+		gGLState.bindTexture(1, GL_TEXTURE_2D, texture2);
+		samplers.bind(0, linearSampler);
+		samplers.bind(1, linearSampler);
+		instancedShader.use();
+		instances.draw(GL_TRIANGLES, 0, 36);
+		SDL_GL_SwapWindow( gWindow );
+		gGLState.endFrame();
 	}
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    instances.release();
+    frameUniforms.release();
+    gGLState.deleteVertexArrays(1, &VAO);
+    gGLState.deleteBuffers(1, &VBO);
+    samplers.release();
 
 	SDL_DestroyWindow( gWindow );
 	gWindow = NULL;
@@ -0,0 +1,30 @@
+#ifndef UNIFORM_ID_H
+#define UNIFORM_ID_H
+
+#include <cstddef>
+#include <stdint.h>
+
+// 32-bit FNV-1a, constexpr so uniform names can be hashed by the compiler
+constexpr uint32_t uniformHash(const char* str, uint32_t hash = 2166136261u)
+{
+    return *str ? uniformHash(str + 1, (hash ^ (uint32_t)(unsigned char)*str) * 16777619u) : hash;
+}
+
+// A uniform name hashed at compile time. Declare them constexpr (or use the _u literal in a constexpr
+// context) and pass them to the Shader setters: no std::string is built and nothing is hashed at runtime.
+//     constexpr UniformId uModel = "model"_u;
+//     shader.setMat4(uModel, modelMatrix);
+struct UniformId
+{
+    uint32_t hash;
+    const char* name;   // kept for diagnostics only
+
+    constexpr explicit UniformId(const char* name) : hash(uniformHash(name)), name(name) {}
+};
+
+constexpr UniformId operator"" _u(const char* name, std::size_t)
+{
+    return UniformId(name);
+}
+
+#endif
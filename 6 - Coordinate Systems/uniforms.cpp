@@ -0,0 +1,108 @@
+#include "uniforms.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static bool compareByName(const UniformInfo &a, const UniformInfo &b)
+{
+    return a.name < b.name;
+}
+
+void UniformTable::reflect(unsigned int program)
+{
+    uniforms.clear();
+    hashes.clear();
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength > 0 ? maxLength : 1);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+        std::string uniformName(&name[0], length);
+        GLint location = glGetUniformLocation(program, uniformName.c_str());
+        // uniforms that live in a uniform block have no location
+        if (location < 0)
+            continue;
+        if (!add(uniformName, location, type, size))
+            std::cout << "ERROR::UNIFORM_HASH_COLLISION: " << uniformName << " in program " << program << std::endl;
+        // arrays are reported as "name[0]", also make them reachable as "name"
+        size_t bracket = uniformName.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+            add(uniformName.substr(0, bracket), location, type, size);
+    }
+}
+
+bool UniformTable::add(const std::string &name, GLint location, GLenum type, GLint size)
+{
+    UniformInfo info;
+    info.name = name;
+    info.hash = uniformHash(name.c_str());
+    info.location = location;
+    info.type = type;
+    info.size = size;
+    uniforms.insert(std::upper_bound(uniforms.begin(), uniforms.end(), info, compareByName), info);
+
+    std::pair<uint32_t, GLint> entry(info.hash, location);
+    std::vector<std::pair<uint32_t, GLint> >::iterator it = std::lower_bound(hashes.begin(), hashes.end(), entry);
+    if (it != hashes.end() && it->first == info.hash)
+        return false;
+    hashes.insert(it, entry);
+    return true;
+}
+
+const UniformInfo* UniformTable::find(const char* name) const
+{
+    size_t lo = 0, hi = uniforms.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        int cmp = std::strcmp(uniforms[mid].name.c_str(), name);
+        if (cmp == 0)
+            return &uniforms[mid];
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+GLint UniformTable::location(const char* name) const
+{
+    const UniformInfo* info = find(name);
+    return info ? info->location : -1;
+}
+
+GLint UniformTable::location(UniformId id) const
+{
+    size_t lo = 0, hi = hashes.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (hashes[mid].first == id.hash)
+            return hashes[mid].second;
+        if (hashes[mid].first < id.hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+bool UniformTable::check(const UniformId* ids, size_t count, unsigned int program) const
+{
+    bool ok = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (location(ids[i]) < 0)
+        {
+            std::cout << "WARNING::UNIFORM_NOT_FOUND: " << ids[i].name << " in program " << program << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,231 @@
+#include "atlas.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+
+SkylinePacker::SkylinePacker(int width, int height)
+    : binWidth(width), binHeight(height), usedArea(0)
+{
+    Segment floor = { 0, 0, width };
+    skyline.push_back(floor);
+}
+
+int SkylinePacker::fit(size_t index, int w, int h) const
+{
+    int x = skyline[index].x;
+    if (x + w > binWidth)
+        return -1;
+    // the rectangle rests on the highest segment under its span
+    int y = 0;
+    for (size_t i = index; i < skyline.size() && skyline[i].x < x + w; i++)
+        y = std::max(y, skyline[i].y);
+    return y + h <= binHeight ? y : -1;
+}
+
+bool SkylinePacker::insert(int w, int h, int &x, int &y)
+{
+    size_t best = skyline.size();
+    int bestTop = 0, bestWidth = 0;
+    for (size_t i = 0; i < skyline.size(); i++)
+    {
+        int top = fit(i, w, h);
+        if (top < 0)
+            continue;
+        top += h;
+        // lowest top edge first, then the narrowest segment so wide gaps are kept for wide rectangles
+        if (best == skyline.size() || top < bestTop || (top == bestTop && skyline[i].width < bestWidth))
+        {
+            best = i;
+            bestTop = top;
+            bestWidth = skyline[i].width;
+        }
+    }
+    if (best == skyline.size())
+        return false;
+
+    x = skyline[best].x;
+    y = bestTop - h;
+    Segment placed = { x, bestTop, w };
+    skyline.insert(skyline.begin() + best, placed);
+
+    // trim or drop the segments now covered by the new one
+    for (size_t i = best + 1; i < skyline.size();)
+    {
+        int covered = placed.x + placed.width - skyline[i].x;
+        if (covered <= 0)
+            break;
+        if (covered < skyline[i].width)
+        {
+            skyline[i].x += covered;
+            skyline[i].width -= covered;
+            break;
+        }
+        skyline.erase(skyline.begin() + i);
+    }
+    // neighbours at the same height become one segment
+    for (size_t i = 0; i + 1 < skyline.size();)
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+            i++;
+    }
+    usedArea += (size_t)w * h;
+    return true;
+}
+
+double SkylinePacker::occupancy() const
+{
+    return (double)usedArea / ((double)binWidth * binHeight);
+}
+
+AtlasBuilder::AtlasBuilder(int padding)
+    : padding(padding), atlasWidth(0), atlasHeight(0), atlasOccupancy(0.0)
+{
+}
+
+void AtlasBuilder::add(const std::string &name, const unsigned char* rgba, int width, int height)
+{
+    Image image;
+    image.name = name;
+    image.width = width;
+    image.height = height;
+    image.rgba.assign(rgba, rgba + (size_t)width * height * 4);
+    images.push_back(image);
+}
+
+int AtlasBuilder::maxMipLevels() const
+{
+    int levels = 1;
+    for (int p = padding; p > 1; p /= 2)
+        levels++;
+    return levels;
+}
+
+bool AtlasBuilder::pack(int width, int height, const std::vector<size_t> &order, std::vector<int> &positions, double &occupancy) const
+{
+    SkylinePacker packer(width, height);
+    positions.resize(images.size() * 2);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const Image &image = images[order[i]];
+        int x, y;
+        if (!packer.insert(image.width + 2 * padding, image.height + 2 * padding, x, y))
+            return false;
+        positions[order[i] * 2] = x + padding;
+        positions[order[i] * 2 + 1] = y + padding;
+    }
+    occupancy = packer.occupancy();
+    return true;
+}
+
+bool AtlasBuilder::build(int maxSize)
+{
+    if (images.empty())
+        return false;
+    // tallest first, then widest, the usual order for skyline packing
+    std::vector<size_t> order(images.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        if (images[a].height != images[b].height)
+            return images[a].height > images[b].height;
+        return images[a].width > images[b].width;
+    });
+
+    // grow the bin one side at a time: 256x256, 512x256, 512x512, ...
+    std::vector<int> positions;
+    int width = 256, height = 256;
+    while (!pack(width, height, order, positions, atlasOccupancy))
+    {
+        if (width == maxSize && height == maxSize)
+            return false;
+        if (width <= height && width < maxSize)
+            width *= 2;
+        else
+            height *= 2;
+    }
+    atlasWidth = width;
+    atlasHeight = height;
+    atlasPixels.assign((size_t)width * height * 4, 0);
+    atlasEntries.clear();
+
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        const Image &image = images[i];
+        int left = positions[i * 2], top = positions[i * 2 + 1];
+        // the padded block, clamping the source coordinates repeats the edge pixels outwards
+        for (int y = -padding; y < image.height + padding; y++)
+        {
+            int sy = std::min(std::max(y, 0), image.height - 1);
+            unsigned char* dst = &atlasPixels[((size_t)(top + y) * width + left - padding) * 4];
+            const unsigned char* row = &image.rgba[(size_t)sy * image.width * 4];
+            for (int x = -padding; x < 0; x++, dst += 4)
+                memcpy(dst, row, 4);
+            memcpy(dst, row, (size_t)image.width * 4);
+            dst += (size_t)image.width * 4;
+            for (int x = 0; x < padding; x++, dst += 4)
+                memcpy(dst, row + (size_t)(image.width - 1) * 4, 4);
+        }
+        AtlasEntry entry;
+        entry.name = image.name;
+        entry.layer = 0;
+        entry.u0 = (float)left / width;
+        entry.v0 = (float)top / height;
+        entry.u1 = (float)(left + image.width) / width;
+        entry.v1 = (float)(top + image.height) / height;
+        atlasEntries.push_back(entry);
+    }
+    return true;
+}
+
+std::vector<AtlasEntry> arrayEntries(const std::vector<std::string> &names)
+{
+    std::vector<AtlasEntry> entries(names.size());
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        entries[i].name = names[i];
+        entries[i].layer = (int)i;
+        entries[i].u0 = entries[i].v0 = 0.0f;
+        entries[i].u1 = entries[i].v1 = 1.0f;
+    }
+    return entries;
+}
+
+bool writeAtlasTable(const std::string &path, const std::vector<AtlasEntry> &entries)
+{
+    std::ofstream file(path.c_str());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const AtlasEntry &e = entries[i];
+        file << e.layer << " " << e.u0 << " " << e.v0 << " " << e.u1 << " " << e.v1 << " " << e.name << "\n";
+    }
+    return file.good();
+}
+
+bool readAtlasTable(const std::string &path, std::vector<AtlasEntry> &entries)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+        return false;
+    entries.clear();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+        std::istringstream fields(line);
+        AtlasEntry e;
+        if (!(fields >> e.layer >> e.u0 >> e.v0 >> e.u1 >> e.v1))
+            return false;
+        // skip the one space separating the name
+        fields.get();
+        std::getline(fields, e.name);
+        entries.push_back(e);
+    }
+    return !entries.empty();
+}
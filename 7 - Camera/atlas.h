@@ -0,0 +1,90 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <string>
+#include <vector>
+
+// Where one source texture ended up: a layer of a texture array or a rectangle of a 2D atlas,
+// in normalised texture coordinates. The shaders take rect = (u0, v0, u1 - u0, v1 - v0) and layer
+struct AtlasEntry
+{
+    std::string name;
+    int layer;
+    float u0, v0, u1, v1;
+};
+
+// Bottom-left skyline packer: the packed area is described by its top outline, each rectangle is placed
+// on the segment that leaves its top edge lowest. Good occupancy for mixed sizes at O(segments) per insert
+class SkylinePacker
+{
+public:
+    SkylinePacker(int width, int height);
+
+    // position for a w x h rectangle, returns false when it no longer fits
+    bool insert(int w, int h, int &x, int &y);
+    // packed area over the bin area
+    double occupancy() const;
+    int width() const { return binWidth; }
+    int height() const { return binHeight; }
+
+private:
+    struct Segment
+    {
+        int x, y, width;
+    };
+
+    int binWidth, binHeight;
+    size_t usedArea;
+    std::vector<Segment> skyline;   // left to right, covering the whole width
+
+    // y a w x h rectangle at the start of segment index would rest on, -1 if it overruns the bin
+    int fit(size_t index, int w, int h) const;
+};
+
+// Builds a 2D atlas out of RGBA8 images of any size. Every image is surrounded by padding pixels copied
+// from its own edges, so bilinear filtering and the first log2(padding) mip levels don't pick up neighbours
+class AtlasBuilder
+{
+public:
+    AtlasBuilder(int padding = 4);
+
+    // copies a tightly packed RGBA8 image
+    void add(const std::string &name, const unsigned char* rgba, int width, int height);
+    // packs the largest images first into the smallest power of two size up to maxSize on each side
+    bool build(int maxSize = 4096);
+
+    int width() const { return atlasWidth; }
+    int height() const { return atlasHeight; }
+    double occupancy() const { return atlasOccupancy; }
+    // levels below this would start mixing neighbouring images
+    int maxMipLevels() const;
+    const std::vector<unsigned char>& pixels() const { return atlasPixels; }
+    const std::vector<AtlasEntry>& entries() const { return atlasEntries; }
+
+private:
+    struct Image
+    {
+        std::string name;
+        int width, height;
+        std::vector<unsigned char> rgba;
+    };
+
+    int padding;
+    std::vector<Image> images;
+    int atlasWidth, atlasHeight;
+    double atlasOccupancy;
+    std::vector<unsigned char> atlasPixels;
+    std::vector<AtlasEntry> atlasEntries;
+
+    bool pack(int width, int height, const std::vector<size_t> &order, std::vector<int> &positions, double &occupancy) const;
+};
+
+// one entry per layer of a texture array, each covering the whole layer
+std::vector<AtlasEntry> arrayEntries(const std::vector<std::string> &names);
+
+// the table is a text file with one "layer u0 v0 u1 v1 name" line per entry, the name runs to the end
+// of the line so paths with spaces survive
+bool writeAtlasTable(const std::string &path, const std::vector<AtlasEntry> &entries);
+bool readAtlasTable(const std::string &path, std::vector<AtlasEntry> &entries);
+
+#endif
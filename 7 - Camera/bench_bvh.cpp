@@ -0,0 +1,227 @@
+// Bounding volume hierarchy over clustered boxes, 10 thousand to 10 million of them: build time and
+// memory per object, frustum culling against the flat SIMD cull of every box, ray queries against
+// testing every box, and refitting after objects moved against a rebuild. Every query result is
+// checked against its brute force counterpart. No display needed
+#include "bvh.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+
+const int ITERATIONS = 5;
+const int RAYS = 10000;
+
+double milliseconds(Uint64 start)
+{
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+struct Random
+{
+    unsigned int seed;
+
+    Random() : seed(12345) {}
+    float next()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    }
+};
+
+// small boxes gathered around a few hundred centres in a 400 unit cube, the way props bunch up in a level
+void clusteredBoxes(BoundingVolumes &boxes, size_t n)
+{
+    Random random;
+    std::vector<glm::vec3> clusters(256);
+    for (size_t i = 0; i < clusters.size(); i++)
+        clusters[i] = glm::vec3(random.next(), random.next(), random.next()) * 400.0f - 200.0f;
+    boxes.clear();
+    boxes.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        glm::vec3 offset = glm::vec3(random.next() - 0.5f, random.next() - 0.5f, random.next() - 0.5f) * 40.0f;
+        glm::vec3 center = clusters[i % clusters.size()] + offset;
+        glm::vec3 half = glm::vec3(0.1f + random.next(), 0.1f + random.next(), 0.1f + random.next()) * 0.5f;
+        boxes.addBox(center - half, center + half);
+    }
+}
+
+// the closest box along the ray by testing all of them, the same slab test as the tree
+bool raycastAll(const BoundingVolumes &boxes, const glm::vec3 &origin, const glm::vec3 &direction, RayHit &hit)
+{
+    glm::vec3 inverse = 1.0f / direction;
+    float best = FLT_MAX;
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+        glm::vec3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+        glm::vec3 t1 = (center - extent - origin) * inverse, t2 = (center + extent - origin) * inverse;
+        glm::vec3 near = glm::min(t1, t2), far = glm::max(t1, t2);
+        float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(std::min(far.x, far.y), far.z);
+        if (enter <= exit && enter < best)
+        {
+            best = enter;
+            hit.object = (uint32_t)i;
+            hit.distance = enter;
+        }
+    }
+    return best < FLT_MAX;
+}
+
+int main(int argc, char* argv[])
+{
+    if (SDL_Init(0) < 0)
+        return 1;
+    // the chapter's camera with a far plane that reaches across the scene
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    camera.SetPerspective(ZOOM, 800.0f / 600.0f, NEAR_PLANE, 300.0f);
+    const Plane* planes = camera.GetFrustumPlanes();
+
+    bool allMatch = true;
+    std::cout << "objects\tbuild ms\tnodes\tbytes/object\tSAH cost\tvisible\tflat cull ms\tBVH cull ms\tspeedup\tmatches" << std::endl;
+    std::vector<size_t> counts;
+    for (size_t n = 10000; n <= 10000000; n *= 10)
+        counts.push_back(n);
+    for (size_t c = 0; c < counts.size(); c++)
+    {
+        size_t n = counts[c];
+        BoundingVolumes boxes(BoundingVolumes::BOXES);
+        clusteredBoxes(boxes, n);
+        Bvh bvh;
+        Uint64 start = SDL_GetPerformanceCounter();
+        bvh.build(boxes);
+        double buildMs = milliseconds(start);
+
+        std::vector<uint32_t> flat(n), visible;
+        double flatMs = 1e30, bvhMs = 1e30;
+        size_t flatCount = 0;
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            start = SDL_GetPerformanceCounter();
+            flatCount = cull(boxes, planes, 0, n, &flat[0]);
+            flatMs = std::min(flatMs, milliseconds(start));
+            start = SDL_GetPerformanceCounter();
+            bvh.cull(planes, visible);
+            bvhMs = std::min(bvhMs, milliseconds(start));
+        }
+        flat.resize(flatCount);
+        std::sort(visible.begin(), visible.end());
+        bool match = visible == flat;
+        allMatch = allMatch && match;
+        std::cout << n << "\t" << buildMs << "\t" << bvh.nodeCount() << "\t" << (double)bvh.memoryBytes() / n << "\t" << bvh.cost() << "\t"
+                  << flatCount << "\t" << flatMs << "\t" << bvhMs << "\t" << flatMs / bvhMs << "x\t" << (match ? "yes" : "NO") << std::endl;
+    }
+
+    std::cout << std::endl << "Rays from random points inside the scene in random directions" << std::endl;
+    std::cout << "objects\tBVH us/ray\tall boxes us/ray\thits\tmatches" << std::endl;
+    for (size_t c = 0; c < counts.size(); c++)
+    {
+        size_t n = counts[c];
+        BoundingVolumes boxes(BoundingVolumes::BOXES);
+        clusteredBoxes(boxes, n);
+        Bvh bvh;
+        bvh.build(boxes);
+        Random random;
+        std::vector<glm::vec3> origins(RAYS), directions(RAYS);
+        for (int i = 0; i < RAYS; i++)
+        {
+            origins[i] = glm::vec3(random.next(), random.next(), random.next()) * 400.0f - 200.0f;
+            directions[i] = glm::normalize(glm::vec3(random.next(), random.next(), random.next()) - 0.5f);
+        }
+        std::vector<RayHit> hits(RAYS);
+        std::vector<bool> hit(RAYS);
+        Uint64 begin = SDL_GetPerformanceCounter();
+        int hitCount = 0;
+        for (int i = 0; i < RAYS; i++)
+        {
+            hit[i] = bvh.raycast(origins[i], directions[i], hits[i]);
+            hitCount += hit[i];
+        }
+        double bvhUs = milliseconds(begin) * 1000.0 / RAYS;
+        // brute force is too slow for every ray once the scene is large, it checks a sample
+        int checked = (int)std::min<size_t>(RAYS, 100000000 / n);
+        bool match = true;
+        begin = SDL_GetPerformanceCounter();
+        for (int i = 0; i < checked; i++)
+        {
+            RayHit reference;
+            bool referenceHit = raycastAll(boxes, origins[i], directions[i], reference);
+            // two boxes at the same distance may be reported either way
+            if (referenceHit != hit[i] || (referenceHit && reference.distance != hits[i].distance))
+                match = false;
+        }
+        double allUs = milliseconds(begin) * 1000.0 / checked;
+        allMatch = allMatch && match;
+        std::cout << n << "\t" << bvhUs << "\t" << allUs << "\t" << hitCount << "\t" << (match ? "yes" : "NO") << " (" << checked << " checked)" << std::endl;
+    }
+
+    std::cout << std::endl << "Moving objects: update() per moved box, refit() of the whole tree and a rebuild" << std::endl;
+    std::cout << "objects\tmoved\tupdate ms\trefit ms\trebuild ms\tSAH cost refitted / rebuilt\tmatches" << std::endl;
+    for (size_t c = 0; c < counts.size(); c++)
+    {
+        size_t n = counts[c];
+        BoundingVolumes boxes(BoundingVolumes::BOXES);
+        clusteredBoxes(boxes, n);
+        Bvh bvh;
+        bvh.build(boxes);
+        // one object in a hundred drifts by up to 5 units
+        Random random;
+        std::vector<uint32_t> moved;
+        for (size_t i = 0; i < n; i += 100)
+        {
+            moved.push_back((uint32_t)i);
+            glm::vec3 offset = glm::vec3(random.next() - 0.5f, random.next() - 0.5f, random.next() - 0.5f) * 10.0f;
+            boxes.centerX[i] += offset.x;
+            boxes.centerY[i] += offset.y;
+            boxes.centerZ[i] += offset.z;
+        }
+        Uint64 begin = SDL_GetPerformanceCounter();
+        for (size_t i = 0; i < moved.size(); i++)
+        {
+            uint32_t object = moved[i];
+            glm::vec3 center(boxes.centerX[object], boxes.centerY[object], boxes.centerZ[object]);
+            glm::vec3 extent(boxes.extentX[object], boxes.extentY[object], boxes.extentZ[object]);
+            bvh.update(object, center - extent, center + extent);
+        }
+        double updateMs = milliseconds(begin);
+        // update() recomputes centre and half size from the corners, so the flat cull below gets the same boxes
+        for (size_t i = 0; i < moved.size(); i++)
+        {
+            uint32_t object = moved[i];
+            glm::vec3 center(boxes.centerX[object], boxes.centerY[object], boxes.centerZ[object]);
+            glm::vec3 extent(boxes.extentX[object], boxes.extentY[object], boxes.extentZ[object]);
+            glm::vec3 min = center - extent, max = center + extent;
+            boxes.centerX[object] = (min.x + max.x) * 0.5f;
+            boxes.centerY[object] = (min.y + max.y) * 0.5f;
+            boxes.centerZ[object] = (min.z + max.z) * 0.5f;
+            boxes.extentX[object] = (max.x - min.x) * 0.5f;
+            boxes.extentY[object] = (max.y - min.y) * 0.5f;
+            boxes.extentZ[object] = (max.z - min.z) * 0.5f;
+        }
+        std::vector<uint32_t> flat(n), visible;
+        flat.resize(cull(boxes, planes, 0, n, &flat[0]));
+        bvh.cull(planes, visible);
+        std::sort(visible.begin(), visible.end());
+        bool match = visible == flat;
+
+        begin = SDL_GetPerformanceCounter();
+        bvh.refit(boxes);
+        double refitMs = milliseconds(begin);
+        float refitCost = bvh.cost();
+        Bvh rebuilt;
+        begin = SDL_GetPerformanceCounter();
+        rebuilt.build(boxes);
+        double rebuildMs = milliseconds(begin);
+        bvh.cull(planes, visible);
+        std::sort(visible.begin(), visible.end());
+        match = match && visible == flat;
+        allMatch = allMatch && match;
+        std::cout << n << "\t" << moved.size() << "\t" << updateMs << "\t" << refitMs << "\t" << rebuildMs << "\t"
+                  << refitCost << " / " << rebuilt.cost() << "\t" << (match ? "yes" : "NO") << std::endl;
+    }
+    std::cout << (allMatch ? "All queries agree with brute force" : "MISMATCH against brute force") << std::endl;
+    SDL_Quit();
+    return allMatch ? 0 : 1;
+}
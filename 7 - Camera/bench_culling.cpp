@@ -0,0 +1,103 @@
+// Frustum culling of bounding spheres and boxes: the scalar reference against the SSE and AVX2 paths
+// of culling, on one thread and split across the job system, from 10 thousand to 10 million objects.
+// Every path's visible list is checked against the scalar one. No display needed
+#include "culling.h"
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+
+const int ITERATIONS = 5;
+
+double milliseconds(Uint64 start)
+{
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// objects scattered through a 400 unit cube around the camera, so roughly a tenth are in view
+void randomVolumes(BoundingVolumes &volumes, size_t n)
+{
+    unsigned int seed = 12345;
+    volumes.clear();
+    volumes.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        float c[4];
+        for (int k = 0; k < 4; k++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            c[k] = (seed >> 8) / 16777216.0f;
+        }
+        glm::vec3 center(c[0] * 400.0f - 200.0f, c[1] * 400.0f - 200.0f, c[2] * 400.0f - 200.0f);
+        float size = 0.5f + c[3] * 4.0f;
+        if (volumes.shape == BoundingVolumes::SPHERES)
+            volumes.addSphere(center, size);
+        else
+            volumes.addBox(center - glm::vec3(size, size * 0.5f, size * 0.25f), center + glm::vec3(size, size * 0.5f, size * 0.25f));
+    }
+}
+
+// best of ITERATIONS, visible holds the last result
+double timeCull(JobSystem* jobs, const BoundingVolumes &volumes, const Plane planes[6], CullPath path, std::vector<uint32_t> &visible)
+{
+    double best = 1e30;
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        if (jobs)
+            cullParallel(*jobs, volumes, planes, visible, path);
+        else
+        {
+            visible.resize(volumes.size());
+            visible.resize(cull(volumes, planes, 0, volumes.size(), &visible[0], path));
+        }
+        double ms = milliseconds(start);
+        best = ms < best ? ms : best;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    if (SDL_Init(0) < 0)
+        return 1;
+    // the same view as the chapter's camera, with a far plane that reaches the edge of the scatter
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    camera.SetPerspective(ZOOM, 800.0f / 600.0f, NEAR_PLANE, 200.0f);
+    const Plane* planes = camera.GetFrustumPlanes();
+    JobSystem jobs;
+
+    const char* shapeNames[] = { "spheres", "boxes" };
+    const char* pathNames[] = { "scalar", "SSE", "AVX2" };
+    std::cout << "Best of " << ITERATIONS << ", " << jobs.size() << " threads in parallel (the workers and the caller)" << std::endl;
+    std::cout << "shape\tobjects\tpath\tthreads\tms\tMobj/s\tspeedup\tvisible\tmatches scalar" << std::endl;
+    bool allMatch = true;
+    for (int s = 0; s < 2; s++)
+    {
+        BoundingVolumes volumes((BoundingVolumes::Shape)s);
+        for (size_t n = 10000; n <= 10000000; n *= 10)
+        {
+            randomVolumes(volumes, n);
+            std::vector<uint32_t> reference, visible;
+            double scalarMs = timeCull(NULL, volumes, planes, CULL_SCALAR, reference);
+            for (int parallel = 0; parallel < 2; parallel++)
+                for (int p = CULL_SCALAR; p <= CULL_AVX2; p++)
+                {
+                    if (!cullPathSupported((CullPath)p))
+                    {
+                        std::cout << shapeNames[s] << "\t" << n << "\t" << pathNames[p] << "\tnot supported by this CPU" << std::endl;
+                        continue;
+                    }
+                    double ms = timeCull(parallel ? &jobs : NULL, volumes, planes, (CullPath)p, visible);
+                    bool match = visible == reference;
+                    allMatch = allMatch && match;
+                    std::cout << shapeNames[s] << "\t" << n << "\t" << pathNames[p] << "\t" << (parallel ? jobs.size() : 1) << "\t"
+                              << ms << "\t" << n / ms / 1000.0 << "\t" << scalarMs / ms << "x\t" << visible.size() << "\t"
+                              << (match ? "yes" : "NO") << std::endl;
+                }
+        }
+    }
+    std::cout << (allMatch ? "All paths agree with the scalar reference" : "MISMATCH against the scalar reference") << std::endl;
+    SDL_Quit();
+    return allMatch ? 0 : 1;
+}
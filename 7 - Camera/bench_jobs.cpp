@@ -0,0 +1,225 @@
+// The job system from 1 to 64 threads: checks first that every parallelFor() range, job tree, nested
+// loop and job run from a thread outside the system happens exactly once, then times empty jobs, where
+// all the cost is scheduling and stealing, and a parallelFor() over arithmetic that should scale with
+// the hardware threads. "--check" runs only the checks, the way "make bench_jobs_tsan" runs them under
+// ThreadSanitizer. No display needed
+#include "job_system.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+const size_t EMPTY_JOBS = 100000;
+const size_t ELEMENTS = 1 << 22;
+const int TREE_FANOUT = 4;
+const int TREE_DEPTH = 6;
+
+double millisecondsSince(Uint64 start)
+{
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// TREE_FANOUT children under every job down to depth, each leaf counted once
+void spawnTree(JobSystem &jobs, JobSystem::Job* parent, int depth, std::atomic<int> &leaves)
+{
+    for (int i = 0; i < TREE_FANOUT; i++)
+    {
+        if (depth == 1)
+            jobs.spawn([&leaves] { leaves++; }, parent);
+        else
+        {
+            // the job spawning the child's subtree is a child itself, so the child is still unfinished
+            // while the rest of its children join it
+            JobSystem::Job* child = jobs.create(std::function<void()>(), parent);
+            jobs.spawn([&jobs, child, depth, &leaves] { spawnTree(jobs, child, depth - 1, leaves); }, child);
+            jobs.run(child);
+            jobs.release(child);
+        }
+    }
+}
+
+bool check(const char* name, bool passed)
+{
+    if (!passed)
+        std::cout << "FAILED: " << name << std::endl;
+    return passed;
+}
+
+// every range covers its elements once
+bool checkParallelFor(JobSystem &jobs, size_t count, size_t grain)
+{
+    std::vector<uint8_t> hits(count, 0);
+    jobs.parallelFor(count, [&hits](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            hits[i]++;
+    }, grain);
+    return std::count(hits.begin(), hits.end(), 1) == (ptrdiff_t)count;
+}
+
+bool runChecks(JobSystem &jobs, int rounds)
+{
+    bool passed = true;
+    for (int r = 0; r < rounds; r++)
+    {
+        passed = check("parallelFor", checkParallelFor(jobs, 100000, 0)) && passed;
+        passed = check("parallelFor grain 1", checkParallelFor(jobs, 1000, 1)) && passed;
+        passed = check("parallelFor single", checkParallelFor(jobs, 1, 0)) && passed;
+
+        // a parent is only done once its whole tree is
+        std::atomic<int> leaves(0);
+        JobSystem::Job* root = jobs.create(std::function<void()>());
+        spawnTree(jobs, root, TREE_DEPTH, leaves);
+        jobs.run(root);
+        jobs.wait(root);
+        int expected = 1;
+        for (int d = 0; d < TREE_DEPTH; d++)
+            expected *= TREE_FANOUT;
+        passed = check("job tree", leaves.load() == expected) && passed;
+
+        // loops inside loops, every worker waiting on its own inner loop helps with the others'
+        std::vector<std::atomic<int> > sums(64);
+        for (size_t i = 0; i < sums.size(); i++)
+            sums[i] = 0;
+        jobs.parallelFor(sums.size(), [&jobs, &sums](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                jobs.parallelFor(1000, [&sums, i](size_t from, size_t to) { sums[i] += (int)(to - from); }, 16);
+        }, 1);
+        bool nested = true;
+        for (size_t i = 0; i < sums.size(); i++)
+            nested = nested && sums[i].load() == 1000;
+        passed = check("nested parallelFor", nested) && passed;
+
+        // a thread without a queue hands its jobs in through the inbox, and waits without helping as long
+        // as there are workers to run them
+        std::atomic<int> outside(0);
+        std::thread external([&jobs, &outside] {
+            JobSystem::Job* parent = jobs.create([&outside] { outside++; });
+            for (int i = 0; i < 100; i++)
+                jobs.spawn([&outside] { outside++; }, parent);
+            jobs.run(parent);
+            jobs.wait(parent, jobs.workers() == 0);
+        });
+        external.join();
+        passed = check("outside thread", outside.load() == 101) && passed;
+    }
+    return passed;
+}
+
+// milliseconds to run EMPTY_JOBS jobs that do nothing, all spawned by the calling thread so every
+// other thread has to steal them from its queue
+double timeFanOut(JobSystem &jobs)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    JobSystem::Job* root = jobs.create(std::function<void()>());
+    for (size_t i = 0; i < EMPTY_JOBS; i++)
+        jobs.spawn(std::function<void()>(), root);
+    jobs.run(root);
+    jobs.wait(root);
+    return millisecondsSince(start);
+}
+
+// the same number of empty jobs as a binary tree, spawned wherever their parent runs
+void spawnHalves(JobSystem &jobs, JobSystem::Job* root, size_t count)
+{
+    while (count > 1)
+    {
+        size_t half = count / 2;
+        jobs.spawn([&jobs, root, half] { spawnHalves(jobs, root, half); }, root);
+        count -= half;
+    }
+}
+
+double timeTree(JobSystem &jobs)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    JobSystem::Job* root = jobs.create(std::function<void()>());
+    spawnHalves(jobs, root, EMPTY_JOBS);
+    jobs.run(root);
+    jobs.wait(root);
+    return millisecondsSince(start);
+}
+
+// a few hundred flops per element, enough that scheduling should not matter
+double timeCompute(JobSystem &jobs, std::vector<float> &out, double &checksum)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    jobs.parallelFor(out.size(), [&out](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            float x = (float)i * 0.001f, sum = 0.0f;
+            for (int k = 0; k < 32; k++)
+                sum += sinf(x + k) * 0.5f;
+            out[i] = sum;
+        }
+    });
+    double ms = millisecondsSince(start);
+    checksum = 0.0;
+    for (size_t i = 0; i < out.size(); i++)
+        checksum += out[i];
+    return ms;
+}
+
+int main(int argc, char* argv[])
+{
+    bool checkOnly = argc > 1 && strcmp(argv[1], "--check") == 0;
+    if (SDL_Init(0) < 0)
+        return 1;
+    std::vector<unsigned int> counts;
+    for (unsigned int t = 1; t <= 64; t *= 2)
+        counts.push_back(t);
+    unsigned int hardware = std::thread::hardware_concurrency();
+    if (hardware > 1 && std::find(counts.begin(), counts.end(), hardware) == counts.end())
+    {
+        counts.push_back(hardware);
+        std::sort(counts.begin(), counts.end());
+    }
+
+    bool passed = true;
+    for (size_t c = 0; c < counts.size(); c++)
+    {
+        JobSystem jobs(counts[c]);
+        passed = runChecks(jobs, checkOnly ? 3 : 1) && passed;
+    }
+    std::cout << "checks " << (passed ? "passed" : "FAILED") << " on 1 to 64 threads" << std::endl;
+    if (checkOnly)
+    {
+        SDL_Quit();
+        return passed ? 0 : 1;
+    }
+
+    std::cout << EMPTY_JOBS << " empty jobs, " << ELEMENTS << " elements, " << hardware << " hardware threads" << std::endl;
+    std::cout << "threads\tfan-out ns/job\ttree ns/job\tsteals\tfailed steals\tsleeps\tcompute ms\tspeedup\tsame result" << std::endl;
+    std::vector<float> out(ELEMENTS);
+    double serialMs = 0.0, serialChecksum = 0.0;
+    for (size_t c = 0; c < counts.size(); c++)
+    {
+        JobSystem jobs(counts[c]);
+        timeFanOut(jobs);
+        double fanOut = 1e30, tree = 1e30, compute = 1e30, checksum = 0.0;
+        JobStats before = jobs.stats();
+        for (int r = 0; r < 3; r++)
+        {
+            fanOut = std::min(fanOut, timeFanOut(jobs));
+            tree = std::min(tree, timeTree(jobs));
+        }
+        JobStats after = jobs.stats();
+        for (int r = 0; r < 3; r++)
+            compute = std::min(compute, timeCompute(jobs, out, checksum));
+        if (c == 0)
+        {
+            serialMs = compute;
+            serialChecksum = checksum;
+        }
+        bool same = checksum == serialChecksum;
+        passed = passed && same;
+        std::cout << counts[c] << "\t" << fanOut * 1e6 / EMPTY_JOBS << "\t" << tree * 1e6 / EMPTY_JOBS << "\t"
+                  << (after.stolen - before.stolen) / 6 << "\t" << (after.failedSteals - before.failedSteals) / 6 << "\t"
+                  << (after.sleeps - before.sleeps) / 6 << "\t" << compute << "\t" << serialMs / compute << "x\t" << (same ? "yes" : "NO") << std::endl;
+    }
+    SDL_Quit();
+    return passed ? 0 : 1;
+}
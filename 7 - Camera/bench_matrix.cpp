@@ -0,0 +1,166 @@
+// The batched matrix kernels against the same math written as a glm call per element, from a
+// thousand to a million elements: composing model matrices, view-projection times every model,
+// pairwise products, transforming vectors and normal matrices. Every path is checked against glm,
+// exact means equal in every element. No display needed
+#include "matrix_batch.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+const size_t MAX_ELEMENTS = 1000000;
+// every size runs about as many elements in total, so small arrays are timed over many calls
+const size_t WORK = 20000000;
+
+struct Random
+{
+    unsigned int seed;
+
+    Random() : seed(12345) {}
+    float next()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    }
+};
+
+// milliseconds per call
+double timeCalls(const std::function<void()> &run, size_t n)
+{
+    size_t calls = std::max<size_t>(WORK / n, 3);
+    run();
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (size_t c = 0; c < calls; c++)
+        run();
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / calls;
+}
+
+// largest difference and whether every float is equal, over count floats
+void compare(const float* a, const float* b, size_t count, float &worst, bool &exact)
+{
+    worst = 0.0f;
+    exact = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        // a NaN left in an element nothing wrote counts as the worst difference too
+        float diff = fabsf(a[i] - b[i]);
+        if (!(diff <= worst))
+            worst = diff;
+        exact = exact && a[i] == b[i];
+    }
+}
+
+// times glm and every supported path of one kernel at one size. run(path) writes the kernel's result,
+// result points at it and floats is its length
+bool benchmark(const char* name, size_t n, const std::function<void()> &glmRun, const float* expected,
+               const std::function<void(MatrixPath)> &run, float* result, size_t floats)
+{
+    double glmMs = timeCalls(glmRun, n), bestMs = 0.0;
+    float worstDiff = 0.0f;
+    bool allExact = true;
+    std::cout << name << "\t" << n << "\t" << glmMs;
+    for (int p = MATRIX_SCALAR; p < MATRIX_BEST; p++)
+    {
+        MatrixPath path = (MatrixPath)p;
+        if (!matrixPathSupported(path))
+        {
+            std::cout << "\t-";
+            continue;
+        }
+        // checked on a run of its own into a result filled with NaN, so an element the path skips
+        // can't pass with what the previous path left there
+        std::fill(result, result + floats, NAN);
+        run(path);
+        float diff;
+        bool exact;
+        compare(expected, result, floats, diff, exact);
+        double ms = timeCalls([&] { run(path); }, n);
+        worstDiff = std::max(worstDiff, diff);
+        allExact = allExact && exact;
+        bestMs = p == MATRIX_SCALAR ? ms : std::min(bestMs, ms);
+        std::cout << "\t" << ms;
+    }
+    std::cout << "\t" << glmMs / bestMs << "x\t" << worstDiff << "\t" << (allExact ? "yes" : "NO") << std::endl;
+    return allExact;
+}
+
+int main(int argc, char* argv[])
+{
+    if (SDL_Init(0) < 0)
+        return 1;
+    Random random;
+    std::vector<glm::vec3> positions(MAX_ELEMENTS), scales(MAX_ELEMENTS);
+    std::vector<glm::quat> rotations(MAX_ELEMENTS);
+    std::vector<glm::vec4> vectors(MAX_ELEMENTS);
+    for (size_t i = 0; i < MAX_ELEMENTS; i++)
+    {
+        positions[i] = glm::vec3(random.next(), random.next(), random.next()) * 200.0f - 100.0f;
+        rotations[i] = glm::angleAxis(random.next() * 6.28f, glm::normalize(glm::vec3(random.next(), random.next(), random.next()) - 0.5f));
+        scales[i] = glm::vec3(0.5f + random.next(), 0.5f + random.next(), 0.5f + random.next());
+        vectors[i] = glm::vec4(random.next(), random.next(), random.next(), 1.0f);
+    }
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    // the models every other kernel starts from, and a second set for the pairwise product
+    std::vector<glm::mat4> models(MAX_ELEMENTS), others(MAX_ELEMENTS), expected(MAX_ELEMENTS), result(MAX_ELEMENTS);
+    composeMatrices(&positions[0], &rotations[0], &scales[0], &models[0], MAX_ELEMENTS, MATRIX_SCALAR);
+    for (size_t i = 0; i < MAX_ELEMENTS; i++)
+        others[i] = models[(i * 7919) % MAX_ELEMENTS];
+    std::vector<glm::vec4> expectedVectors(MAX_ELEMENTS), resultVectors(MAX_ELEMENTS);
+    std::vector<glm::mat3> expectedNormals(MAX_ELEMENTS), resultNormals(MAX_ELEMENTS);
+
+    std::cout << "kernel\telements\tglm ms\tscalar ms\tSSE4 ms\tAVX2 ms\tAVX-512 ms\tbest speedup\tmax diff\texact" << std::endl;
+    bool allExact = true;
+    for (size_t n = 1000; n <= MAX_ELEMENTS; n *= 10)
+    {
+        allExact = benchmark("compose", n,
+            [&] {
+                for (size_t i = 0; i < n; i++)
+                    expected[i] = glm::scale(glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(rotations[i]), scales[i]);
+            }, &expected[0][0][0],
+            [&](MatrixPath path) { composeMatrices(&positions[0], &rotations[0], &scales[0], &result[0], n, path); },
+            &result[0][0][0], n * 16) && allExact;
+        allExact = benchmark("mvp", n,
+            [&] {
+                for (size_t i = 0; i < n; i++)
+                    expected[i] = viewProjection * models[i];
+            }, &expected[0][0][0],
+            [&](MatrixPath path) { multiplyMatrices(viewProjection, &models[0], &result[0], n, path); },
+            &result[0][0][0], n * 16) && allExact;
+        allExact = benchmark("mat*mat", n,
+            [&] {
+                for (size_t i = 0; i < n; i++)
+                    expected[i] = models[i] * others[i];
+            }, &expected[0][0][0],
+            [&](MatrixPath path) { multiplyMatrices(&models[0], &others[0], &result[0], n, path); },
+            &result[0][0][0], n * 16) && allExact;
+        allExact = benchmark("mvp*vec", n,
+            [&] {
+                for (size_t i = 0; i < n; i++)
+                    expectedVectors[i] = viewProjection * vectors[i];
+            }, &expectedVectors[0].x,
+            [&](MatrixPath path) { transformVectors(viewProjection, &vectors[0], &resultVectors[0], n, path); },
+            &resultVectors[0].x, n * 4) && allExact;
+        allExact = benchmark("mat*vec", n,
+            [&] {
+                for (size_t i = 0; i < n; i++)
+                    expectedVectors[i] = models[i] * vectors[i];
+            }, &expectedVectors[0].x,
+            [&](MatrixPath path) { transformVectors(&models[0], &vectors[0], &resultVectors[0], n, path); },
+            &resultVectors[0].x, n * 4) && allExact;
+        allExact = benchmark("normal", n,
+            [&] {
+                for (size_t i = 0; i < n; i++)
+                    expectedNormals[i] = glm::transpose(glm::inverse(glm::mat3(models[i])));
+            }, &expectedNormals[0][0][0],
+            [&](MatrixPath path) { normalMatrices(&models[0], &resultNormals[0], n, path); },
+            &resultNormals[0][0][0], n * 9) && allExact;
+    }
+    SDL_Quit();
+    return allExact ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+// CPU mip chain generation: the scalar reference against the SSE2 and AVX2 paths of mipgen for both
+// filters, checked level by level for identical output, next to glGenerateMipmap on the offscreen
+// context. Also shows what linear-space filtering and coverage preservation change, and how much
+// the on-disk cache saves for this chapter's textures. No display needed
+#include "glad/glad.h"
+#include "context.h"
+#include "mipgen.h"
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+const int SIZE = 4096;
+const int ITERATIONS = 3;
+
+double milliseconds(Uint64 start)
+{
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// noisy colour gradients with a foliage-like cutout: thin alpha-tested blades with soft edges
+void syntheticImage(std::vector<unsigned char> &rgba, int size)
+{
+    rgba.resize((size_t)size * size * 4);
+    unsigned int seed = 12345;
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            unsigned char* p = &rgba[((size_t)y * size + x) * 4];
+            p[0] = (unsigned char)((x * 255 / size + (seed >> 28)) & 255);
+            p[1] = (unsigned char)((y * 255 / size + (seed >> 24 & 15)) & 255);
+            p[2] = (unsigned char)(seed >> 16);
+            // the blades get sparser towards the bottom
+            int blade = (x + y / 8) % (12 + y * 36 / size);
+            p[3] = blade < 3 ? 255 : blade < 5 ? 128 : 0;
+        }
+}
+
+// best of ITERATIONS
+double timeChain(const std::vector<unsigned char> &rgba, int size, const MipOptions &options, KtxTexture &chain)
+{
+    double best = 1e30;
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        buildMipChain(&rgba[0], size, size, options, chain);
+        double ms = milliseconds(start);
+        best = ms < best ? ms : best;
+    }
+    return best;
+}
+
+int maxDifference(const KtxTexture &a, const KtxTexture &b)
+{
+    if (a.data.size() != b.data.size())
+        return 256;
+    int worst = 0;
+    for (size_t i = 0; i < a.data.size(); i++)
+    {
+        int d = abs((int)a.data[i] - (int)b.data[i]);
+        worst = d > worst ? d : worst;
+    }
+    return worst;
+}
+
+// share of a level's texels whose alpha passes the test
+double levelCoverage(const KtxTexture &chain, size_t level, float alphaRef)
+{
+    const KtxLevel &l = chain.levels[level];
+    size_t passed = 0, pixels = (size_t)l.width * l.height;
+    for (size_t i = 0; i < pixels; i++)
+        passed += chain.data[l.offset + i * 4 + 3] >= alphaRef * 255.0f;
+    return (double)passed / pixels;
+}
+
+double timeGenerateMipmap(const std::vector<unsigned char> &rgba, int size)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+    double best = 1e30;
+    for (int i = 0; i <= ITERATIONS; i++)
+    {
+        glFinish();
+        Uint64 start = SDL_GetPerformanceCounter();
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+        double ms = milliseconds(start);
+        // the first round allocates the levels
+        if (i > 0)
+            best = ms < best ? ms : best;
+    }
+    glDeleteTextures(1, &texture);
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    if (SDL_Init(0) < 0)
+        return 1;
+    std::vector<unsigned char> image;
+    syntheticImage(image, SIZE);
+
+    const char* filterNames[] = { "box", "kaiser" };
+    const char* pathNames[] = { "scalar", "SSE2", "AVX2" };
+    std::cout << SIZE << "x" << SIZE << " RGBA8 with an alpha cutout, sRGB, coverage preserved, best of " << ITERATIONS << std::endl;
+    std::cout << "filter\tpath\tms\tMpixel/s\tspeedup\tmax diff" << std::endl;
+    for (int f = 0; f < 2; f++)
+    {
+        MipOptions options;
+        options.filter = (MipFilter)f;
+        KtxTexture reference, chain;
+        double scalarMs = 0.0;
+        for (int p = MIP_SCALAR; p <= MIP_AVX2; p++)
+        {
+            if (!mipPathSupported((MipPath)p))
+            {
+                std::cout << filterNames[f] << "\t" << pathNames[p] << "\tnot supported by this CPU" << std::endl;
+                continue;
+            }
+            options.path = (MipPath)p;
+            double ms = timeChain(image, SIZE, options, p == MIP_SCALAR ? reference : chain);
+            if (p == MIP_SCALAR)
+                scalarMs = ms;
+            std::cout << filterNames[f] << "\t" << pathNames[p] << "\t" << ms << "\t" << (double)SIZE * SIZE / ms / 1000.0 << "\t"
+                      << scalarMs / ms << "x\t" << (p == MIP_SCALAR ? 0 : maxDifference(reference, chain)) << std::endl;
+        }
+    }
+
+    // averaging sRGB bytes darkens a black and white checker to 128, the right answer is ~188
+    std::vector<unsigned char> checker(16 * 16 * 4);
+    for (int i = 0; i < 16 * 16; i++)
+    {
+        unsigned char v = (i % 16 + i / 16) % 2 ? 255 : 0;
+        checker[i * 4] = checker[i * 4 + 1] = checker[i * 4 + 2] = v;
+        checker[i * 4 + 3] = 255;
+    }
+    MipOptions srgb, linear;
+    linear.srgb = false;
+    KtxTexture srgbChain, linearChain;
+    buildMipChain(&checker[0], 16, 16, srgb, srgbChain);
+    buildMipChain(&checker[0], 16, 16, linear, linearChain);
+    std::cout << "Checker level 1: " << (int)srgbChain.data[srgbChain.levels[1].offset] << " filtered as sRGB, "
+              << (int)linearChain.data[linearChain.levels[1].offset] << " as plain bytes" << std::endl;
+
+    MipOptions kept, faded;
+    faded.preserveCoverage = false;
+    KtxTexture keptChain, fadedChain;
+    buildMipChain(&image[0], SIZE, SIZE, kept, keptChain);
+    buildMipChain(&image[0], SIZE, SIZE, faded, fadedChain);
+    std::cout << "Alpha coverage at 0.5, level: preserved / plain" << std::endl;
+    for (size_t level = 0; level < keptChain.levels.size(); level += 2)
+        std::cout << "  " << level << " (" << keptChain.levels[level].width << "): " << levelCoverage(keptChain, level, 0.5f)
+                  << " / " << levelCoverage(fadedChain, level, 0.5f) << std::endl;
+
+    Context* context = createContext(true);
+    if (context->create("bench_mipgen", 64, 64))
+        std::cout << "glGenerateMipmap " << SIZE << "x" << SIZE << " on " << glGetString(GL_RENDERER) << ": "
+                  << timeGenerateMipmap(image, SIZE) << " ms (bytes averaged as they are, no coverage)" << std::endl;
+    delete context;
+
+    // the cache next to each image, built once and then read back
+    const char* files[] = { "texture.jpg", "awesomeface.png" };
+    for (int i = 0; i < 2; i++)
+    {
+        MipOptions options;
+        remove(mipCachePath(files[i], options).c_str());
+        KtxTexture chain;
+        bool cached;
+        Uint64 start = SDL_GetPerformanceCounter();
+        if (!loadMipChain(files[i], options, chain, &cached))
+        {
+            std::cout << files[i] << ": failed to load" << std::endl;
+            continue;
+        }
+        double buildMs = milliseconds(start);
+        start = SDL_GetPerformanceCounter();
+        loadMipChain(files[i], options, chain, &cached);
+        double cacheMs = milliseconds(start);
+        std::cout << files[i] << " " << chain.width() << "x" << chain.height() << ": decode and build " << buildMs << " ms, "
+                  << (cached ? "from cache " : "cache not written, rebuilt ") << cacheMs << " ms" << std::endl;
+    }
+    SDL_Quit();
+    return 0;
+}
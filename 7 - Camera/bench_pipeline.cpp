@@ -0,0 +1,246 @@
+// A 100,000 cube scene drawn through the FramePipeline on the offscreen context: a thousand spinning
+// clusters of cubes in a transform hierarchy, their world boxes, frustum culling and the draw list are
+// built each frame, on the GL thread between submissions without workers and a frame ahead on 1 to
+// all hardware threads with them. Every run has to produce the same draw lists. No display needed
+#include "glad/glad.h"
+#include "context.h"
+#include "camera.h"
+#include "shader.h"
+#include "frame_uniforms.h"
+#include "instancing.h"
+#include "frame_pipeline.h"
+#include "transforms.h"
+#include "culling.h"
+#include "bvh.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+const unsigned int CLUSTERS = 1000;
+const unsigned int CUBES_PER_CLUSTER = 100;
+const int FRAMES = 60;
+// the fewest objects a parallelFor() job gets
+const size_t GRAIN = 2048;
+
+struct Random
+{
+    unsigned int seed;
+
+    Random() : seed(12345) {}
+    float next()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    }
+};
+
+// The scene a build advances: cluster roots on a grid with their cubes around them, every root
+// turning a little each frame so every cube moves, and the camera circling the grid
+struct Scene
+{
+    TransformHierarchy transforms;
+    std::vector<uint32_t> roots;
+    std::vector<uint32_t> cubes;
+    BoundingVolumes bounds;
+    std::vector<uint32_t> visible;
+    Camera camera;
+    uint64_t frame;
+
+    Scene() : bounds(BoundingVolumes::BOXES), frame(0)
+    {
+        Random random;
+        transforms.reserve(CLUSTERS * CUBES_PER_CLUSTER);
+        for (unsigned int c = 0; c < CLUSTERS; c++)
+        {
+            glm::vec3 center(float(c % 32) * 12.0f - 186.0f, 0.0f, float(c / 32) * 12.0f - 186.0f);
+            uint32_t root = transforms.add(TransformHierarchy::NO_PARENT, center);
+            roots.push_back(root);
+            cubes.push_back(root);
+            for (unsigned int i = 1; i < CUBES_PER_CLUSTER; i++)
+            {
+                glm::vec3 offset = glm::vec3(random.next(), random.next(), random.next()) * 8.0f - 4.0f;
+                cubes.push_back(transforms.add(root, offset, glm::angleAxis(random.next() * 6.28f, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.3f)));
+            }
+        }
+        for (size_t i = 0; i < cubes.size(); i++)
+            bounds.addBox(glm::vec3(0.0f), glm::vec3(0.0f));
+        camera.SetPerspective(45.0f, 800.0f / 600.0f, 0.1f, 400.0f);
+    }
+
+    // without jobs everything runs on the calling thread
+    void forEach(JobSystem* jobs, size_t count, const std::function<void(size_t, size_t)> &work)
+    {
+        if (jobs)
+            jobs->parallelFor(count, work, GRAIN);
+        else
+            work(0, count);
+    }
+
+    void build(RenderPacket &packet, JobSystem* jobs)
+    {
+        // simulation
+        for (size_t r = 0; r < roots.size(); r++)
+            transforms.setRotation(roots[r], glm::angleAxis(0.01f * frame + r, glm::vec3(0.0f, 1.0f, 0.0f)));
+        if (jobs)
+            transforms.update(*jobs);
+        else
+            transforms.update();
+        float angle = 0.005f * frame;
+        camera.Place(glm::vec3(sinf(angle), 0.25f, cosf(angle)) * 150.0f, -90.0f - glm::degrees(angle), -10.0f);
+        frame++;
+
+        // world boxes and culling
+        forEach(jobs, cubes.size(), [this](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                glm::vec3 min, max;
+                transformBox(transforms.world(cubes[i]), glm::vec3(-0.5f), glm::vec3(0.5f), min, max);
+                bounds.centerX[i] = (min.x + max.x) * 0.5f;
+                bounds.centerY[i] = (min.y + max.y) * 0.5f;
+                bounds.centerZ[i] = (min.z + max.z) * 0.5f;
+                bounds.extentX[i] = (max.x - min.x) * 0.5f;
+                bounds.extentY[i] = (max.y - min.y) * 0.5f;
+                bounds.extentZ[i] = (max.z - min.z) * 0.5f;
+            }
+        });
+        if (jobs)
+            cullParallel(*jobs, bounds, camera.GetFrustumPlanes(), visible);
+        else
+        {
+            visible.resize(cubes.size());
+            visible.resize(cull(bounds, camera.GetFrustumPlanes(), 0, cubes.size(), &visible[0]));
+        }
+
+        // draw list
+        packet.view = camera.GetViewMatrix();
+        packet.projection = camera.GetProjectionMatrix();
+        packet.cameraPosition = camera.GetPosition();
+        packet.time = (float)packet.frame / 60.0f;
+        packet.changed = true;
+        packet.ids = visible;
+        packet.models.resize(visible.size());
+        forEach(jobs, visible.size(), [this, &packet](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                packet.models[i] = transforms.world(cubes[visible[i]]);
+        });
+    }
+};
+
+struct RunResult
+{
+    double frameMs;
+    PipelineStats stats;
+    std::vector<uint64_t> drawLists;    // a hash of each frame's draw list
+};
+
+RunResult run(unsigned int workers, InstanceBuffer &instances, Shader &shader, FrameUniforms &frameUniforms, Context &context)
+{
+    Scene scene;
+    FramePipeline pipeline(workers);
+    pipeline.onBuild = [&scene, &pipeline](RenderPacket &packet) { scene.build(packet, pipeline.jobs()); };
+    RunResult result;
+    pipeline.build();
+    Uint64 start = 0;
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        // the first frame fills the caches and is not timed
+        if (frame == 1)
+            start = SDL_GetPerformanceCounter();
+        RenderPacket &packet = pipeline.acquire();
+        if (frame + 1 < FRAMES)
+            pipeline.build();
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < packet.ids.size(); i++)
+            hash = (hash ^ packet.ids[i]) * 1099511628211ull;
+        result.drawLists.push_back(hash ^ packet.models.size());
+
+        frameUniforms.update(packet.view, packet.projection, packet.cameraPosition, packet.time);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader.use();
+        instances.update(packet.models.empty() ? NULL : &packet.models[0], packet.models.size(), packet.ids.empty() ? NULL : &packet.ids[0]);
+        instances.draw(GL_TRIANGLES, 0, 36);
+        pipeline.release();
+        context.swap();
+    }
+    result.frameMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / (FRAMES - 1);
+    pipeline.finish();
+    result.stats = pipeline.stats();
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    if (SDL_Init(0) < 0)
+        return 1;
+    Context* context = createContext(true);
+    if (!context->create("bench_pipeline", 800, 600))
+    {
+        delete context;
+        SDL_Quit();
+        return 1;
+    }
+    glEnable(GL_DEPTH_TEST);
+    // a cube, only positions and texture coordinates matter here
+    std::vector<float> vertices;
+    const int faces[6][3] = { {0, 1, 2}, {0, 1, 2}, {1, 2, 0}, {1, 2, 0}, {2, 0, 1}, {2, 0, 1} };
+    const float corners[6][2] = { {0, 0}, {1, 0}, {1, 1}, {1, 1}, {0, 1}, {0, 0} };
+    for (int f = 0; f < 6; f++)
+        for (int v = 0; v < 6; v++)
+        {
+            float p[3];
+            p[faces[f][0]] = corners[v][0] - 0.5f;
+            p[faces[f][1]] = corners[v][1] - 0.5f;
+            p[faces[f][2]] = f % 2 ? 0.5f : -0.5f;
+            vertices.insert(vertices.end(), p, p + 3);
+            vertices.insert(vertices.end(), corners[v], corners[v] + 2);
+        }
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    gGLState.bindVertexArray(vao);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    gGLState.bindVertexArray(0);
+    InstanceBuffer instances(vao);
+    Shader shader("instanced.vert", "instanced.frag");
+    FrameUniforms frameUniforms;
+    frameUniforms.init();
+    shader.bindUniformBlock("PerFrame", PER_FRAME_BINDING);
+
+    unsigned int hardware = std::max(std::thread::hardware_concurrency(), 2u);
+    std::vector<unsigned int> counts(1, 0);
+    for (unsigned int w = 1; w <= hardware; w *= 2)
+        counts.push_back(w);
+    if (counts.back() != hardware)
+        counts.push_back(hardware);
+    std::cout << CLUSTERS * CUBES_PER_CLUSTER << " cubes, " << FRAMES << " frames, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << "workers\tframe ms\tbuild ms\tGL wait ms\tGL submit ms\tspeedup\tsame draw lists" << std::endl;
+    RunResult serial;
+    bool allMatch = true;
+    for (size_t c = 0; c < counts.size(); c++)
+    {
+        RunResult result = run(counts[c], instances, shader, frameUniforms, *context);
+        if (c == 0)
+            serial = result;
+        bool match = result.drawLists == serial.drawLists;
+        allMatch = allMatch && match;
+        double n = (double)result.stats.frames;
+        std::cout << counts[c] << "\t" << result.frameMs << "\t" << result.stats.buildMs / n << "\t" << result.stats.waitMs / n << "\t"
+                  << result.stats.submitMs / n << "\t" << serial.frameMs / result.frameMs << "x\t" << (match ? "yes" : "NO") << std::endl;
+    }
+
+    instances.release();
+    frameUniforms.release();
+    gGLState.deleteVertexArrays(1, &vao);
+    gGLState.deleteBuffers(1, &vbo);
+    delete context;
+    SDL_Quit();
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+// Draw lists of a thousand to a million draws, each with one of 8 programs, 64 texture sets and 16
+// vertex arrays picked at random and a tenth of them blended: state changes drawing them in the order
+// they were added against sorted by RenderQueue, and the radix sort against std::stable_sort on the
+// same keys. Every sort is checked to match stable_sort, to keep opaque draws ahead of blended ones
+// and to run them front to back and back to front. No display needed
+#include "render_queue.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+const int ITERATIONS = 5;
+
+struct Random
+{
+    unsigned int seed;
+
+    Random() : seed(12345) {}
+    float next()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    }
+};
+
+struct Draw
+{
+    uint64_t key;
+    uint32_t payload;
+
+    bool operator<(const Draw &other) const { return key < other.key; }
+};
+
+double milliseconds(Uint64 start)
+{
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// opaque before blended, opaque draws with the same state nearest first, blended ones farthest first.
+// Depths closer than the keys keep them may come in either order
+bool ordered(const RenderQueue &queue, const std::vector<float> &depths)
+{
+    for (size_t i = 1; i < queue.size(); i++)
+    {
+        uint64_t a = queue.key(i - 1), b = queue.key(i);
+        float first = depths[queue.payload(i - 1)], second = depths[queue.payload(i)];
+        if (RenderQueue::blended(a) && !RenderQueue::blended(b))
+            return false;
+        if (RenderQueue::blended(a) && RenderQueue::blended(b) && first < second * 0.9999f)
+            return false;
+        if (!RenderQueue::blended(b) && (a >> RenderQueue::DEPTH_BITS) == (b >> RenderQueue::DEPTH_BITS) && second < first * 0.9999f)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (SDL_Init(0) < 0)
+        return 1;
+    std::cout << "Best of " << ITERATIONS << std::endl;
+    std::cout << "draws\tchanges added\tchanges sorted\tper draw added\tper draw sorted\tradix ms\tstable_sort ms\tspeedup\tcorrect" << std::endl;
+    bool allCorrect = true;
+    for (size_t n = 1000; n <= 1000000; n *= 10)
+    {
+        Random random;
+        std::vector<uint64_t> keys(n);
+        std::vector<float> depths(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            depths[i] = 0.1f + random.next() * 100.0f;
+            bool blended = random.next() < 0.1f;
+            keys[i] = RenderQueue::makeKey(0, blended, (unsigned int)(random.next() * 8), (unsigned int)(random.next() * 64),
+                                           (unsigned int)(random.next() * 16), depths[i]);
+        }
+
+        RenderQueue queue;
+        StateChanges added, sorted;
+        double radixMs = 1e30, stableMs = 1e30;
+        for (int it = 0; it < ITERATIONS; it++)
+        {
+            queue.clear();
+            for (size_t i = 0; i < n; i++)
+                queue.add(keys[i], (uint32_t)i);
+            added = queue.stateChanges();
+            Uint64 start = SDL_GetPerformanceCounter();
+            queue.sort();
+            radixMs = std::min(radixMs, milliseconds(start));
+            sorted = queue.stateChanges();
+        }
+        std::vector<Draw> draws(n);
+        for (int it = 0; it < ITERATIONS; it++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                draws[i].key = keys[i];
+                draws[i].payload = (uint32_t)i;
+            }
+            Uint64 start = SDL_GetPerformanceCounter();
+            std::stable_sort(draws.begin(), draws.end());
+            stableMs = std::min(stableMs, milliseconds(start));
+        }
+
+        bool correct = ordered(queue, depths);
+        for (size_t i = 0; i < n && correct; i++)
+            correct = queue.key(i) == draws[i].key && queue.payload(i) == draws[i].payload;
+        allCorrect = allCorrect && correct;
+        std::cout << n << "\t" << added.total() << "\t" << sorted.total() << "\t" << (double)added.total() / n << "\t"
+                  << (double)sorted.total() / n << "\t" << radixMs << "\t" << stableMs << "\t" << stableMs / radixMs << "x\t"
+                  << (correct ? "yes" : "NO") << std::endl;
+    }
+    SDL_Quit();
+    return allCorrect ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// World matrices of a million node hierarchy: rebuilding every one from translate/rotate/scale chains
+// each frame against TransformHierarchy::update() on one thread and across the job system, with
+// none to all of the nodes changed per frame. The results are checked against the rebuilt matrices
+// and the parallel update against the single-threaded one. No display needed
+#include "transforms.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+const uint32_t NODES = 1000000;
+const int FRAMES = 5;
+
+double milliseconds(Uint64 start)
+{
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+struct Random
+{
+    unsigned int seed;
+
+    Random() : seed(12345) {}
+    float next()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    }
+};
+
+// what a scene without the hierarchy does, parents come first in id order
+void rebuildAll(const TransformHierarchy &transforms, const std::vector<uint32_t> &parent, std::vector<glm::mat4> &worlds)
+{
+    for (uint32_t id = 0; id < transforms.size(); id++)
+    {
+        glm::mat4 model = parent[id] == TransformHierarchy::NO_PARENT ? glm::mat4(1.0f) : worlds[parent[id]];
+        model = glm::translate(model, transforms.position(id));
+        model = model * glm::mat4_cast(transforms.rotation(id));
+        worlds[id] = glm::scale(model, transforms.scale(id));
+    }
+}
+
+float maxDifference(const TransformHierarchy &transforms, const std::vector<glm::mat4> &worlds)
+{
+    float worst = 0.0f;
+    for (uint32_t id = 0; id < transforms.size(); id++)
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                worst = std::max(worst, fabsf(transforms.world(id)[c][r] - worlds[id][c][r]));
+    return worst;
+}
+
+int main(int argc, char* argv[])
+{
+    if (SDL_Init(0) < 0)
+        return 1;
+    // a few thousand roots, every later node hangs off a random earlier one, like props on props.
+    // Nodes come in no particular depth order, the first update sorts them
+    Random random;
+    std::vector<uint32_t> parent(NODES);
+    TransformHierarchy sequential, parallel;
+    sequential.reserve(NODES);
+    parallel.reserve(NODES);
+    for (uint32_t id = 0; id < NODES; id++)
+    {
+        parent[id] = id < 2000 ? TransformHierarchy::NO_PARENT : (uint32_t)(random.next() * id);
+        glm::vec3 position = glm::vec3(random.next(), random.next(), random.next()) * 2.0f - 1.0f;
+        glm::quat rotation = glm::angleAxis(random.next() * 6.28f, glm::normalize(glm::vec3(random.next(), random.next(), random.next()) + 0.1f));
+        glm::vec3 scale(0.9f + random.next() * 0.2f);
+        sequential.add(parent[id], position, rotation, scale);
+        parallel.add(parent[id], position, rotation, scale);
+    }
+    JobSystem jobs;
+    Uint64 start = SDL_GetPerformanceCounter();
+    sequential.update();
+    double firstMs = milliseconds(start);
+    parallel.update(jobs);
+    std::cout << NODES << " nodes in " << sequential.depth() << " levels, sorted and computed in " << firstMs << " ms, "
+              << jobs.size() << " threads in parallel" << std::endl;
+
+    std::vector<glm::mat4> rebuilt(NODES);
+    std::cout << "changed\tupdated\trebuild all ms\tupdate ms\tparallel ms\tspeedup\tparallel speedup\tmax diff\tparallel matches" << std::endl;
+    const double ratios[] = { 0.0, 0.001, 0.01, 0.1, 1.0 };
+    bool allMatch = true;
+    for (int r = 0; r < 5; r++)
+    {
+        double rebuildMs = 0.0, updateMs = 0.0, parallelMs = 0.0;
+        size_t updated = 0;
+        uint32_t changed = (uint32_t)(ratios[r] * NODES);
+        for (int frame = 0; frame < FRAMES; frame++)
+        {
+            // every changed node turns a little, the same ones in both hierarchies
+            for (uint32_t i = 0; i < changed; i++)
+            {
+                uint32_t id = changed == NODES ? i : (uint32_t)(random.next() * NODES);
+                glm::quat rotation = glm::normalize(glm::angleAxis(0.01f, glm::vec3(0.0f, 1.0f, 0.0f)) * sequential.rotation(id));
+                sequential.setRotation(id, rotation);
+                parallel.setRotation(id, rotation);
+            }
+            start = SDL_GetPerformanceCounter();
+            rebuildAll(sequential, parent, rebuilt);
+            rebuildMs += milliseconds(start);
+            start = SDL_GetPerformanceCounter();
+            updated = sequential.update();
+            updateMs += milliseconds(start);
+            start = SDL_GetPerformanceCounter();
+            parallel.update(jobs);
+            parallelMs += milliseconds(start);
+        }
+        rebuildMs /= FRAMES;
+        updateMs /= FRAMES;
+        parallelMs /= FRAMES;
+        bool match = true;
+        for (uint32_t id = 0; id < NODES && match; id++)
+            match = sequential.world(id) == parallel.world(id);
+        allMatch = allMatch && match;
+        std::cout << ratios[r] * 100.0 << "%\t" << updated << "\t" << rebuildMs << "\t" << updateMs << "\t" << parallelMs << "\t"
+                  << rebuildMs / updateMs << "x\t" << rebuildMs / parallelMs << "x\t" << maxDifference(sequential, rebuilt) << "\t"
+                  << (match ? "yes" : "NO") << std::endl;
+    }
+    SDL_Quit();
+    return allMatch ? 0 : 1;
+}
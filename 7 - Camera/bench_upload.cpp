@@ -0,0 +1,139 @@
+// Upload throughput for 4K images in common SDL pixel formats: converting to tightly packed RGBA8 on the
+// CPU first (what SDL_ConvertSurfaceFormat-based loaders do) against handing the surface to GL as it is
+// through texture_upload. Runs on the offscreen context, no display needed
+#include "glad/glad.h"
+#include "context.h"
+#include "texture_upload.h"
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+const int WIDTH = 3840;
+const int HEIGHT = 2160;
+const int ITERATIONS = 5;
+// rows are padded like a surface cut out of a larger one, so GL_UNPACK_ROW_LENGTH has work to do
+const int PITCH_PADDING = 256;
+
+struct BenchFormat
+{
+    const char* name;
+    Uint32 format;
+    int bytesPerPixel;
+    bool colourPalette;
+};
+
+double seconds(Uint64 start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+// average time of one glTexImage2D of the surface, including the driver's own copy/convert
+double timeUpload(SDL_Surface* surface, bool repack)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    double total = 0.0;
+    for (int i = 0; i <= ITERATIONS; i++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        if (repack)
+        {
+            SDL_Surface* rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, rgba->w, rgba->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba->pixels);
+            SDL_FreeSurface(rgba);
+        }
+        else
+            uploadSurface(GL_TEXTURE_2D, surface);
+        glFinish();
+        // the first round only warms up the driver
+        if (i > 0)
+            total += seconds(start);
+    }
+    glDeleteTextures(1, &texture);
+    return total / ITERATIONS;
+}
+
+int main(int argc, char* argv[])
+{
+    if (SDL_Init(0) < 0)
+        return 1;
+    Context* context = createContext(true);
+    if (!context->create("bench_upload", 64, 64))
+    {
+        delete context;
+        return 1;
+    }
+
+    BenchFormat formats[] = {
+        { "RGB24", SDL_PIXELFORMAT_RGB24, 3, false },
+        { "BGR24", SDL_PIXELFORMAT_BGR24, 3, false },
+        { "ARGB8888", SDL_PIXELFORMAT_ARGB8888, 4, false },
+        { "ABGR8888", SDL_PIXELFORMAT_ABGR8888, 4, false },
+        { "RGB565", SDL_PIXELFORMAT_RGB565, 2, false },
+        { "INDEX8 grey", SDL_PIXELFORMAT_INDEX8, 1, false },
+        { "INDEX8 colour", SDL_PIXELFORMAT_INDEX8, 1, true },
+    };
+
+    std::cout << WIDTH << "x" << HEIGHT << ", pitch padded by " << PITCH_PADDING << " bytes, " << ITERATIONS << " uploads each" << std::endl;
+    std::cout << "format\tsource MB\trepack ms\tdirect ms\tdirect MB/s\tspeedup" << std::endl;
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+    {
+        const BenchFormat &bench = formats[f];
+        int pitch = WIDTH * bench.bytesPerPixel + PITCH_PADDING;
+        std::vector<unsigned char> pixels((size_t)pitch * HEIGHT);
+        for (size_t i = 0; i < pixels.size(); i++)
+            pixels[i] = (unsigned char)(i * 2654435761u >> 24);
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(&pixels[0], WIDTH, HEIGHT, bench.bytesPerPixel * 8, pitch, bench.format);
+        if (!surface)
+            continue;
+        if (surface->format->palette)
+        {
+            SDL_Palette* palette = surface->format->palette;
+            for (int i = 0; i < palette->ncolors; i++)
+            {
+                SDL_Color c = { (Uint8)i, (Uint8)i, (Uint8)i, 255 };
+                if (bench.colourPalette)
+                    c.g = (Uint8)(255 - i);
+                palette->colors[i] = c;
+            }
+        }
+
+        double sourceMB = (double)WIDTH * HEIGHT * bench.bytesPerPixel / (1024.0 * 1024.0);
+        double repack = timeUpload(surface, true);
+        double direct = timeUpload(surface, false);
+        std::cout << bench.name << "\t" << sourceMB << "\t" << repack * 1000.0 << "\t" << direct * 1000.0 << "\t"
+                  << sourceMB / direct << "\t" << repack / direct << "x" << std::endl;
+        SDL_FreeSurface(surface);
+    }
+
+    // the one conversion that remains, colour palettes, with and without AVX2 gathers
+    std::vector<unsigned char> indices((size_t)WIDTH * HEIGHT), rgba((size_t)WIDTH * HEIGHT * 4);
+    for (size_t i = 0; i < indices.size(); i++)
+        indices[i] = (unsigned char)(i * 2654435761u >> 24);
+    SDL_Color colors[256];
+    for (int i = 0; i < 256; i++)
+    {
+        SDL_Color c = { (Uint8)i, (Uint8)(255 - i), (Uint8)(i * 3), 255 };
+        colors[i] = c;
+    }
+    SDL_Palette palette;
+    memset(&palette, 0, sizeof(palette));
+    palette.ncolors = 256;
+    palette.colors = colors;
+    std::cout << "palette expansion\tscalar ms\tsimd ms\tspeedup" << std::endl;
+    double times[2];
+    for (int simd = 0; simd < 2; simd++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < ITERATIONS; i++)
+            expandIndexed(&indices[0], WIDTH, WIDTH, HEIGHT, &palette, &rgba[0], WIDTH * 4, simd == 1);
+        times[simd] = seconds(start) / ITERATIONS;
+    }
+    std::cout << "INDEX8 -> RGBA8\t" << times[0] * 1000.0 << "\t" << times[1] * 1000.0 << "\t" << times[0] / times[1] << "x" << std::endl;
+
+    delete context;
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,481 @@
+#include "bvh.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// split candidates per node along the axis its centres spread most
+static const int BINS = 16;
+// relative cost of visiting a node against testing one object, objects are tested several at a time
+static const float TRAVERSAL_COST = 2.0f;
+// past this depth nodes are split at the median, which bounds the depth of any tree to SAH_DEPTH + 32
+static const int SAH_DEPTH = 40;
+static const int STACK_SIZE = 128;
+
+// an object during the build, partitioned in place so each node's objects stay contiguous in memory
+struct BuildItem
+{
+    glm::vec3 min;
+    uint32_t id;
+    glm::vec3 max;
+};
+
+struct BuildState
+{
+    std::vector<BuildItem> items;
+    std::vector<BvhNode>* nodes;
+    std::vector<uint32_t>* parents;
+};
+
+// half the surface area, only ever compared with other areas
+static float area(const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 d = max - min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static uint32_t addNode(BuildState &state, uint32_t parent)
+{
+    BvhNode node = BvhNode();
+    state.nodes->push_back(node);
+    state.parents->push_back(parent);
+    return (uint32_t)state.nodes->size() - 1;
+}
+
+static void buildNode(BuildState &state, uint32_t node, uint32_t first, uint32_t last, int depth)
+{
+    // centres are kept doubled, min + max, which bins just as well without the multiply
+    BuildItem* items = &state.items[0];
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX), centerMin(FLT_MAX), centerMax(-FLT_MAX);
+    for (uint32_t i = first; i < last; i++)
+    {
+        min = glm::min(min, items[i].min);
+        max = glm::max(max, items[i].max);
+        glm::vec3 center = items[i].min + items[i].max;
+        centerMin = glm::min(centerMin, center);
+        centerMax = glm::max(centerMax, center);
+    }
+    (*state.nodes)[node].min = min;
+    (*state.nodes)[node].max = max;
+
+    uint32_t count = last - first;
+    glm::vec3 spread = centerMax - centerMin;
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+    float offset = centerMin[axis];
+    uint32_t mid = first;
+    if (count > 1 && spread[axis] > 0.0f && depth < SAH_DEPTH)
+    {
+        // bin the centres, then sweep from both sides for the area and count left and right of each bin boundary
+        struct Bin
+        {
+            glm::vec3 min, max;
+            uint32_t count;
+        } bins[BINS];
+        for (int b = 0; b < BINS; b++)
+        {
+            bins[b].min = glm::vec3(FLT_MAX);
+            bins[b].max = glm::vec3(-FLT_MAX);
+            bins[b].count = 0;
+        }
+        float scale = BINS / spread[axis];
+        for (uint32_t i = first; i < last; i++)
+        {
+            int b = std::min(BINS - 1, (int)((items[i].min[axis] + items[i].max[axis] - offset) * scale));
+            bins[b].min = glm::min(bins[b].min, items[i].min);
+            bins[b].max = glm::max(bins[b].max, items[i].max);
+            bins[b].count++;
+        }
+        float rightArea[BINS];
+        uint32_t rightCount[BINS];
+        glm::vec3 sweepMin(FLT_MAX), sweepMax(-FLT_MAX);
+        uint32_t sweepCount = 0;
+        for (int b = BINS - 1; b > 0; b--)
+        {
+            sweepMin = glm::min(sweepMin, bins[b].min);
+            sweepMax = glm::max(sweepMax, bins[b].max);
+            sweepCount += bins[b].count;
+            rightArea[b] = sweepCount ? area(sweepMin, sweepMax) : 0.0f;
+            rightCount[b] = sweepCount;
+        }
+        // the split after bin b sends bins 0 to b left
+        float bestCost = FLT_MAX;
+        int bestBin = -1;
+        sweepMin = glm::vec3(FLT_MAX);
+        sweepMax = glm::vec3(-FLT_MAX);
+        sweepCount = 0;
+        for (int b = 0; b < BINS - 1; b++)
+        {
+            sweepMin = glm::min(sweepMin, bins[b].min);
+            sweepMax = glm::max(sweepMax, bins[b].max);
+            sweepCount += bins[b].count;
+            if (sweepCount == 0 || rightCount[b + 1] == 0)
+                continue;
+            float cost = area(sweepMin, sweepMax) * sweepCount + rightArea[b + 1] * rightCount[b + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestBin = b;
+            }
+        }
+        // a leaf costs one test per object, a split the visit plus each side's tests weighted by the
+        // chance a query that reaches this node also reaches that side
+        float nodeArea = area(min, max);
+        float splitCost = TRAVERSAL_COST + (nodeArea > 0.0f ? bestCost / nodeArea : (float)count);
+        if (bestBin >= 0 && (count > Bvh::MAX_LEAF || splitCost < (float)count))
+        {
+            BuildItem* split = std::partition(items + first, items + last, [&](const BuildItem &item)
+            {
+                return std::min(BINS - 1, (int)((item.min[axis] + item.max[axis] - offset) * scale)) <= bestBin;
+            });
+            mid = (uint32_t)(split - items);
+        }
+    }
+    if (mid == first && count > Bvh::MAX_LEAF)
+    {
+        // too deep or all centres in one spot, halve the objects instead
+        mid = first + count / 2;
+        std::nth_element(items + first, items + mid, items + last, [axis](const BuildItem &a, const BuildItem &b)
+        {
+            return a.min[axis] + a.max[axis] < b.min[axis] + b.max[axis];
+        });
+    }
+    if (mid == first)
+    {
+        (*state.nodes)[node].index = first;
+        (*state.nodes)[node].count = count;
+        return;
+    }
+
+    // depth first: the left subtree directly follows its parent, the right one after the whole left subtree
+    uint32_t left = addNode(state, node);
+    buildNode(state, left, first, mid, depth + 1);
+    uint32_t right = addNode(state, node);
+    (*state.nodes)[node].index = right;
+    buildNode(state, right, mid, last, depth + 1);
+}
+
+// object i of from as a box at slot of to, spheres as the box around them
+static void copyBox(const BoundingVolumes &from, size_t i, BoundingVolumes &to, size_t slot)
+{
+    to.centerX[slot] = from.centerX[i];
+    to.centerY[slot] = from.centerY[i];
+    to.centerZ[slot] = from.centerZ[i];
+    bool spheres = from.shape == BoundingVolumes::SPHERES;
+    to.extentX[slot] = spheres ? from.radius[i] : from.extentX[i];
+    to.extentY[slot] = spheres ? from.radius[i] : from.extentY[i];
+    to.extentZ[slot] = spheres ? from.radius[i] : from.extentZ[i];
+}
+
+void transformBox(const glm::mat4 &matrix, const glm::vec3 &min, const glm::vec3 &max, glm::vec3 &outMin, glm::vec3 &outMax)
+{
+    // Arvo: the centre moves with the matrix, each new half size sums the old ones scaled by the absolute rotation
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    glm::vec3 newCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+    glm::vec3 newExtent(0.0f);
+    for (int column = 0; column < 3; column++)
+        for (int row = 0; row < 3; row++)
+            newExtent[row] += fabsf(matrix[column][row]) * extent[column];
+    outMin = newCenter - newExtent;
+    outMax = newCenter + newExtent;
+}
+
+Bvh::Bvh()
+    : boxes(BoundingVolumes::BOXES)
+{
+}
+
+void Bvh::build(const BoundingVolumes &objects)
+{
+    size_t n = objects.size();
+    nodes.clear();
+    parents.clear();
+    boxes.clear();
+    if (n == 0)
+    {
+        objectIndex.clear();
+        slotOf.clear();
+        leafOf.clear();
+        return;
+    }
+
+    BuildState state;
+    state.items.resize(n);
+    bool spheres = objects.shape == BoundingVolumes::SPHERES;
+    for (size_t i = 0; i < n; i++)
+    {
+        glm::vec3 center(objects.centerX[i], objects.centerY[i], objects.centerZ[i]);
+        glm::vec3 extent = spheres ? glm::vec3(objects.radius[i]) : glm::vec3(objects.extentX[i], objects.extentY[i], objects.extentZ[i]);
+        state.items[i].min = center - extent;
+        state.items[i].max = center + extent;
+        state.items[i].id = (uint32_t)i;
+    }
+    // leaves of a few objects take about half a node per object
+    nodes.reserve(n / 2 + 1);
+    parents.reserve(n / 2 + 1);
+    state.nodes = &nodes;
+    state.parents = &parents;
+    addNode(state, 0);
+    buildNode(state, 0, 0, (uint32_t)n, 0);
+    nodes.shrink_to_fit();
+    parents.shrink_to_fit();
+
+    // the boxes move into leaf order, so every subtree's objects are one contiguous range
+    objectIndex.resize(n);
+    for (size_t slot = 0; slot < n; slot++)
+        objectIndex[slot] = state.items[slot].id;
+    std::vector<BuildItem>().swap(state.items);
+    slotOf.resize(n);
+    leafOf.resize(n);
+    boxes.centerX.resize(n);
+    boxes.centerY.resize(n);
+    boxes.centerZ.resize(n);
+    boxes.extentX.resize(n);
+    boxes.extentY.resize(n);
+    boxes.extentZ.resize(n);
+    for (size_t slot = 0; slot < n; slot++)
+    {
+        slotOf[objectIndex[slot]] = (uint32_t)slot;
+        copyBox(objects, objectIndex[slot], boxes, slot);
+    }
+    for (uint32_t node = 0; node < nodes.size(); node++)
+        for (uint32_t i = 0; i < nodes[node].count; i++)
+            leafOf[nodes[node].index + i] = node;
+}
+
+size_t Bvh::cull(const Plane planes[6], std::vector<uint32_t> &visible, CullPath path) const
+{
+    visible.resize(objectIndex.size());
+    if (nodes.empty())
+        return 0;
+    glm::vec3 absNormals[6];
+    for (int p = 0; p < 6; p++)
+        absNormals[p] = glm::abs(planes[p].Normal);
+
+    // each entry carries the planes its node still straddles, a node inside a plane's half space
+    // passes that on to everything below it
+    struct Entry
+    {
+        uint32_t node;
+        uint32_t planes;
+    } stack[STACK_SIZE];
+    int top = 0;
+    stack[top].node = 0;
+    stack[top++].planes = 63;
+    size_t count = 0;
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+        const BvhNode &node = nodes[entry.node];
+        uint32_t mask = entry.planes;
+        glm::vec3 center = (node.min + node.max) * 0.5f;
+        glm::vec3 extent = (node.max - node.min) * 0.5f;
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; p++)
+        {
+            if (!(mask & (1 << p)))
+                continue;
+            float d = glm::dot(planes[p].Normal, center) + planes[p].Distance;
+            float r = glm::dot(absNormals[p], extent);
+            outside = d < -r;
+            if (d >= r)
+                mask &= ~(1u << p);
+        }
+        if (outside)
+            continue;
+
+        if (mask == 0)
+        {
+            // entirely in view: from the leftmost to the rightmost leaf below, no more tests
+            uint32_t leftmost = entry.node, rightmost = entry.node;
+            while (nodes[leftmost].count == 0)
+                leftmost++;
+            while (nodes[rightmost].count == 0)
+                rightmost = nodes[rightmost].index;
+            uint32_t first = nodes[leftmost].index, last = nodes[rightmost].index + nodes[rightmost].count;
+            memcpy(&visible[count], &objectIndex[first], (last - first) * sizeof(uint32_t));
+            count += last - first;
+        }
+        else if (node.count > 0)
+        {
+            // a leaf across the edge, its objects are tested together. No slot is written twice, so there
+            // is room for the leaf's slots past count
+            size_t found = ::cull(boxes, planes, node.index, node.index + node.count, &visible[count], path);
+            for (size_t i = 0; i < found; i++)
+                visible[count + i] = objectIndex[visible[count + i]];
+            count += found;
+        }
+        else
+        {
+            stack[top].node = node.index;
+            stack[top++].planes = mask;
+            stack[top].node = entry.node + 1;
+            stack[top++].planes = mask;
+        }
+    }
+    visible.resize(count);
+    return count;
+}
+
+// distance along the ray where it enters the box, clamped to 0 for a start inside, if it does before maxDistance
+static bool rayBox(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &origin, const glm::vec3 &inverse, float maxDistance, float &distance)
+{
+    glm::vec3 t1 = (min - origin) * inverse;
+    glm::vec3 t2 = (max - origin) * inverse;
+    glm::vec3 near = glm::min(t1, t2), far = glm::max(t1, t2);
+    float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float exit = std::min(std::min(far.x, far.y), far.z);
+    distance = enter;
+    return enter <= exit && enter < maxDistance;
+}
+
+bool Bvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, RayHit &hit, float maxDistance) const
+{
+    if (nodes.empty())
+        return false;
+    // a zero component gives infinities, which the slab test handles
+    glm::vec3 inverse = 1.0f / direction;
+    float best = maxDistance;
+    bool found = false;
+    struct Entry
+    {
+        uint32_t node;
+        float distance;
+    } stack[STACK_SIZE];
+    int top = 0;
+    float distance;
+    if (!rayBox(nodes[0].min, nodes[0].max, origin, inverse, best, distance))
+        return false;
+    stack[top].node = 0;
+    stack[top++].distance = distance;
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+        // something closer was hit since this node was pushed
+        if (entry.distance >= best)
+            continue;
+        const BvhNode &node = nodes[entry.node];
+        if (node.count > 0)
+        {
+            for (uint32_t slot = node.index; slot < node.index + node.count; slot++)
+            {
+                glm::vec3 center(boxes.centerX[slot], boxes.centerY[slot], boxes.centerZ[slot]);
+                glm::vec3 extent(boxes.extentX[slot], boxes.extentY[slot], boxes.extentZ[slot]);
+                if (rayBox(center - extent, center + extent, origin, inverse, best, distance))
+                {
+                    best = distance;
+                    hit.object = objectIndex[slot];
+                    hit.distance = distance;
+                    found = true;
+                }
+            }
+            continue;
+        }
+        // the nearer child goes on top, so its hits can rule out the farther one
+        uint32_t left = entry.node + 1, right = node.index;
+        float leftDistance, rightDistance;
+        bool hitLeft = rayBox(nodes[left].min, nodes[left].max, origin, inverse, best, leftDistance);
+        bool hitRight = rayBox(nodes[right].min, nodes[right].max, origin, inverse, best, rightDistance);
+        if (hitLeft && hitRight && leftDistance > rightDistance)
+        {
+            std::swap(left, right);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (hitRight)
+        {
+            stack[top].node = right;
+            stack[top++].distance = rightDistance;
+        }
+        if (hitLeft)
+        {
+            stack[top].node = left;
+            stack[top++].distance = leftDistance;
+        }
+    }
+    return found;
+}
+
+void Bvh::fitLeaf(uint32_t node)
+{
+    BvhNode &leaf = nodes[node];
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (uint32_t slot = leaf.index; slot < leaf.index + leaf.count; slot++)
+    {
+        glm::vec3 center(boxes.centerX[slot], boxes.centerY[slot], boxes.centerZ[slot]);
+        glm::vec3 extent(boxes.extentX[slot], boxes.extentY[slot], boxes.extentZ[slot]);
+        min = glm::min(min, center - extent);
+        max = glm::max(max, center + extent);
+    }
+    leaf.min = min;
+    leaf.max = max;
+}
+
+// returns false when the bounds came out the same, nothing above needs refitting then
+bool Bvh::fitInner(uint32_t node)
+{
+    BvhNode &inner = nodes[node];
+    const BvhNode &left = nodes[node + 1], &right = nodes[inner.index];
+    glm::vec3 min = glm::min(left.min, right.min), max = glm::max(left.max, right.max);
+    if (min == inner.min && max == inner.max)
+        return false;
+    inner.min = min;
+    inner.max = max;
+    return true;
+}
+
+void Bvh::update(uint32_t object, const glm::vec3 &min, const glm::vec3 &max)
+{
+    uint32_t slot = slotOf[object];
+    // the same arithmetic as BoundingVolumes::addBox(), so the leaf test matches a flat cull
+    boxes.centerX[slot] = (min.x + max.x) * 0.5f;
+    boxes.centerY[slot] = (min.y + max.y) * 0.5f;
+    boxes.centerZ[slot] = (min.z + max.z) * 0.5f;
+    boxes.extentX[slot] = (max.x - min.x) * 0.5f;
+    boxes.extentY[slot] = (max.y - min.y) * 0.5f;
+    boxes.extentZ[slot] = (max.z - min.z) * 0.5f;
+    uint32_t node = leafOf[slot];
+    fitLeaf(node);
+    while (node != 0)
+    {
+        node = parents[node];
+        if (!fitInner(node))
+            break;
+    }
+}
+
+void Bvh::refit(const BoundingVolumes &objects)
+{
+    for (size_t slot = 0; slot < objectIndex.size(); slot++)
+        copyBox(objects, objectIndex[slot], boxes, slot);
+    // children always come after their parent, so walking backwards fits them first
+    for (size_t node = nodes.size(); node-- > 0;)
+    {
+        if (nodes[node].count > 0)
+            fitLeaf((uint32_t)node);
+        else
+            fitInner((uint32_t)node);
+    }
+}
+
+float Bvh::cost() const
+{
+    if (nodes.empty())
+        return 0.0f;
+    double rootArea = area(nodes[0].min, nodes[0].max), total = 0.0;
+    if (rootArea <= 0.0)
+        return (float)objectIndex.size();
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        double share = area(nodes[i].min, nodes[i].max) / rootArea;
+        total += share * (nodes[i].count > 0 ? nodes[i].count : TRAVERSAL_COST);
+    }
+    return (float)total;
+}
+
+size_t Bvh::memoryBytes() const
+{
+    size_t bytes = nodes.capacity() * sizeof(BvhNode) + parents.capacity() * sizeof(uint32_t);
+    bytes += (boxes.centerX.capacity() + boxes.centerY.capacity() + boxes.centerZ.capacity()) * sizeof(float);
+    bytes += (boxes.extentX.capacity() + boxes.extentY.capacity() + boxes.extentZ.capacity()) * sizeof(float);
+    bytes += (objectIndex.capacity() + slotOf.capacity() + leafOf.capacity()) * sizeof(uint32_t);
+    return bytes;
+}
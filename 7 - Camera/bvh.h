@@ -0,0 +1,78 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "culling.h"
+#include <glm/glm.hpp>
+#include <float.h>
+#include <stdint.h>
+#include <vector>
+
+// One node of the flattened tree, 32 bytes so two share a cache line. Nodes are stored depth first:
+// an inner node's left child directly follows it and index holds the right one, a leaf's objects
+// are the count slots starting at index
+struct BvhNode
+{
+    glm::vec3 min;
+    uint32_t index;
+    glm::vec3 max;
+    uint32_t count;     // 0 for inner nodes
+};
+
+struct RayHit
+{
+    uint32_t object;
+    float distance;     // along the ray, in units of its direction's length
+};
+
+// The world-space box around a box transformed by matrix, without transforming its eight corners
+void transformBox(const glm::mat4 &matrix, const glm::vec3 &min, const glm::vec3 &max, glm::vec3 &outMin, glm::vec3 &outMax);
+
+// Bounding volume hierarchy over the axis-aligned boxes of a static or slowly changing scene. Built
+// top down with the surface area heuristic, so culling and ray queries skip whole groups of objects
+// instead of visiting each one. Each leaf's boxes sit next to each other in a BoundingVolumes set,
+// leaves only partly in view are handed to the SIMD cull() a leaf at a time.
+// Objects are identified by their index in the set the tree was built from
+class Bvh
+{
+public:
+    // most objects per leaf, one AVX2 cull step
+    static const uint32_t MAX_LEAF = 8;
+
+    Bvh();
+    // spheres are treated as the boxes around them
+    void build(const BoundingVolumes &objects);
+
+    // Writes the objects at least partly inside all six planes to visible, resized to their count,
+    // in leaf order rather than by index. For boxes that is the same set cull() finds over every object
+    size_t cull(const Plane planes[6], std::vector<uint32_t> &visible, CullPath path = CULL_BEST) const;
+    // Closest object whose box the ray enters within maxDistance, a start inside a box hits it at 0
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, RayHit &hit, float maxDistance = FLT_MAX) const;
+
+    // Moves one object and refits the nodes above it, stopping at the first one whose bounds stay
+    // the same. The tree keeps its shape, so its quality drops as objects wander far; compare cost()
+    // with a fresh build to decide when to rebuild
+    void update(uint32_t object, const glm::vec3 &min, const glm::vec3 &max);
+    // Takes every object's bounds from objects again and refits the whole tree bottom up,
+    // cheaper than update() once a large share of the objects moved
+    void refit(const BoundingVolumes &objects);
+
+    size_t size() const { return objectIndex.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    // expected cost of a query relative to testing the root alone, lower is better
+    float cost() const;
+    // everything the tree keeps, the nodes and the per-object arrays
+    size_t memoryBytes() const;
+
+private:
+    std::vector<BvhNode> nodes;
+    BoundingVolumes boxes;              // object bounds in leaf order
+    std::vector<uint32_t> objectIndex;  // slot in boxes -> object
+    std::vector<uint32_t> slotOf;       // object -> slot in boxes
+    std::vector<uint32_t> leafOf;       // slot -> leaf node
+    std::vector<uint32_t> parents;      // node -> parent, the root is its own
+
+    void fitLeaf(uint32_t node);
+    bool fitInner(uint32_t node);
+};
+
+#endif
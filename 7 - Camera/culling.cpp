@@ -0,0 +1,287 @@
+#include "culling.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CULLING_X86 1
+#endif
+
+// objects per parallel job, a multiple of 8 so only the last chunk has a scalar tail
+static const size_t CHUNK = 16384;
+
+void BoundingVolumes::reserve(size_t n)
+{
+    centerX.reserve(n);
+    centerY.reserve(n);
+    centerZ.reserve(n);
+    if (shape == SPHERES)
+        radius.reserve(n);
+    else
+    {
+        extentX.reserve(n);
+        extentY.reserve(n);
+        extentZ.reserve(n);
+    }
+}
+
+void BoundingVolumes::clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+size_t BoundingVolumes::addSphere(const glm::vec3 &center, float r)
+{
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    radius.push_back(r);
+    return centerX.size() - 1;
+}
+
+size_t BoundingVolumes::addBox(const glm::vec3 &min, const glm::vec3 &max)
+{
+    centerX.push_back((min.x + max.x) * 0.5f);
+    centerY.push_back((min.y + max.y) * 0.5f);
+    centerZ.push_back((min.z + max.z) * 0.5f);
+    extentX.push_back((max.x - min.x) * 0.5f);
+    extentY.push_back((max.y - min.y) * 0.5f);
+    extentZ.push_back((max.z - min.z) * 0.5f);
+    return centerX.size() - 1;
+}
+
+bool cullPathSupported(CullPath path)
+{
+    switch (path)
+    {
+        case CULL_SCALAR:
+        case CULL_BEST:
+            return true;
+#ifdef CULLING_X86
+        case CULL_SSE:
+            return __builtin_cpu_supports("sse2");
+        case CULL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static CullPath resolvePath(CullPath path)
+{
+    if (path != CULL_BEST)
+        return cullPathSupported(path) ? path : CULL_SCALAR;
+    if (cullPathSupported(CULL_AVX2))
+        return CULL_AVX2;
+    return cullPathSupported(CULL_SSE) ? CULL_SSE : CULL_SCALAR;
+}
+
+// An object is culled when it lies entirely on the outside of one plane: its centre is further out than
+// its radius, or for a box than the box's extent projected onto the plane normal. Every path evaluates
+// dot(n, c) + d and the projected extent in the same order, so they agree on every object
+
+static size_t cullScalar(const BoundingVolumes &v, const Plane planes[6], size_t first, size_t last, uint32_t* visible)
+{
+    bool spheres = v.shape == BoundingVolumes::SPHERES;
+    size_t count = 0;
+    for (size_t i = first; i < last; i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++)
+        {
+            const Plane &plane = planes[p];
+            float d = plane.Normal.x * v.centerX[i] + plane.Normal.y * v.centerY[i] + plane.Normal.z * v.centerZ[i] + plane.Distance;
+            float r = spheres ? v.radius[i] : fabsf(plane.Normal.x) * v.extentX[i] + fabsf(plane.Normal.y) * v.extentY[i] + fabsf(plane.Normal.z) * v.extentZ[i];
+            inside = d >= -r;
+        }
+        visible[count] = (uint32_t)i;
+        count += inside;
+    }
+    return count;
+}
+
+#ifdef CULLING_X86
+__attribute__((target("sse2")))
+static size_t cullSSE(const BoundingVolumes &v, const Plane planes[6], size_t first, size_t last, uint32_t* visible)
+{
+    bool spheres = v.shape == BoundingVolumes::SPHERES;
+    __m128 nx[6], ny[6], nz[6], nd[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; p++)
+    {
+        nx[p] = _mm_set1_ps(planes[p].Normal.x);
+        ny[p] = _mm_set1_ps(planes[p].Normal.y);
+        nz[p] = _mm_set1_ps(planes[p].Normal.z);
+        nd[p] = _mm_set1_ps(planes[p].Distance);
+        ax[p] = _mm_set1_ps(fabsf(planes[p].Normal.x));
+        ay[p] = _mm_set1_ps(fabsf(planes[p].Normal.y));
+        az[p] = _mm_set1_ps(fabsf(planes[p].Normal.z));
+    }
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t count = 0, i = first;
+    for (; i + 4 <= last; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&v.centerX[i]);
+        __m128 y = _mm_loadu_ps(&v.centerY[i]);
+        __m128 z = _mm_loadu_ps(&v.centerZ[i]);
+        __m128 r = _mm_setzero_ps(), ex = r, ey = r, ez = r;
+        if (spheres)
+            r = _mm_loadu_ps(&v.radius[i]);
+        else
+        {
+            ex = _mm_loadu_ps(&v.extentX[i]);
+            ey = _mm_loadu_ps(&v.extentY[i]);
+            ez = _mm_loadu_ps(&v.extentZ[i]);
+        }
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)), _mm_mul_ps(nz[p], z)), nd[p]);
+            if (!spheres)
+                r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_xor_ps(r, sign)));
+        }
+        // one bit per visible object, written out lowest first
+        int mask = _mm_movemask_ps(inside);
+        while (mask)
+        {
+            visible[count++] = (uint32_t)(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return count + cullScalar(v, planes, i, last, visible + count);
+}
+
+// for every 8-bit mask, the lanes of the set bits moved to the front
+struct CompactTable
+{
+    uint32_t lanes[256][8];
+
+    CompactTable()
+    {
+        for (int mask = 0; mask < 256; mask++)
+        {
+            int n = 0;
+            for (int lane = 0; lane < 8; lane++)
+                if (mask & (1 << lane))
+                    lanes[mask][n++] = lane;
+            for (; n < 8; n++)
+                lanes[mask][n] = 0;
+        }
+    }
+};
+
+static const CompactTable& compactTable()
+{
+    static CompactTable table;
+    return table;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t cullAVX2(const BoundingVolumes &v, const Plane planes[6], size_t first, size_t last, uint32_t* visible)
+{
+    const CompactTable &table = compactTable();
+    bool spheres = v.shape == BoundingVolumes::SPHERES;
+    __m256 nx[6], ny[6], nz[6], nd[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; p++)
+    {
+        nx[p] = _mm256_set1_ps(planes[p].Normal.x);
+        ny[p] = _mm256_set1_ps(planes[p].Normal.y);
+        nz[p] = _mm256_set1_ps(planes[p].Normal.z);
+        nd[p] = _mm256_set1_ps(planes[p].Distance);
+        ax[p] = _mm256_set1_ps(fabsf(planes[p].Normal.x));
+        ay[p] = _mm256_set1_ps(fabsf(planes[p].Normal.y));
+        az[p] = _mm256_set1_ps(fabsf(planes[p].Normal.z));
+    }
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    size_t count = 0, i = first;
+    for (; i + 8 <= last; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(&v.centerX[i]);
+        __m256 y = _mm256_loadu_ps(&v.centerY[i]);
+        __m256 z = _mm256_loadu_ps(&v.centerZ[i]);
+        __m256 r = _mm256_setzero_ps(), ex = r, ey = r, ez = r;
+        if (spheres)
+            r = _mm256_loadu_ps(&v.radius[i]);
+        else
+        {
+            ex = _mm256_loadu_ps(&v.extentX[i]);
+            ey = _mm256_loadu_ps(&v.extentY[i]);
+            ez = _mm256_loadu_ps(&v.extentZ[i]);
+        }
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], x), _mm256_mul_ps(ny[p], y)), _mm256_mul_ps(nz[p], z)), nd[p]);
+            if (!spheres)
+                r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_xor_ps(r, sign), _CMP_GE_OQ));
+        }
+        // branch-free compaction: the visible indices are shuffled to the front and all 8 lanes stored,
+        // count only advances past the valid ones. count <= i - first, so the store stays inside visible
+        int mask = _mm256_movemask_ps(inside);
+        __m256i indices = _mm256_add_epi32(_mm256_set1_epi32((int)i), lanes);
+        __m256i order = _mm256_loadu_si256((const __m256i*)table.lanes[mask]);
+        _mm256_storeu_si256((__m256i*)(visible + count), _mm256_permutevar8x32_epi32(indices, order));
+        count += _mm_popcnt_u32(mask);
+    }
+    return count + cullScalar(v, planes, i, last, visible + count);
+}
+#endif
+
+size_t cull(const BoundingVolumes &volumes, const Plane planes[6], size_t first, size_t last, uint32_t* visible, CullPath path)
+{
+    switch (resolvePath(path))
+    {
+#ifdef CULLING_X86
+        case CULL_AVX2:
+            return cullAVX2(volumes, planes, first, last, visible);
+        case CULL_SSE:
+            return cullSSE(volumes, planes, first, last, visible);
+#endif
+        default:
+            return cullScalar(volumes, planes, first, last, visible);
+    }
+}
+
+size_t cullParallel(JobSystem &jobs, const BoundingVolumes &volumes, const Plane planes[6], std::vector<uint32_t> &visible, CullPath path)
+{
+    size_t n = volumes.size();
+    visible.resize(n);
+    if (n <= CHUNK)
+    {
+        visible.resize(cull(volumes, planes, 0, n, visible.empty() ? NULL : &visible[0], path));
+        return visible.size();
+    }
+
+    // each chunk's indices land at the start of its own slice of visible
+    size_t chunks = (n + CHUNK - 1) / CHUNK;
+    std::vector<size_t> counts(chunks);
+    uint32_t* out = &visible[0];
+    path = resolvePath(path);
+    jobs.parallelFor(chunks, [&](size_t firstChunk, size_t lastChunk) {
+        for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+        {
+            size_t first = chunk * CHUNK, last = std::min(first + CHUNK, n);
+            counts[chunk] = cull(volumes, planes, first, last, out + first, path);
+        }
+    }, 1);
+
+    // close the gaps between the chunks' results, nothing moves forward past its own chunk
+    size_t count = counts[0];
+    for (size_t chunk = 1; chunk < chunks; chunk++)
+    {
+        memmove(&visible[count], &visible[chunk * CHUNK], counts[chunk] * sizeof(uint32_t));
+        count += counts[chunk];
+    }
+    visible.resize(count);
+    return count;
+}
@@ -0,0 +1,53 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "camera.h"
+#include "job_system.h"
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+enum CullPath
+{
+    CULL_SCALAR,    // the reference the SIMD paths are checked against
+    CULL_SSE,       // 4 objects per test
+    CULL_AVX2,      // 8 objects per test
+    CULL_BEST       // the widest path the CPU supports
+};
+
+// Bounding volumes of many objects in structure-of-arrays form: one array per component, so a SIMD
+// register loads the same component of 4 or 8 consecutive objects with a single instruction.
+// A set holds either spheres or axis-aligned boxes, both stored as a centre plus radius or half size
+struct BoundingVolumes
+{
+    enum Shape
+    {
+        SPHERES,
+        BOXES
+    };
+
+    Shape shape;
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> radius;                      // spheres only
+    std::vector<float> extentX, extentY, extentZ;   // boxes only, half the size along each axis
+
+    BoundingVolumes(Shape shape = SPHERES) : shape(shape) {}
+    size_t size() const { return centerX.size(); }
+    void reserve(size_t n);
+    void clear();
+    // both return the index the object is culled under
+    size_t addSphere(const glm::vec3 &center, float r);
+    size_t addBox(const glm::vec3 &min, const glm::vec3 &max);
+};
+
+// Writes the indices of the volumes in [first, last) that are at least partly inside all six planes
+// (Camera::GetFrustumPlanes()) to visible, in increasing order, and returns how many there are.
+// visible must have room for last - first entries; the AVX2 path stores whole registers past the count
+size_t cull(const BoundingVolumes &volumes, const Plane planes[6], size_t first, size_t last, uint32_t* visible, CullPath path = CULL_BEST);
+// The same over all volumes, split into chunks across the job system's threads, the calling one
+// included. visible is resized to the number of visible objects
+size_t cullParallel(JobSystem &jobs, const BoundingVolumes &volumes, const Plane planes[6], std::vector<uint32_t> &visible, CullPath path = CULL_BEST);
+
+bool cullPathSupported(CullPath path);
+
+#endif
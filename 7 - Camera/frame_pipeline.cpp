@@ -0,0 +1,105 @@
+#include "frame_pipeline.h"
+#include <algorithm>
+
+void Fence::signal(uint64_t frames)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        value = std::max(value, frames);
+    }
+    reached.notify_all();
+}
+
+void Fence::wait(uint64_t frames)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    reached.wait(lock, [this, frames] { return value >= frames; });
+}
+
+uint64_t Fence::completed()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return value;
+}
+
+void PipelineStats::print(std::ostream &out, unsigned int workers) const
+{
+    double n = frames ? (double)frames : 1.0;
+    out << "Pipeline: " << workers << " workers, per frame " << buildMs / n << " ms building, GL thread "
+        << waitMs / n << " ms waiting and " << submitMs / n << " ms submitting" << std::endl;
+}
+
+FramePipeline::FramePipeline(unsigned int workers)
+    : jobSystem(workers ? new JobSystem(workers + 1) : NULL), nextBuild(0), nextSubmit(0), acquired(0)
+{
+    building[0] = building[1] = NULL;
+}
+
+FramePipeline::~FramePipeline()
+{
+    finish();
+    delete jobSystem;
+}
+
+void FramePipeline::build()
+{
+    // one build at a time, each one carries on from the state the one before left
+    built.wait(nextBuild);
+    uint64_t frame = nextBuild++;
+    if (jobSystem)
+    {
+        building[frame % 2] = jobSystem->create([this, frame] { run(frame); });
+        jobSystem->run(building[frame % 2]);
+    }
+    else
+        run(frame);
+}
+
+void FramePipeline::run(uint64_t frame)
+{
+    RenderPacket &packet = packets[frame % 2];
+    // the packet was last submitted as frame - 2
+    submitted.wait(frame >= 2 ? frame - 1 : 0);
+    Uint64 start = SDL_GetPerformanceCounter();
+    packet.frame = frame;
+    if (onBuild)
+        onBuild(packet);
+    packet.buildMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    built.signal(frame + 1);
+}
+
+RenderPacket& FramePipeline::acquire()
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    // the GL thread runs jobs of the build, or anything else queued, rather than idle
+    JobSystem::Job* &job = building[nextSubmit % 2];
+    if (job)
+    {
+        jobSystem->wait(job);
+        job = NULL;
+    }
+    built.wait(nextSubmit + 1);
+    acquired = SDL_GetPerformanceCounter();
+    RenderPacket &packet = packets[nextSubmit % 2];
+    pipelineStats.waitMs += (acquired - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    pipelineStats.buildMs += packet.buildMs;
+    return packet;
+}
+
+void FramePipeline::release()
+{
+    pipelineStats.submitMs += (SDL_GetPerformanceCounter() - acquired) * 1000.0 / SDL_GetPerformanceFrequency();
+    pipelineStats.frames++;
+    submitted.signal(++nextSubmit);
+}
+
+void FramePipeline::finish()
+{
+    for (int i = 0; i < 2; i++)
+        if (building[i])
+        {
+            jobSystem->wait(building[i]);
+            building[i] = NULL;
+        }
+    built.wait(nextBuild);
+}
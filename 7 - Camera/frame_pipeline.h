@@ -0,0 +1,112 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include "job_system.h"
+#include <SDL2/SDL.h>
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+// How far one stage of the frame pipeline has got: the stage signals the number of frames it has
+// finished and the stage after it waits for the count it needs, the CPU side of a GL sync object
+class Fence
+{
+public:
+    Fence() : value(0) {}
+    void signal(uint64_t frames);
+    // blocks until at least frames have been signalled
+    void wait(uint64_t frames);
+    uint64_t completed();
+
+private:
+    std::mutex mutex;
+    std::condition_variable reached;
+    uint64_t value;
+};
+
+// Everything the GL thread needs to submit one frame, built without touching GL
+struct RenderPacket
+{
+    uint64_t frame;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 cameraPosition;
+    float time;
+    // the draw list: model matrices of the visible objects and their indices before culling
+    std::vector<glm::mat4> models;
+    std::vector<uint32_t> ids;
+    // how many pixels across each of them is on screen, for streaming its textures
+    std::vector<float> screenSizes;
+    // false when the draw list is the same as the frame before's, so there is nothing to upload
+    bool changed;
+    double buildMs;
+
+    RenderPacket() : frame(0), time(0.0f), changed(true), buildMs(0.0) {}
+};
+
+struct PipelineStats
+{
+    unsigned long frames;
+    double buildMs;         // building packets, summed over all frames
+    double waitMs;          // the GL thread waiting for a packet to be ready
+    double submitMs;        // from a packet's acquire() to its release()
+
+    PipelineStats() : frames(0), buildMs(0.0), waitMs(0.0), submitMs(0.0) {}
+    void print(std::ostream &out, unsigned int workers) const;
+};
+
+// Two render packets in flight: while the GL thread submits frame N from one, frame N + 1 is built into
+// the other on a worker thread, simulation, culling and the draw list included. Two fences order them:
+// a packet is acquired once its build has signalled, and rebuilt once the GL thread has released it.
+// Builds run one after another, so the state they advance needs no locking as long as the GL thread
+// leaves it alone; input reaches a build through whatever onBuild captures before build() is called
+class FramePipeline
+{
+public:
+    // fills the packet of the next frame, on a worker thread or, without workers, inside build().
+    // It may split its stages across jobs()
+    std::function<void(RenderPacket&)> onBuild;
+
+    // workers = 0 builds every packet on the calling thread, the single-threaded baseline. Create it
+    // on the GL thread, which then helps with the build's jobs while it waits in acquire()
+    FramePipeline(unsigned int workers);
+    // waits for the build in flight
+    ~FramePipeline();
+
+    // starts building the frame after the last one, once the build before it is done. Call it once
+    // before the first acquire() and then after every acquire()
+    void build();
+    // waits for the packet of the next frame to submit, GL thread only
+    RenderPacket& acquire();
+    // the packet acquire() returned has been submitted and may be built into again
+    void release();
+    // waits until every build started so far is done
+    void finish();
+
+    // NULL without workers
+    JobSystem* jobs() { return jobSystem; }
+    unsigned int workers() const { return jobSystem ? jobSystem->workers() : 0; }
+    const PipelineStats& stats() const { return pipelineStats; }
+
+private:
+    JobSystem* jobSystem;
+    RenderPacket packets[2];
+    JobSystem::Job* building[2];    // the build job of each packet, until acquire() has waited for it
+    Fence built;            // frames whose packet is complete
+    Fence submitted;        // frames the GL thread is done with
+    uint64_t nextBuild;
+    uint64_t nextSubmit;
+    Uint64 acquired;
+    PipelineStats pipelineStats;
+
+    void run(uint64_t frame);
+
+    FramePipeline(const FramePipeline&);
+    FramePipeline& operator=(const FramePipeline&);
+};
+
+#endif
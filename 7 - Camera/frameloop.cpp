@@ -0,0 +1,111 @@
+#include "frameloop.h"
+
+FrameStats::FrameStats()
+    : frames(0), updates(0), events(0), totalSeconds(0.0), lastFrameMs(0.0), minFrameMs(0.0), maxFrameMs(0.0)
+{
+}
+
+double FrameStats::avgFrameMs() const
+{
+    return frames ? totalSeconds * 1000.0 / frames : 0.0;
+}
+
+double FrameStats::framesPerSecond() const
+{
+    return totalSeconds > 0.0 ? frames / totalSeconds : 0.0;
+}
+
+double FrameStats::eventsPerFrame() const
+{
+    return frames ? (double)events / frames : 0.0;
+}
+
+void FrameStats::print(std::ostream &out) const
+{
+    out << "Frames: " << frames << " in " << totalSeconds << " s (" << framesPerSecond() << " fps)" << std::endl;
+    out << "Frame time (ms): avg " << avgFrameMs() << ", min " << minFrameMs << ", max " << maxFrameMs << std::endl;
+    out << "Simulation steps: " << updates << ", events: " << events << " (" << eventsPerFrame() << " per frame)" << std::endl;
+}
+
+FrameLoop::FrameLoop(Context &context, float timestep)
+    : profiler(NULL), context(context), step(timestep), maxElapsed(0.25f), accumulator(0.0), lastCounter(0), lastPresent(0), running(true)
+{
+}
+
+void FrameLoop::run(unsigned long maxFrames)
+{
+    while (frame())
+    {
+        if (maxFrames && frameStats.frames >= maxFrames)
+            break;
+    }
+}
+
+bool FrameLoop::frame()
+{
+    const double frequency = (double)SDL_GetPerformanceFrequency();
+    if (lastCounter == 0)
+        lastCounter = lastPresent = SDL_GetPerformanceCounter();
+
+    // 1. drain every pending event before doing any work for this frame
+    SDL_Event e;
+    while (SDL_PollEvent(&e) != 0)
+    {
+        frameStats.events++;
+        if (onEvent)
+            onEvent(e);
+    }
+    if (!running)
+        return false;
+
+    // 2. advance the simulation in fixed steps to catch up with real time
+    Uint64 now = SDL_GetPerformanceCounter();
+    double elapsed = (now - lastCounter) / frequency;
+    lastCounter = now;
+    if (elapsed > maxElapsed)
+        elapsed = maxElapsed;
+    accumulator += elapsed;
+    while (accumulator >= step)
+    {
+        if (onUpdate)
+            onUpdate(step);
+        frameStats.updates++;
+        accumulator -= step;
+    }
+
+    // 3. render and present exactly once
+    if (profiler)
+    {
+        profiler->beginFrame();
+        profiler->begin("frame");
+    }
+    if (onRender)
+        onRender((float)(accumulator / step));
+    if (profiler)
+        profiler->begin("swap");
+    context.swap();
+    if (profiler)
+    {
+        profiler->end();
+        profiler->end();
+        profiler->endFrame();
+    }
+
+    // frame time is measured from the end of the previous frame to the end of this one
+    Uint64 end = SDL_GetPerformanceCounter();
+    double frameMs = (end - lastPresent) / frequency * 1000.0;
+    lastPresent = end;
+    frameStats.frames++;
+    frameStats.lastFrameMs = frameMs;
+    frameStats.totalSeconds += frameMs / 1000.0;
+    if (frameStats.frames == 1 || frameMs < frameStats.minFrameMs)
+        frameStats.minFrameMs = frameMs;
+    if (frameMs > frameStats.maxFrameMs)
+        frameStats.maxFrameMs = frameMs;
+    return running;
+}
+
+void FrameLoop::quit()
+{
+    running = false;
+}
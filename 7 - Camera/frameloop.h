@@ -0,0 +1,66 @@
+#ifndef FRAMELOOP_H
+#define FRAMELOOP_H
+
+#include <SDL2/SDL.h>
+#include "context.h"
+#include "profiler.h"
+#include <functional>
+#include <iostream>
+
+// Frame-time statistics gathered by the FrameLoop. Frames and events are counted separately so that
+// it's easy to see the number of rendered frames no longer depends on how many input events arrive
+struct FrameStats
+{
+    unsigned long frames;       // rendered (swapped) frames
+    unsigned long updates;      // fixed-timestep simulation steps
+    unsigned long events;       // SDL events drained from the queue
+    double totalSeconds;        // wall-clock time spent inside the loop
+    double lastFrameMs;
+    double minFrameMs;
+    double maxFrameMs;
+
+    FrameStats();
+    double avgFrameMs() const;
+    double framesPerSecond() const;
+    double eventsPerFrame() const;
+    void print(std::ostream &out) const;
+};
+
+// A reusable main loop: every iteration drains all pending events, advances the simulation in
+// fixed steps to catch up with real time, then renders and swaps exactly once
+class FrameLoop
+{
+public:
+    // called once for every pending SDL event
+    std::function<void(const SDL_Event&)> onEvent;
+    // called zero or more times per frame with the fixed timestep (in seconds)
+    std::function<void(float)> onUpdate;
+    // called once per frame, alpha is how far we are between the last two simulation steps
+    std::function<void(float)> onRender;
+    // when set, each frame and its swap are timed as "frame" and "swap" scopes
+    Profiler* profiler;
+
+    // timestep is the fixed simulation step in seconds
+    FrameLoop(Context &context, float timestep = 1.0f / 60.0f);
+    // runs until quit() is called, or for maxFrames frames when it is non-zero
+    void run(unsigned long maxFrames = 0);
+    // runs a single iteration, returns false once quit() has been called
+    bool frame();
+    void quit();
+
+    float timestep() const { return step; }
+    const FrameStats& stats() const { return frameStats; }
+
+private:
+    Context &context;
+    float step;
+    // clamp on a single frame's elapsed time so a long stall doesn't trigger a burst of updates
+    float maxElapsed;
+    double accumulator;
+    Uint64 lastCounter;
+    Uint64 lastPresent;
+    bool running;
+    FrameStats frameStats;
+};
+
+#endif
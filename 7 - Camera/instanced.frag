@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+flat in int Material;
+
+// every texture of the scene in one bind: layers of an array, or rectangles of an atlas in layer 0 (see atlas.h)
+const int MAX_ENTRIES = 16;
+uniform sampler2DArray textures;
+uniform vec4 entryRect[MAX_ENTRIES];	// u0, v0, width, height
+uniform float entryLayer[MAX_ENTRIES];
+uniform int entryCount;
+
+vec4 sampleEntry(int entry, vec2 uv)
+{
+    vec4 rect = entryRect[entry];
+    // fract() repeats inside the rectangle, the gradients come from the unwrapped coordinates so the seam picks the right mip
+    vec3 coord = vec3(rect.xy + fract(uv) * rect.zw, entryLayer[entry]);
+    return textureGrad(textures, coord, dFdx(uv) * rect.zw, dFdy(uv) * rect.zw);
+}
+
+void main()
+{
+    // material i mixes entry i with the next one, the way shader.frag mixes texture1 and texture2
+    int base = Material % entryCount;
+    FragColor = mix(sampleEntry(base, TexCoord), sampleEntry((base + 1) % entryCount, vec2(TexCoord.x, -TexCoord.y)), 0.2);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in mat4 aModel;	// per-instance, takes locations 2-5
+layout (location = 6) in uint aInstance;	// the instance's index before culling
+
+out vec2 TexCoord;
+flat out int Material;	// selects the instance's textures in instanced.frag
+
+// shared by every program, see frame_uniforms.h
+layout (std140) uniform PerFrame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec3 cameraPos;
+    float time;
+};
+
+void main()
+{
+    gl_Position = viewProj * aModel * vec4(aPos, 1.0);
+    TexCoord = aTexCoord;
+    Material = int(aInstance);
+}
\ No newline at end of file
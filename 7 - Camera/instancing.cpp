@@ -0,0 +1,64 @@
+#include "instancing.h"
+#include "glstate.h"
+
+InstanceBuffer::InstanceBuffer(GLuint vao, GLuint location)
+    : vao(vao), vbo(0), idVbo(0), instances(0), capacity(0)
+{
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &idVbo);
+    gGLState.bindVertexArray(vao);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    // a mat4 attribute takes four consecutive vec4 locations, one per column
+    for (GLuint i = 0; i < 4; i++)
+    {
+        glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(location + i);
+        // advance once per instance instead of once per vertex
+        glVertexAttribDivisor(location + i, 1);
+    }
+    // the id follows the matrix, an integer attribute so it reaches the shader unconverted
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, idVbo);
+    glVertexAttribIPointer(location + 4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glEnableVertexAttribArray(location + 4);
+    glVertexAttribDivisor(location + 4, 1);
+    gGLState.bindVertexArray(0);
+}
+
+void InstanceBuffer::release()
+{
+    gGLState.deleteBuffers(1, &vbo);
+    gGLState.deleteBuffers(1, &idVbo);
+    vbo = idVbo = 0;
+    instances = capacity = 0;
+}
+
+void InstanceBuffer::update(const glm::mat4* models, size_t n, const GLuint* ids)
+{
+    if (!ids)
+    {
+        for (size_t i = sequence.size(); i < n; i++)
+            sequence.push_back((GLuint)i);
+        ids = n ? &sequence[0] : NULL;
+    }
+    bool grow = n > capacity;
+    if (grow)
+        capacity = n;
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    // orphan the old storage so we don't wait for draws still reading it
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), grow ? models : NULL, GL_DYNAMIC_DRAW);
+    if (!grow)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, n * sizeof(glm::mat4), models);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, idVbo);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), grow ? ids : NULL, GL_DYNAMIC_DRAW);
+    if (!grow)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, n * sizeof(GLuint), ids);
+    instances = n;
+}
+
+void InstanceBuffer::draw(GLenum mode, GLint first, GLsizei count) const
+{
+    if (instances == 0)
+        return;
+    gGLState.bindVertexArray(vao);
+    glDrawArraysInstanced(mode, first, count, (GLsizei)instances);
+}
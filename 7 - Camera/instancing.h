@@ -0,0 +1,39 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// Per-instance model matrices stored in a VBO and attached to a VAO as a mat4 attribute with divisor 1,
+// so N copies of a mesh are drawn with a single glDrawArraysInstanced call.
+// The vertex shader reads them with "layout (location = 2) in mat4 aModel;" (locations 2-5 by default)
+// and each instance's index in the full, unculled set with "layout (location = 6) in uint aInstance;"
+class InstanceBuffer
+{
+public:
+    InstanceBuffer(GLuint vao, GLuint location = 2);
+    // free the VBO, call before the GL context is destroyed
+    void release();
+
+    // upload the model matrices, storage is only reallocated when it has to grow. ids are the
+    // instances' indices before culling, NULL numbers them 0 to n - 1
+    void update(const glm::mat4* models, size_t n, const GLuint* ids = NULL);
+    // draw one copy of vertices [first, first + count) per uploaded matrix
+    void draw(GLenum mode, GLint first, GLsizei count) const;
+    size_t size() const { return instances; }
+
+private:
+    GLuint vao;
+    GLuint vbo;
+    GLuint idVbo;
+    size_t instances;
+    size_t capacity;
+    std::vector<GLuint> sequence;
+
+    InstanceBuffer(const InstanceBuffer&);
+    InstanceBuffer& operator=(const InstanceBuffer&);
+};
+
+#endif
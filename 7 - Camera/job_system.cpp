@@ -0,0 +1,315 @@
+#include "job_system.h"
+#include <algorithm>
+
+// jobs a thread can have queued, run() runs any more on the spot
+static const size_t QUEUE_CAPACITY = 4096;
+// rounds of looking for work, with a yield in between, before a thread goes to sleep
+static const int SPINS = 64;
+
+struct JobSystem::Job
+{
+    std::function<void()> work;
+    Job* parent;
+    // the job itself until its work is done, plus its unfinished children
+    std::atomic<int> unfinished;
+    // create()'s handle, one until the job finishes and one per unfinished child
+    std::atomic<int> refs;
+    // someone may be blocked in wait() on it
+    std::atomic<bool> waited;
+};
+
+// the system whose queue the calling thread owns and its index there
+static thread_local const JobSystem* tlsSystem = NULL;
+static thread_local int tlsIndex = -1;
+
+// only the owning thread writes its counters, no read-modify-write needed
+static void count(std::atomic<uint64_t> &counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+JobSystem::JobSystem(unsigned int threads)
+    : inboxSize(0), epoch(0), sleeping(0), stopping(false)
+{
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned int i = 0; i < threads; i++)
+    {
+        queues.push_back(new WorkQueue<Job>(QUEUE_CAPACITY));
+        counters.push_back(new Counters());
+    }
+    tlsSystem = this;
+    tlsIndex = 0;
+    for (unsigned int i = 1; i < threads; i++)
+        workerThreads.push_back(std::thread(&JobSystem::work, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    finished.notify_all();
+    for (size_t i = 0; i < workerThreads.size(); i++)
+        workerThreads[i].join();
+    if (tlsSystem == this)
+        tlsSystem = NULL;
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        while (Job* job = queues[i]->pop())
+            delete job;
+        delete queues[i];
+        delete counters[i];
+    }
+    for (size_t i = 0; i < inbox.size(); i++)
+        delete inbox[i];
+}
+
+JobSystem::Job* JobSystem::create(const std::function<void()> &work, Job* parent)
+{
+    Job* job = new Job;
+    job->work = work;
+    job->parent = parent;
+    job->unfinished = 1;
+    job->refs = 2;
+    job->waited = false;
+    if (parent)
+    {
+        parent->unfinished.fetch_add(1);
+        parent->refs.fetch_add(1);
+    }
+    return job;
+}
+
+void JobSystem::run(Job* job)
+{
+    int index = current();
+    if (index >= 0)
+    {
+        if (!queues[index]->push(job))
+        {
+            execute(job, index);
+            return;
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        inbox.push_back(job);
+        inboxSize++;
+    }
+    notify();
+}
+
+void JobSystem::spawn(const std::function<void()> &work, Job* parent)
+{
+    Job* job = create(work, parent);
+    run(job);
+    release(job);
+}
+
+void JobSystem::wait(Job* job, bool help)
+{
+    int index = current();
+    unsigned int victim = index >= 0 ? index : 0;
+    job->waited = true;
+    while (job->unfinished.load() > 0)
+    {
+        uint64_t seen = epoch.load();
+        if (help)
+        {
+            Job* next = NULL;
+            for (int spin = 0; spin < SPINS && !next && job->unfinished.load() > 0; spin++)
+                if (!(next = find(index, victim)))
+                    std::this_thread::yield();
+            if (next)
+            {
+                execute(next, index);
+                continue;
+            }
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (help)
+        {
+            sleeping++;
+            if (index >= 0)
+                count(counters[index]->sleeps);
+            wake.wait(lock, [this, job, seen] { return stopping || epoch.load() != seen || job->unfinished.load() == 0; });
+            sleeping--;
+            // a run() may have woken this thread instead of a worker, pass it on
+            if (epoch.load() != seen && job->unfinished.load() == 0)
+                wake.notify_one();
+        }
+        else
+            finished.wait(lock, [this, job] { return stopping || job->unfinished.load() == 0; });
+    }
+    release(job);
+}
+
+void JobSystem::release(Job* job)
+{
+    if (job->refs.fetch_sub(1) == 1)
+        delete job;
+}
+
+void JobSystem::parallelFor(size_t count, const std::function<void(size_t, size_t)> &work, size_t grain)
+{
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = std::max<size_t>(count / (queues.size() * 32), 1);
+    if (count <= grain || queues.size() == 1)
+    {
+        work(0, count);
+        return;
+    }
+    // the root has no work of its own, it only waits for the ranges spawned under it
+    Job* root = create(std::function<void()>());
+    splitRange(root, 0, count, grain, work);
+    complete(root);
+    wait(root);
+}
+
+JobStats JobSystem::stats() const
+{
+    JobStats total;
+    for (size_t i = 0; i < counters.size(); i++)
+    {
+        total.executed += counters[i]->executed.load();
+        total.stolen += counters[i]->stolen.load();
+        total.failedSteals += counters[i]->failedSteals.load();
+        total.sleeps += counters[i]->sleeps.load();
+    }
+    return total;
+}
+
+void JobSystem::work(unsigned int index)
+{
+    tlsSystem = this;
+    tlsIndex = index;
+    unsigned int victim = index;
+    for (;;)
+    {
+        // read before looking, a run() that comes after the last look moves it and the wait falls through
+        uint64_t seen = epoch.load();
+        Job* job = NULL;
+        for (int spin = 0; spin < SPINS && !job; spin++)
+        {
+            if (stopping)
+                return;
+            if (!(job = find(index, victim)))
+                std::this_thread::yield();
+        }
+        if (job)
+        {
+            execute(job, index);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping++;
+        count(counters[index]->sleeps);
+        wake.wait(lock, [this, seen] { return stopping || epoch.load() != seen; });
+        sleeping--;
+    }
+}
+
+int JobSystem::current() const
+{
+    return tlsSystem == this ? tlsIndex : -1;
+}
+
+JobSystem::Job* JobSystem::find(int index, unsigned int &victim)
+{
+    if (index >= 0)
+        if (Job* job = queues[index]->pop())
+            return job;
+    if (inboxSize.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        if (!inbox.empty())
+        {
+            Job* job = inbox.front();
+            inbox.pop_front();
+            inboxSize--;
+            return job;
+        }
+    }
+    // the oldest jobs of the others, starting with whoever had some last time
+    unsigned int n = (unsigned int)queues.size();
+    for (unsigned int i = 0; i < n; i++)
+    {
+        unsigned int other = (victim + i) % n;
+        if ((int)other == index)
+            continue;
+        if (Job* job = queues[other]->steal())
+        {
+            victim = other;
+            if (index >= 0)
+                count(counters[index]->stolen);
+            return job;
+        }
+    }
+    if (index >= 0 && n > 1)
+        count(counters[index]->failedSteals);
+    return NULL;
+}
+
+void JobSystem::execute(Job* job, int index)
+{
+    if (job->work)
+        job->work();
+    if (index >= 0)
+        count(counters[index]->executed);
+    complete(job);
+}
+
+void JobSystem::complete(Job* job)
+{
+    if (job->unfinished.fetch_sub(1) != 1)
+        return;
+    Job* parent = job->parent;
+    if (job->waited.load())
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_all();
+        finished.notify_all();
+    }
+    release(job);
+    if (parent)
+    {
+        complete(parent);
+        release(parent);
+    }
+}
+
+void JobSystem::notify()
+{
+    epoch++;
+    if (sleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+}
+
+void JobSystem::splitRange(Job* root, size_t first, size_t last, size_t grain, const std::function<void(size_t, size_t)> &work)
+{
+    int index = current();
+    while (last - first > grain)
+    {
+        // lazy splitting: while this thread still has a job queued the others have something to steal,
+        // so it keeps going a grain at a time and only hands off another half once that one is taken
+        if (index >= 0 && queues[index]->size() > 0)
+        {
+            work(first, first + grain);
+            first += grain;
+            continue;
+        }
+        size_t middle = first + (last - first) / 2;
+        spawn([this, root, middle, last, grain, &work] { splitRange(root, middle, last, grain, work); }, root);
+        last = middle;
+    }
+    work(first, last);
+}
@@ -0,0 +1,176 @@
+#include "ktx.h"
+#include <fstream>
+#include <string.h>
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const unsigned int KTX_ENDIANNESS = 0x04030201;
+
+// the header words that follow the identifier
+struct KtxHeader
+{
+    unsigned int endianness;
+    unsigned int glType;
+    unsigned int glTypeSize;
+    unsigned int glFormat;
+    unsigned int glInternalFormat;
+    unsigned int glBaseInternalFormat;
+    unsigned int pixelWidth;
+    unsigned int pixelHeight;
+    unsigned int pixelDepth;
+    unsigned int numberOfArrayElements;
+    unsigned int numberOfFaces;
+    unsigned int numberOfMipmapLevels;
+    unsigned int bytesOfKeyValueData;
+};
+
+KtxTexture::KtxTexture()
+    : internalFormat(0), format(0), type(0)
+{
+}
+
+unsigned char* KtxTexture::addLevel(int width, int height, size_t size)
+{
+    KtxLevel level;
+    level.width = width;
+    level.height = height;
+    level.offset = data.size();
+    level.size = size;
+    levels.push_back(level);
+    data.resize(data.size() + size);
+    return &data[level.offset];
+}
+
+bool ktxBlockFormat(GLenum internalFormat, BlockFormat &format)
+{
+    if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+        format = BLOCK_BC1;
+    else if (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        format = BLOCK_BC3;
+    else
+        return false;
+    return true;
+}
+
+static size_t levelSize(GLenum internalFormat, int width, int height)
+{
+    BlockFormat format;
+    if (ktxBlockFormat(internalFormat, format))
+        return compressedSize(format, width, height);
+    return (size_t)width * height * 4;
+}
+
+bool readKtx(const std::string &path, KtxTexture &texture)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    unsigned char identifier[12];
+    KtxHeader header;
+    if (!file.read((char*)identifier, sizeof(identifier)) || memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) != 0)
+        return false;
+    if (!file.read((char*)&header, sizeof(header)) || header.endianness != KTX_ENDIANNESS)
+        return false;
+    BlockFormat blockFormat;
+    bool supported = header.glType == 0 ? ktxBlockFormat(header.glInternalFormat, blockFormat)
+                                        : header.glType == GL_UNSIGNED_BYTE && header.glFormat == GL_RGBA;
+    if (!supported || header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 ||
+        header.numberOfArrayElements > 0 || header.numberOfFaces != 1)
+        return false;
+    file.seekg(header.bytesOfKeyValueData, std::ios::cur);
+
+    texture = KtxTexture();
+    texture.internalFormat = header.glType == 0 ? header.glInternalFormat : GL_RGBA8;
+    texture.format = header.glFormat;
+    texture.type = header.glType;
+    unsigned int levels = header.numberOfMipmapLevels ? header.numberOfMipmapLevels : 1;
+    int width = header.pixelWidth, height = header.pixelHeight;
+    for (unsigned int i = 0; i < levels; i++)
+    {
+        unsigned int imageSize;
+        if (!file.read((char*)&imageSize, sizeof(imageSize)) || imageSize != levelSize(texture.internalFormat, width, height))
+            return false;
+        if (!file.read((char*)texture.addLevel(width, height, imageSize), imageSize))
+            return false;
+        // each level is padded to 4 bytes
+        file.seekg(3 - (imageSize + 3) % 4, std::ios::cur);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return true;
+}
+
+bool writeKtx(const std::string &path, const KtxTexture &texture)
+{
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file || texture.levels.empty())
+        return false;
+    KtxHeader header;
+    header.endianness = KTX_ENDIANNESS;
+    header.glType = texture.type;
+    header.glTypeSize = 1;
+    header.glFormat = texture.format;
+    header.glInternalFormat = texture.internalFormat;
+    header.glBaseInternalFormat = texture.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? GL_RGB : GL_RGBA;
+    header.pixelWidth = texture.width();
+    header.pixelHeight = texture.height();
+    header.pixelDepth = 0;
+    header.numberOfArrayElements = 0;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (unsigned int)texture.levels.size();
+    header.bytesOfKeyValueData = 0;
+    file.write((const char*)KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    file.write((const char*)&header, sizeof(header));
+
+    const char padding[3] = { 0, 0, 0 };
+    for (size_t i = 0; i < texture.levels.size(); i++)
+    {
+        const KtxLevel &level = texture.levels[i];
+        unsigned int imageSize = (unsigned int)level.size;
+        file.write((const char*)&imageSize, sizeof(imageSize));
+        file.write((const char*)&texture.data[level.offset], level.size);
+        file.write(padding, 3 - (imageSize + 3) % 4);
+    }
+    // close here so a failed flush is reported too
+    file.close();
+    return (bool)file;
+}
+
+bool s3tcSupported()
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_EXT_texture_compression_s3tc") == 0)
+            return true;
+    return false;
+}
+
+bool decompressKtx(KtxTexture &texture)
+{
+    BlockFormat format;
+    if (!ktxBlockFormat(texture.internalFormat, format))
+        return false;
+    KtxTexture decoded;
+    decoded.internalFormat = GL_RGBA8;
+    decoded.format = GL_RGBA;
+    decoded.type = GL_UNSIGNED_BYTE;
+    for (size_t i = 0; i < texture.levels.size(); i++)
+    {
+        const KtxLevel &level = texture.levels[i];
+        unsigned char* rgba = decoded.addLevel(level.width, level.height, (size_t)level.width * level.height * 4);
+        decompressImage(&texture.data[level.offset], level.width, level.height, format, rgba);
+    }
+    texture = decoded;
+    return true;
+}
+
+size_t rgba8ChainBytes(int width, int height)
+{
+    size_t bytes = 0;
+    for (;;)
+    {
+        bytes += (size_t)width * height * 4;
+        if (width == 1 && height == 1)
+            return bytes;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <glad/glad.h>
+#include "texcompress.h"
+#include <string>
+#include <vector>
+
+// EXT_texture_compression_s3tc formats, the bundled glad loader doesn't include the extension
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+struct KtxLevel
+{
+    int width;
+    int height;
+    size_t offset;      // into KtxTexture::data
+    size_t size;
+};
+
+// A 2D texture with its whole mip chain in one block of memory, as stored in a KTX 1.1 file
+struct KtxTexture
+{
+    GLenum internalFormat;      // a compressed format, or GL_RGBA8 once decoded on the CPU
+    GLenum format;              // 0 for compressed data
+    GLenum type;                // 0 for compressed data
+    std::vector<KtxLevel> levels;
+    std::vector<unsigned char> data;
+
+    KtxTexture();
+    bool compressed() const { return type == 0; }
+    int width() const { return levels.empty() ? 0 : levels[0].width; }
+    int height() const { return levels.empty() ? 0 : levels[0].height; }
+    // appends a level after the existing ones and returns its storage
+    unsigned char* addLevel(int width, int height, size_t size);
+};
+
+// only uncompressed RGBA8 and the two S3TC formats the encoder produces are accepted
+bool readKtx(const std::string &path, KtxTexture &texture);
+bool writeKtx(const std::string &path, const KtxTexture &texture);
+
+// the block format of an S3TC internal format, returns false for anything else
+bool ktxBlockFormat(GLenum internalFormat, BlockFormat &format);
+// whether the current context can sample the S3TC formats
+bool s3tcSupported();
+// decode a compressed texture to RGBA8 in place, for drivers without S3TC support
+bool decompressKtx(KtxTexture &texture);
+// bytes of a full RGBA8 mip chain for a w x h image, what the same texture costs uncompressed
+size_t rgba8ChainBytes(int width, int height);
+
+#endif
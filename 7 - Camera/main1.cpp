@@ -1,5 +1,9 @@
 #include "glad/glad.h"
 #include "shader.h"
+#include "texture_upload.h"
+#include "sampler_cache.h"
+#include "frameloop.h"
+#include "context.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <iostream>
@@ -11,71 +15,50 @@
 const unsigned int SCREEN_WIDTH = 800;
 const unsigned int SCREEN_HEIGHT = 600;
 
-//The window we'll be rendering to
-SDL_Window* gWindow = NULL;
+//OpenGL context and the window or offscreen framebuffer it renders to
+Context* gContext = NULL;
 
-//OpenGL context
-SDL_GLContext gContext;
-
-int main()
+int main(int argc, char* argv[])
 {
 	//Initialization flag
 	int success = 0;
 
-	//Initialize SDL
-	if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+	// "--headless N" renders N frames into an offscreen framebuffer and exits, for machines without a display
+	unsigned long frameLimit = 0;
+	bool headless = parseHeadless(argc, argv, frameLimit);
+	if (headless && frameLimit == 0)
+		frameLimit = 1000;
+
+	//Initialize SDL, the offscreen context only needs its timer and event queue
+	if( SDL_Init( headless ? 0 : SDL_INIT_VIDEO ) < 0 )
 	{
 		std::cout <<  "SDL could not initialize! SDL Error: " << SDL_GetError() << std::endl;
 		success = 1;
 	}
 	else
 	{
-		//Use OpenGL 3.1 core
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
-		
-		//Create window
-		gWindow = SDL_CreateWindow( "OpenGL with SDL", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN );
-		if( gWindow == NULL )
-		{
-			std::cout <<  "Window could not be created! SDL Error: " << SDL_GetError() << std::endl;
+		//Create the window or offscreen context
+		gContext = createContext(headless);
+		if( !gContext->create( "OpenGL with SDL", SCREEN_WIDTH, SCREEN_HEIGHT ) )
 			success = 1;
-		}
 		else
 		{
-			//Create context
-			gContext = SDL_GL_CreateContext( gWindow );
-			if( gContext == NULL )
+			int imgFlags = IMG_INIT_JPG;
+			if( !( IMG_Init( imgFlags ) & imgFlags ) )
 			{
-				std::cout <<  "OpenGL context could not be created! SDL Error: " << SDL_GetError() << std::endl;
+				std::cout << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
 				success = 1;
 			}
-			else
-			{
-				// GLAD: load all OpenGL function pointers
-				if (!gladLoadGLLoader(SDL_GL_GetProcAddress))
-				{
-					std::cout << "Failed to initialize GLAD" << std::endl;
-					success = 1;
-				}    
-
-				//Use Vsync
-				if( SDL_GL_SetSwapInterval(1) < 0 )
-				{
-					std::cout <<  "Warning: Unable to set VSync! SDL Error: " << SDL_GetError() << std::endl;
-				}
-				int imgFlags = IMG_INIT_JPG;
-				if( !( IMG_Init( imgFlags ) & imgFlags ) )
-				{
-					std::cout << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
-					success = 1;
-				}
-			}
 		}
 	}
+	if( success )
+	{
+		delete gContext;
+		SDL_Quit();
+		return success;
+	}
 
-	glEnable(GL_DEPTH_TEST); 
+	gGLState.enable(GL_DEPTH_TEST); 
 
 	//Set up Camera
 	glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
@@ -106,46 +89,29 @@ int main()
 	glm::mat4 projectionMatrix;
 	projectionMatrix = glm::perspective(glm::radians(45.0f), float(SCREEN_WIDTH) / float(SCREEN_HEIGHT), 0.1f, 100.0f);
 
+	// Wrapping/filtering lives in one shared sampler object rather than on each texture
+	SamplerCache samplers;
+	samplers.init();
+	const SamplerDesc linearSampler(GL_REPEAT, GL_LINEAR, GL_LINEAR, false);
+
 	//Load texture
 	unsigned int texture1, texture2;
 	glGenTextures(1, &texture1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
 
 	SDL_Surface* image1 = IMG_Load("texture.jpg");
-	int mode = GL_RGB;
-	if(image1->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image1->pixels)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image1->w, image1->h, 0, mode, GL_UNSIGNED_BYTE, image1->pixels);
+	// sized format and channel order come from the surface itself, see texture_upload.h
+	if(image1 && uploadSurface(GL_TEXTURE_2D, image1))
 		glGenerateMipmap(GL_TEXTURE_2D);
-	}
 	else
 		std::cout << "Failed to load texture 1" << std::endl;
 
     glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gGLState.bindTexture(0, GL_TEXTURE_2D, texture2);
 
 	SDL_Surface* image2 = IMG_Load("awesomeface.png");
-	if(image2->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image2->pixels)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image2->w, image2->h, 0, mode, GL_UNSIGNED_BYTE, image2->pixels);
+	if(image2 && uploadSurface(GL_TEXTURE_2D, image2))
 		glGenerateMipmap(GL_TEXTURE_2D);
-	}
 	else
 		std::cout << "Failed to load texture 2" << std::endl;
 
@@ -217,9 +183,9 @@ int main()
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
+    gGLState.bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     // position attribute
@@ -230,58 +196,60 @@ int main()
     glEnableVertexAttribArray(1);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, 0); 
 
     // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0);
+    gGLState.bindVertexArray(0);
 
 	ourShader.use();
 	ourShader.setInt("texture1", 0);
 	ourShader.setInt("texture2", 1);
 
-	bool quit = false;
 	float angle;
-	SDL_Event e;
-	while (!quit)
+	FrameLoop loop(*gContext);
+	loop.onEvent = [&](const SDL_Event& e)
+	{
+		if( e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) )
+			loop.quit();
+	};
+	loop.onRender = [&](float alpha)
 	{
-		while( SDL_PollEvent( &e ) != 0 )
+		gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
+		gGLState.bindTexture(1, GL_TEXTURE_2D, texture2);
+		samplers.bind(0, linearSampler);
+		samplers.bind(1, linearSampler);
+		ourShader.use();
+		ourShader.setMat4("model", modelMatrix);
+		ourShader.setMat4("view", viewMatrix);
+		ourShader.setMat4("projection", projectionMatrix);
+		ourShader.setMat4("transform", transformMatrix);
+		gGLState.bindVertexArray(VAO);
+		for(unsigned int i = 0; i < 10; i++)
 		{
-			if( e.key.keysym.sym == SDLK_ESCAPE )
-				quit = true;
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture1);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texture2);
-			ourShader.use();
+			modelMatrix = glm::mat4(1.0f);
+			modelMatrix = glm::translate(modelMatrix, cubePositions[i]);
+			angle = 20.0f * i;
+			modelMatrix = glm::rotate(modelMatrix, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
 			ourShader.setMat4("model", modelMatrix);
-			ourShader.setMat4("view", viewMatrix);
-			ourShader.setMat4("projection", projectionMatrix);
-			ourShader.setMat4("transform", transformMatrix);
-			glBindVertexArray(VAO);
-			for(unsigned int i = 0; i < 10; i++)
-			{
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, cubePositions[i]);
-				angle = 20.0f * i;
-				modelMatrix = glm::rotate(modelMatrix, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-				ourShader.setMat4("model", modelMatrix);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}	
-			SDL_GL_SwapWindow( gWindow );
-
-		}
-	}
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+		}	
+		gGLState.endFrame();
+	};
+	loop.run(frameLimit);
+	loop.stats().print(std::cout);
+	gGLState.printStats(std::cout);
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    gGLState.deleteVertexArrays(1, &VAO);
+    gGLState.deleteBuffers(1, &VBO);
+    samplers.release();
 
-	SDL_DestroyWindow( gWindow );
-	gWindow = NULL;
+	delete gContext;
+	gContext = NULL;
 	IMG_Quit();
 	SDL_Quit();
 	return success;
@@ -1,89 +1,187 @@
 #include "glad/glad.h"
 #include "shader.h"
+#include "camera.h"
+#include "frameloop.h"
+#include "instancing.h"
+#include "context.h"
+#include "frame_uniforms.h"
+#include "texture_loader.h"
+#include "texture_streamer.h"
+#include "sampler_cache.h"
+#include "atlas.h"
+#include "bvh.h"
+#include "transforms.h"
+#include "matrix_batch.h"
+#include "frame_pipeline.h"
+#include "render_queue.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 const unsigned int SCREEN_WIDTH = 800;
 const unsigned int SCREEN_HEIGHT = 600;
+// entries of the texture table instanced.frag holds, its MAX_ENTRIES
+const size_t MAX_TABLE_ENTRIES = 16;
 
-//The window we'll be rendering to
-SDL_Window* gWindow = NULL;
+//OpenGL context and the window or offscreen framebuffer it renders to
+Context* gContext = NULL;
 
-//OpenGL context
-SDL_GLContext gContext;
+// The texconvert output next to an image ("make ktx") is loaded in its place when it exists
+std::string preferKtx(const std::string &path)
+{
+	std::string ktx = path.substr(0, path.rfind('.')) + ".ktx";
+	std::ifstream file(ktx.c_str());
+	return file.good() ? ktx : path;
+}
+
+// Diameter in pixels of a sphere on screen, how many pixels a unit of the scene's textures covers
+float projectedSize(const glm::vec3 &center, float radius, const glm::vec3 &cameraPos, float fovY, float viewportHeight)
+{
+	float distance = glm::length(center - cameraPos);
+	if (distance <= radius)
+		return viewportHeight;
+	return radius / (distance * tanf(glm::radians(fovY) * 0.5f)) * viewportHeight;
+}
 
-int main()
+// Input gathered on the GL thread between two builds of the frame pipeline, the build applies it to
+// the camera and the cubes on a worker
+struct FrameInput
+{
+	float mouseX, mouseY, scroll;
+	bool resetCamera;
+	std::vector<glm::vec2> clicks;		// left clicks in normalized device coordinates
+	std::vector<unsigned int> steps;	// the movement keys held in each simulation step, a bit per Camera_Movement
+	float step;
+	float time;
+
+	FrameInput() : mouseX(0.0f), mouseY(0.0f), scroll(0.0f), resetCamera(false), step(0.0f), time(0.0f) {}
+};
+
+// Sweeps the cube count and compares the CPU time it takes to submit one frame with the
+// per-cube glDrawArrays loop against building the instance buffer and a single instanced draw.
+// Both paths compose their model matrices in one batch from positions and rotations kept as
+// arrays, and the loop sets them through a location looked up once, so the difference is only
+// the draw submission
+void runInstancingBenchmark(Shader &loopShader, Shader &instancedShader, InstanceBuffer &instances, unsigned int VAO)
+{
+	const int FRAMES = 5;
+	const glm::vec3 cubeAxis = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+	std::vector<glm::mat4> models;
+	GLint modelLocation = loopShader.uniform("model");
+	std::cout << "instances\tloop ms\tinstanced ms\tspeedup" << std::endl;
+	for (size_t n = 10; n <= 1000000; n *= 10)
+	{
+		// cubes on a 100-wide grid so every count gets the same layout
+		std::vector<glm::vec3> positions(n), scales(n, glm::vec3(1.0f));
+		std::vector<glm::quat> rotations(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			positions[i] = glm::vec3(float(i % 100) * 2.0f - 100.0f, float((i / 100) % 100) * 2.0f - 100.0f, -10.0f - float(i / 10000) * 2.0f);
+			rotations[i] = glm::angleAxis(glm::radians(20.0f * i), cubeAxis);
+		}
+		models.resize(n);
+
+		double loopMs = 0.0, instancedMs = 0.0;
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			Uint64 start = SDL_GetPerformanceCounter();
+			loopShader.use();
+			composeMatrices(&positions[0], &rotations[0], &scales[0], &models[0], n);
+			gGLState.bindVertexArray(VAO);
+			for (size_t i = 0; i < n; i++)
+			{
+				loopShader.setMat4(modelLocation, models[i]);
+				glDrawArrays(GL_TRIANGLES, 0, 36);
+			}
+			loopMs += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+			// drain the GPU outside the timed region so both paths start from an idle pipeline
+			glFinish();
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			start = SDL_GetPerformanceCounter();
+			instancedShader.use();
+			composeMatrices(&positions[0], &rotations[0], &scales[0], &models[0], n);
+			instances.update(&models[0], n);
+			instances.draw(GL_TRIANGLES, 0, 36);
+			instancedMs += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+			glFinish();
+		}
+		loopMs /= FRAMES;
+		instancedMs /= FRAMES;
+		std::cout << n << "\t" << loopMs << "\t" << instancedMs << "\t" << loopMs / instancedMs << "x" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
 {
 	//Initialization flag
 	int success = 0;
-
-	//Initialize SDL
-	if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+	Uint64 startup = SDL_GetPerformanceCounter();
+
+	// "--headless N" renders N frames into an offscreen framebuffer and exits, for machines without a display
+	unsigned long frameLimit = 0;
+	bool headless = parseHeadless(argc, argv, frameLimit);
+	if (headless && frameLimit == 0)
+		frameLimit = 1000;
+	// "--workers N" builds frames on N worker threads, 0 builds them on the GL thread between submissions
+	unsigned int pipelineWorkers = 1;
+	for (int i = 1; i + 1 < argc; i++)
+		if (strcmp(argv[i], "--workers") == 0)
+			pipelineWorkers = (unsigned int)atoi(argv[i + 1]);
+	// "--texture-budget KB" caps the GPU memory the streamed scene textures may take
+	size_t textureBudget = 64 * 1024 * 1024;
+	for (int i = 1; i + 1 < argc; i++)
+		if (strcmp(argv[i], "--texture-budget") == 0)
+			textureBudget = (size_t)atol(argv[i + 1]) * 1024;
+
+	//Initialize SDL, the offscreen context only needs its timer and event queue
+	if( SDL_Init( headless ? 0 : SDL_INIT_VIDEO ) < 0 )
 	{
 		std::cout <<  "SDL could not initialize! SDL Error: " << SDL_GetError() << std::endl;
 		success = 1;
 	}
 	else
 	{
-		//Use OpenGL 3.1 core
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
-		
-		//Create window
-		gWindow = SDL_CreateWindow( "OpenGL with SDL", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN );
-		if( gWindow == NULL )
-		{
-			std::cout <<  "Window could not be created! SDL Error: " << SDL_GetError() << std::endl;
+		//Create the window or offscreen context
+		gContext = createContext(headless);
+		if( !gContext->create( "OpenGL with SDL", SCREEN_WIDTH, SCREEN_HEIGHT ) )
 			success = 1;
-		}
 		else
 		{
-			//Create context
-			gContext = SDL_GL_CreateContext( gWindow );
-			if( gContext == NULL )
+			int imgFlags = IMG_INIT_JPG;
+			if( !( IMG_Init( imgFlags ) & imgFlags ) )
 			{
-				std::cout <<  "OpenGL context could not be created! SDL Error: " << SDL_GetError() << std::endl;
+				std::cout << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
 				success = 1;
 			}
-			else
-			{
-				// GLAD: load all OpenGL function pointers
-				if (!gladLoadGLLoader(SDL_GL_GetProcAddress))
-				{
-					std::cout << "Failed to initialize GLAD" << std::endl;
-					success = 1;
-				}    
-
-				//Use Vsync
-				if( SDL_GL_SetSwapInterval(1) < 0 )
-				{
-					std::cout <<  "Warning: Unable to set VSync! SDL Error: " << SDL_GetError() << std::endl;
-				}
-				int imgFlags = IMG_INIT_JPG;
-				if( !( IMG_Init( imgFlags ) & imgFlags ) )
-				{
-					std::cout << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
-					success = 1;
-				}
-			}
 		}
 	}
+	if( success )
+	{
+		delete gContext;
+		SDL_Quit();
+		return success;
+	}
 
-	glEnable(GL_DEPTH_TEST); 
+	gGLState.enable(GL_DEPTH_TEST);
 
-	//Set up Camera
-	glm::vec3 cameraPos   = glm::vec3(0.0f, 0.0f,  3.0f);
-	glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
-	glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f,  0.0f);
+	//Set up Camera, it caches its matrices and only rebuilds them after it moved or zoomed
+	Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+	camera.MouseSensitivity = 0.05f;
+	camera.SetAspect(float(SCREEN_WIDTH) / float(SCREEN_HEIGHT));
 
 	// View Matrix
-	glm::mat4 viewMatrix = glm::lookAt(cameraPos, cameraPos+cameraFront, cameraUp);
+	glm::mat4 viewMatrix = camera.GetViewMatrix();
 
     // Transformation Matrix
     glm::mat4 transformMatrix;  	
@@ -92,56 +190,43 @@ int main()
 	modelMatrix = glm::rotate(modelMatrix, glm::radians(-60.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
 	// Projection Matrix
-	glm::mat4 projectionMatrix;
-	projectionMatrix = glm::perspective(glm::radians(45.0f), float(SCREEN_WIDTH) / float(SCREEN_HEIGHT), 0.1f, 100.0f);
-
-	//Load texture
-	unsigned int texture1, texture2;
-	glGenTextures(1, &texture1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	SDL_Surface* image1 = IMG_Load("texture.jpg");
-	int mode = GL_RGB;
-	if(image1->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image1->pixels)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image1->w, image1->h, 0, mode, GL_UNSIGNED_BYTE, image1->pixels);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
+	glm::mat4 projectionMatrix = camera.GetProjectionMatrix();
+
+	//Load textures: images are decoded on worker threads, the streamer puts their small mips on the GPU
+	//first and adds finer ones as the cubes get close enough to need them
+	ThreadPool workers;
+	TextureStreamer streamer(workers, textureBudget);
+	streamer.init();
+
+	// All cube textures sit in one texture array, or in the compressed atlas from "make atlas" when it
+	// exists, and the table says where each one is so every cube can pick its own without a rebind
+	std::vector<AtlasEntry> sceneTable;
+	unsigned int sceneTextures;
+	if (readAtlasTable("cubes.atlas", sceneTable))
+		sceneTextures = streamer.loadArray(std::vector<std::string>(1, "cubes.ktx"));
 	else
-		std::cout << "Failed to load texture 1" << std::endl;
-
-    glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	SDL_Surface* image2 = IMG_Load("awesomeface.png");
-	if(image2->format->BytesPerPixel == 4)
-    	mode = GL_RGBA;
-
-	if(image2->pixels)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, mode, image2->w, image2->h, 0, mode, GL_UNSIGNED_BYTE, image2->pixels);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		std::vector<std::string> layers;
+		layers.push_back("texture.jpg");
+		layers.push_back("awesomeface.png");
+		sceneTable = arrayEntries(layers);
+		sceneTextures = streamer.loadArray(layers);
 	}
-	else
-		std::cout << "Failed to load texture 2" << std::endl;
-
-	SDL_FreeSurface(image1);
-	SDL_FreeSurface(image2);
+	// the smallest entry covers the fewest texels of the whole texture, it decides the level needed
+	float entrySpan = 1.0f;
+	for (size_t i = 0; i < sceneTable.size(); i++)
+		entrySpan = std::min(entrySpan, std::min(sceneTable[i].u1 - sceneTable[i].u0, sceneTable[i].v1 - sceneTable[i].v0));
+
+	// Wrapping/filtering lives in shared sampler objects rather than on each texture,
+	// both textures repeat with anisotropic trilinear filtering ('F' toggles the anisotropy).
+	// The scene textures clamp, instanced.frag repeats inside each entry's rectangle itself
+	SamplerCache samplers;
+	samplers.init();
+	const SamplerDesc repeatSampler(GL_REPEAT);
+	const SamplerDesc sceneSampler(GL_CLAMP_TO_EDGE);
 
     Shader ourShader("shader.vert", "shader.frag");
+    Shader instancedShader("instanced.vert", "instanced.frag");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -206,9 +291,9 @@ int main()
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
+    gGLState.bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     // position attribute
@@ -219,128 +304,319 @@ int main()
     glEnableVertexAttribArray(1);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, 0);
 
     // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0);
+    gGLState.bindVertexArray(0);
 
 	ourShader.use();
 	ourShader.setInt("texture1", 0);
 	ourShader.setInt("texture2", 1);
+	ourShader.setMat4("transform", transformMatrix);
+	instancedShader.use();
+	instancedShader.setInt("textures", 0);
+	std::vector<glm::vec4> entryRects;
+	std::vector<float> entryLayers;
+	if (sceneTable.size() > MAX_TABLE_ENTRIES)
+		std::cout << "Warning: the texture table has " << sceneTable.size() << " entries, cubes only use the first " << MAX_TABLE_ENTRIES << std::endl;
+	for (size_t i = 0; i < sceneTable.size() && i < MAX_TABLE_ENTRIES; i++)
+	{
+		const AtlasEntry &entry = sceneTable[i];
+		entryRects.push_back(glm::vec4(entry.u0, entry.v0, entry.u1 - entry.u0, entry.v1 - entry.v0));
+		entryLayers.push_back((float)entry.layer);
+	}
+	instancedShader.setVec4Array("entryRect", &entryRects[0], (GLsizei)entryRects.size());
+	instancedShader.setFloatArray("entryLayer", &entryLayers[0], (GLsizei)entryLayers.size());
+	instancedShader.setInt("entryCount", (int)entryRects.size());
+
+	// the instanced program reads view and projection from the shared per-frame uniform buffer
+	FrameUniforms frameUniforms;
+	frameUniforms.init();
+	instancedShader.bindUniformBlock("PerFrame", PER_FRAME_BINDING);
+
+	// The cubes' world-space boxes go into a bounding volume hierarchy, which answers which cubes are
+	// in view and which one the mouse points at. Only the visible ones are uploaded, again whenever
+	// the camera or a cube moved, and drawn with a single call
+	InstanceBuffer instances(VAO);
+	// each cube is a node of the transform hierarchy, rotated by 20 degrees per index
+	TransformHierarchy transforms;
+	uint32_t cubeNodes[10];
+	const glm::vec3 cubeAxis = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+	for(unsigned int i = 0; i < 10; i++)
+		cubeNodes[i] = transforms.add(TransformHierarchy::NO_PARENT, cubePositions[i], glm::angleAxis(glm::radians(20.0f * i), cubeAxis));
+	transforms.update();
+	glm::mat4 cubeModels[10];
+	BoundingVolumes cubeBounds(BoundingVolumes::BOXES);
+	for(unsigned int i = 0; i < 10; i++)
+	{
+		cubeModels[i] = transforms.world(cubeNodes[i]);
+		glm::vec3 min, max;
+		transformBox(cubeModels[i], glm::vec3(-0.5f), glm::vec3(0.5f), min, max);
+		cubeBounds.addBox(min, max);
+	}
+	Bvh sceneBvh;
+	sceneBvh.build(cubeBounds);
+	instances.update(cubeModels, 10);
+	std::vector<uint32_t> visibleCubes;
+	RenderQueue renderQueue;
+	unsigned long culledVersion = 0;
+	bool cubesMoved = true;
+	// a left click sets the cube under the cursor spinning or stops it
+	bool spinning[10] = {};
+	float spin[10] = {};
+
+	bool benchmark = false;
+	for (int i = 1; i < argc; i++)
+		if (strcmp(argv[i], "--bench") == 0)
+			benchmark = true;
+	if (benchmark)
+	{
+		viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 100.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		// the per-cube loop keeps the two separate textures of shader.frag as its baseline
+		TextureLoader textures(workers);
+		textures.cpuMipmaps = true;
+		textures.init();
+		unsigned int texture1 = textures.load(preferKtx("texture.jpg"));
+		unsigned int texture2 = textures.load(preferKtx("awesomeface.png"));
+		while (textures.busy())
+			textures.update();
+		do
+		{
+			streamer.request(sceneTextures, float(SCREEN_HEIGHT));
+			streamer.update();
+		} while (streamer.busy());
+		gGLState.bindTexture(0, GL_TEXTURE_2D, texture1);
+		gGLState.bindTexture(1, GL_TEXTURE_2D, texture2);
+		gGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, sceneTextures);
+		samplers.bind(0, repeatSampler);
+		samplers.bind(1, repeatSampler);
+		ourShader.use();
+		ourShader.setMat4("view", viewMatrix);
+		ourShader.setMat4("projection", projectionMatrix);
+		frameUniforms.update(viewMatrix, projectionMatrix, glm::vec3(0.0f, 0.0f, 100.0f), 0.0f);
+		runInstancingBenchmark(ourShader, instancedShader, instances, VAO);
+		instances.release();
+		frameUniforms.release();
+		textures.release();
+		streamer.release();
+		samplers.release();
+		gGLState.deleteTextures(1, &texture1);
+		gGLState.deleteTextures(1, &texture2);
+		gGLState.deleteVertexArrays(1, &VAO);
+		gGLState.deleteBuffers(1, &VBO);
+		delete gContext;
+		IMG_Quit();
+		SDL_Quit();
+		return success;
+	}
 
-	bool quit = false;
-	float angle;
 	float lastX = SCREEN_WIDTH/2.0f;
 	float lastY = SCREEN_WIDTH/2.0f;
-	float fov = 45.0f;
-	float pitch = 0.0f, yaw = -90.0f; // yaw is initialized to -90.0 degrees since a yaw of 0.0 results in a direction vector pointing to the right so we initially rotate a bit to the left
 	bool firstMouse = true;
-	SDL_Event e;
-	while (!quit)
+	// CPU and GPU timings of the frame, shown in the window title and written to a Chrome trace on exit
+	Profiler profiler;
+	profiler.init();
+
+	FrameLoop loop(*gContext);
+	loop.profiler = &profiler;
+	// Frames are built a frame ahead of the one being submitted. The GL thread only records input into
+	// pending, which becomes the next build's input once the build before it is done
+	FramePipeline pipeline(pipelineWorkers);
+	FrameInput pending, building;
+	loop.onEvent = [&](const SDL_Event& e)
 	{
-		float deltaTime = 0.0f;	// Time between current frame and last frame
-		float lastFrame = 0.0f; // Time of last frame
-		while( SDL_PollEvent( &e ) != 0 )
+		// A bunch of SDL events for mouse and keyboard input
+		if( e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) )
+			loop.quit();
+		if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_f)
+			samplers.setAnisotropy(samplers.anisotropy() > 1.0f ? 1.0f : samplers.maxAnisotropy());
+		// the camera and the cubes belong to the frame being built, they only see the input once it is
+		if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_RIGHT)
 		{
-			// Camera speed
-			float currentFrame = SDL_GetTicks()/1000.0f;
-			deltaTime = currentFrame - lastFrame;
-			lastFrame = currentFrame;  
-			float cameraSpeed = 0.05f * deltaTime;
-
-			// A bunch of SDL events for mouse and keyboard input
-			if( e.key.keysym.sym == SDLK_ESCAPE || e.type == SDL_QUIT)
-				quit = true;
-			if( e.key.keysym.sym == SDLK_w )
-				cameraPos += cameraSpeed * cameraFront;
-			if( e.key.keysym.sym == SDLK_s )
-				cameraPos -= cameraSpeed * cameraFront;
-			if( e.key.keysym.sym == SDLK_a )
-				cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-			if( e.key.keysym.sym == SDLK_d )
-				cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-			if (e.button.button == SDL_BUTTON_RIGHT)
-			{
-				cameraPos   = glm::vec3(0.0f, 0.0f,  3.0f);
-				cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
-				cameraUp    = glm::vec3(0.0f, 1.0f,  0.0f);
-			}
-			if (e.type == SDL_MOUSEMOTION)
+			pending.resetCamera = true;
+			pending.mouseX = pending.mouseY = 0.0f;
+		}
+		if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT)
+			pending.clicks.push_back(glm::vec2(e.button.x * 2.0f / SCREEN_WIDTH - 1.0f, 1.0f - e.button.y * 2.0f / SCREEN_HEIGHT));
+		if (e.type == SDL_MOUSEMOTION)
+		{
+			float xPos = e.motion.x;
+			float yPos = e.motion.y;
+			if(firstMouse)
 			{
-				float xPos = e.motion.x;
-				float yPos = e.motion.y;
-				if(firstMouse)
-    			{
-        			lastX = xPos;
-        			lastY = yPos;
-        			firstMouse = false;
-    			}
-				float delX = (xPos - lastX);
-				float delY = (lastY - yPos);
 				lastX = xPos;
 				lastY = yPos;
-				float sensitivity = 0.05f;
-				delX *= sensitivity;
-				delY *= sensitivity;
-				yaw += delX;
-				pitch += delY;
-				if(pitch > 89.0f)
-  					pitch =  89.0f;
-				if(pitch < -89.0f)
-  					pitch = -89.0f;
-				glm::vec3 front;
-				front.x = cos(glm::radians(pitch)) * cos(glm::radians(yaw));
-				front.y = sin(glm::radians(pitch));
-				front.z = cos(glm::radians(pitch)) * sin(glm::radians(yaw));
-				cameraFront = glm::normalize(front);
+				firstMouse = false;
 			}
-			if (e.type == SDL_MOUSEWHEEL)
+			float delX = (xPos - lastX);
+			float delY = (lastY - yPos);
+			lastX = xPos;
+			lastY = yPos;
+			pending.mouseX += delX;
+			pending.mouseY += delY;
+		}
+		if (e.type == SDL_MOUSEWHEEL)
+			pending.scroll += e.wheel.y;
+	};
+	loop.onUpdate = [&](float deltaTime)
+	{
+		// Keys are sampled once per simulation step, the step itself runs in the next build
+		const Uint8* keys = SDL_GetKeyboardState(NULL);
+		unsigned int held = 0;
+		if( keys[SDL_SCANCODE_W] )
+			held |= 1 << FORWARD;
+		if( keys[SDL_SCANCODE_S] )
+			held |= 1 << BACKWARD;
+		if( keys[SDL_SCANCODE_A] )
+			held |= 1 << LEFT;
+		if( keys[SDL_SCANCODE_D] )
+			held |= 1 << RIGHT;
+		pending.steps.push_back(held);
+		pending.step = deltaTime;
+	};
+	// Simulation, culling and the draw list of the next frame, on a worker while the GL thread submits
+	// the current one. Nothing here touches GL or anything the GL thread uses
+	pipeline.onBuild = [&](RenderPacket &packet)
+	{
+		// clicks pick among the cubes as they were on screen, before this frame's movement
+		for (size_t c = 0; c < building.clicks.size(); c++)
+		{
+			// the ray through the clicked pixel from the near plane to the far one, unprojected from clip space
+			glm::vec4 nearPoint = camera.GetInverseViewProjection() * glm::vec4(building.clicks[c], -1.0f, 1.0f);
+			glm::vec4 farPoint = camera.GetInverseViewProjection() * glm::vec4(building.clicks[c], 1.0f, 1.0f);
+			glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+			RayHit hit;
+			if (sceneBvh.raycast(origin, glm::vec3(farPoint) / farPoint.w - origin, hit, 1.0f))
+				spinning[hit.object] = !spinning[hit.object];
+		}
+		if (building.resetCamera)
+			camera.Place(glm::vec3(0.0f, 0.0f, 3.0f), YAW, PITCH);
+		camera.ProcessMouseMovement(building.mouseX, building.mouseY);
+		if (building.scroll != 0.0f)
+			camera.ProcessMouseScroll(building.scroll);
+		for (size_t s = 0; s < building.steps.size(); s++)
+		{
+			float deltaTime = building.step;
+			for (int direction = FORWARD; direction <= RIGHT; direction++)
+				if (building.steps[s] & (1 << direction))
+					camera.ProcessKeyboard((Camera_Movement)direction, deltaTime);
+			// spinning cubes turn 90 degrees a second, the tree is refitted around their new boxes
+			for (unsigned int i = 0; i < 10; i++)
+				if (spinning[i])
+				{
+					spin[i] += 90.0f * deltaTime;
+					transforms.setRotation(cubeNodes[i], glm::angleAxis(glm::radians(20.0f * i + spin[i]), cubeAxis));
+				}
+			if (transforms.update() > 0)
 			{
-				float yPos = e.wheel.y;
-				if (fov >= 1.0f && fov <= 45.0f)
-					fov -= yPos;
-				if(fov <= 1.0f)
-					fov = 1.0f;
-				if(fov >= 45.0f)
-					fov = 45.0f;
+				for (unsigned int i = 0; i < 10; i++)
+					if (spinning[i])
+					{
+						cubeModels[i] = transforms.world(cubeNodes[i]);
+						glm::vec3 min, max;
+						transformBox(cubeModels[i], glm::vec3(-0.5f), glm::vec3(0.5f), min, max);
+						sceneBvh.update(i, min, max);
+					}
+				cubesMoved = true;
 			}
-
-			viewMatrix = glm::lookAt(cameraPos, cameraPos+cameraFront, cameraUp);
-			projectionMatrix = glm::perspective(glm::radians(fov), float(SCREEN_WIDTH) / float(SCREEN_HEIGHT), 0.1f, 100.0f);
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture1);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texture2);
-			ourShader.use();
-			ourShader.setMat4("model", modelMatrix);
-			ourShader.setMat4("view", viewMatrix);
-			ourShader.setMat4("projection", projectionMatrix);
-			ourShader.setMat4("transform", transformMatrix);
-			glBindVertexArray(VAO);
-			for(unsigned int i = 0; i < 10; i++)
-			{
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, cubePositions[i]);
-				angle = 20.0f * i;
-				modelMatrix = glm::rotate(modelMatrix, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-				ourShader.setMat4("model", modelMatrix);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}	
-			SDL_GL_SwapWindow( gWindow );
-
 		}
-	}
+		// mouse and keyboard input since the last frame is applied in one step
+		camera.Update();
+		packet.view = camera.GetViewMatrix();
+		packet.projection = camera.GetProjectionMatrix();
+		packet.cameraPosition = camera.GetPosition();
+		packet.time = building.time;
+		packet.changed = camera.Version() != culledVersion || cubesMoved;
+		if (packet.changed)
+		{
+			culledVersion = camera.Version();
+			cubesMoved = false;
+			sceneBvh.cull(camera.GetFrustumPlanes(), visibleCubes);
+			// every cube shares program, textures and vertex array, so the queue only orders them by
+			// distance: nearest first, the depth test then rejects what they hide before shading it
+			renderQueue.clear();
+			for (size_t i = 0; i < visibleCubes.size(); i++)
+				renderQueue.add(RenderQueue::makeKey(0, false, 0, 0, 0, glm::length(cubePositions[visibleCubes[i]] - camera.GetPosition())), visibleCubes[i]);
+			renderQueue.sort();
+			for (size_t i = 0; i < visibleCubes.size(); i++)
+				visibleCubes[i] = renderQueue.payload(i);
+		}
+		// the ids keep each cube's textures the same whichever others are culled
+		packet.ids = visibleCubes;
+		packet.models.resize(visibleCubes.size());
+		packet.screenSizes.resize(visibleCubes.size());
+		for (size_t i = 0; i < visibleCubes.size(); i++)
+		{
+			packet.models[i] = cubeModels[visibleCubes[i]];
+			packet.screenSizes[i] = projectedSize(cubePositions[visibleCubes[i]], 0.5f, camera.GetPosition(), camera.GetZoom(), float(SCREEN_HEIGHT));
+		}
+	};
+	// the first frame is built before the loop starts, every later one while the one before it is submitted
+	pipeline.build();
+	loop.onRender = [&](float alpha)
+	{
+		RenderPacket &packet = pipeline.acquire();
+		// the build before is done, so the input it read can be handed over for the next one
+		building = pending;
+		building.time = (float)loop.stats().totalSeconds;
+		pending = FrameInput();
+		pipeline.build();
+
+		frameUniforms.update(packet.view, packet.projection, packet.cameraPosition, packet.time);
+		if (loop.stats().frames == 0)
+			std::cout << "Startup to first frame: " << (SDL_GetPerformanceCounter() - startup) * 1000.0 / SDL_GetPerformanceFrequency() << " ms" << std::endl;
+		profiler.begin("instances");
+		if (packet.changed)
+			instances.update(packet.models.empty() ? NULL : &packet.models[0], packet.models.size(), packet.ids.empty() ? NULL : &packet.ids[0]);
+		profiler.end();
+		// every visible cube asks for the level its size on screen needs
+		profiler.begin("uploads");
+		for (size_t i = 0; i < packet.screenSizes.size(); i++)
+			streamer.request(sceneTextures, packet.screenSizes[i] / entrySpan);
+		streamer.update();
+		profiler.end();
+		profiler.begin("clear");
+		gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		profiler.end();
+		profiler.begin("cubes");
+		gGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, sceneTextures);
+		samplers.bind(0, sceneSampler);
+		instancedShader.use();
+		instances.draw(GL_TRIANGLES, 0, 36);
+		profiler.end();
+		gGLState.endFrame();
+		pipeline.release();
+
+		// on-screen summary of where the frame time goes, refreshed twice a second
+		if (gContext->window() && loop.stats().frames % 30 == 0)
+			SDL_SetWindowTitle(gContext->window(), profiler.summary().c_str());
+	};
+	loop.run(frameLimit);
+	pipeline.finish();
+	loop.stats().print(std::cout);
+	pipeline.stats().print(std::cout, pipeline.workers());
+	gGLState.printStats(std::cout);
+	streamer.stats().print(std::cout);
+	samplers.printStats(std::cout);
+	profiler.flush();
+	std::cout << profiler.summary() << std::endl;
+	if (profiler.exportChromeTrace("trace.json"))
+		std::cout << "Frame trace written to trace.json" << std::endl;
+	profiler.release();
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-
-	SDL_DestroyWindow( gWindow );
-	gWindow = NULL;
+    instances.release();
+    frameUniforms.release();
+    streamer.release();
+    samplers.release();
+    gGLState.deleteVertexArrays(1, &VAO);
+    gGLState.deleteBuffers(1, &VBO);
+
+	delete gContext;
+	gContext = NULL;
 	IMG_Quit();
 	SDL_Quit();
 	return success;
@@ -0,0 +1,648 @@
+#include "matrix_batch.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MATRIX_X86 1
+#endif
+
+// A multiply followed by an add must stay two roundings, as in glm. The AVX-512 target lets GCC fuse
+// them into one FMA, which changes the last bit of the result
+#pragma GCC optimize("fp-contract=off")
+
+bool matrixPathSupported(MatrixPath path)
+{
+    switch (path)
+    {
+        case MATRIX_SCALAR:
+        case MATRIX_BEST:
+            return true;
+#ifdef MATRIX_X86
+        case MATRIX_SSE4:
+            return __builtin_cpu_supports("sse4.1");
+        case MATRIX_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case MATRIX_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+static MatrixPath resolvePath(MatrixPath path)
+{
+    if (path != MATRIX_BEST)
+        return matrixPathSupported(path) ? path : MATRIX_SCALAR;
+    if (matrixPathSupported(MATRIX_AVX512))
+        return MATRIX_AVX512;
+    if (matrixPathSupported(MATRIX_AVX2))
+        return MATRIX_AVX2;
+    return matrixPathSupported(MATRIX_SSE4) ? MATRIX_SSE4 : MATRIX_SCALAR;
+}
+
+// The scalar paths spell out what glm 0.9.8 computes, the SIMD paths follow them term for term and
+// finish the elements that do not fill a register with them
+
+static void composeScalar(const glm::vec3* p, const glm::quat* q, const glm::vec3* s, glm::mat4* out, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++)
+    {
+        // mat3_cast(), then every column times its scale as glm::scale() does
+        float xx = q[i].x * q[i].x, yy = q[i].y * q[i].y, zz = q[i].z * q[i].z;
+        float xz = q[i].x * q[i].z, xy = q[i].x * q[i].y, yz = q[i].y * q[i].z;
+        float wx = q[i].w * q[i].x, wy = q[i].w * q[i].y, wz = q[i].w * q[i].z;
+        out[i][0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * s[i].x;
+        out[i][1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * s[i].y;
+        out[i][2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * s[i].z;
+        out[i][3] = glm::vec4(p[i], 1.0f);
+    }
+}
+
+static void multiplyScalar(const glm::mat4* left, size_t leftStride, const glm::mat4* right, glm::mat4* out, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++)
+    {
+        glm::mat4 a = left[i * leftStride], b = right[i];
+        for (int c = 0; c < 4; c++)
+            out[i][c] = a[0] * b[c].x + a[1] * b[c].y + a[2] * b[c].z + a[3] * b[c].w;
+    }
+}
+
+static void transformScalar(const glm::mat4* m, size_t stride, const glm::vec4* in, glm::vec4* out, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++)
+    {
+        const glm::mat4 &a = m[i * stride];
+        glm::vec4 v = in[i];
+        out[i] = (a[0] * v.x + a[1] * v.y) + (a[2] * v.z + a[3] * v.w);
+    }
+}
+
+static void normalScalar(const glm::mat4* models, glm::mat3* out, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++)
+    {
+        // inverse(mat3) with rows and columns swapped on the way out
+        const glm::mat4 &m = models[i];
+        float o = 1.0f / (+ m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2])
+                          - m[1][0] * (m[0][1] * m[2][2] - m[2][1] * m[0][2])
+                          + m[2][0] * (m[0][1] * m[1][2] - m[1][1] * m[0][2]));
+        glm::mat3 &n = out[i];
+        n[0][0] = + (m[1][1] * m[2][2] - m[2][1] * m[1][2]) * o;
+        n[0][1] = - (m[1][0] * m[2][2] - m[2][0] * m[1][2]) * o;
+        n[0][2] = + (m[1][0] * m[2][1] - m[2][0] * m[1][1]) * o;
+        n[1][0] = - (m[0][1] * m[2][2] - m[2][1] * m[0][2]) * o;
+        n[1][1] = + (m[0][0] * m[2][2] - m[2][0] * m[0][2]) * o;
+        n[1][2] = - (m[0][0] * m[2][1] - m[2][0] * m[0][1]) * o;
+        n[2][0] = + (m[0][1] * m[1][2] - m[1][1] * m[0][2]) * o;
+        n[2][1] = - (m[0][0] * m[1][2] - m[1][0] * m[0][2]) * o;
+        n[2][2] = + (m[0][0] * m[1][1] - m[1][0] * m[0][1]) * o;
+    }
+}
+
+#ifdef MATRIX_X86
+
+// Composing and the normal matrix work across matrices: a register holds the same element of 4, 8 or 16
+// of them, gathered and scattered by 4x4 transposes within each 128-bit lane. glm::quat is stored
+// x, y, z, w. Multiplying works within a matrix: one column, two or all four per register
+
+#define TRANSPOSE4(SUFFIX, r0, r1, r2, r3) \
+    { \
+        t0 = _mm##SUFFIX##_unpacklo_ps(r0, r1); \
+        t1 = _mm##SUFFIX##_unpacklo_ps(r2, r3); \
+        t2 = _mm##SUFFIX##_unpackhi_ps(r0, r1); \
+        t3 = _mm##SUFFIX##_unpackhi_ps(r2, r3); \
+        r0 = _mm##SUFFIX##_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)); \
+        r1 = _mm##SUFFIX##_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)); \
+        r2 = _mm##SUFFIX##_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)); \
+        r3 = _mm##SUFFIX##_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)); \
+    }
+
+// the rotation of mat3_cast() from quaternion components and the columns scaled, one matrix per element
+#define COMPOSE_ROTATION(SUFFIX) \
+    { \
+        xx = _mm##SUFFIX##_mul_ps(x, x); yy = _mm##SUFFIX##_mul_ps(y, y); zz = _mm##SUFFIX##_mul_ps(z, z); \
+        xz = _mm##SUFFIX##_mul_ps(x, z); xy = _mm##SUFFIX##_mul_ps(x, y); yz = _mm##SUFFIX##_mul_ps(y, z); \
+        wx = _mm##SUFFIX##_mul_ps(w, x); wy = _mm##SUFFIX##_mul_ps(w, y); wz = _mm##SUFFIX##_mul_ps(w, z); \
+        c0[0] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_sub_ps(one, _mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_add_ps(yy, zz))), sx); \
+        c0[1] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_add_ps(xy, wz)), sx); \
+        c0[2] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_sub_ps(xz, wy)), sx); \
+        c0[3] = _mm##SUFFIX##_mul_ps(zero, sx); \
+        c1[0] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_sub_ps(xy, wz)), sy); \
+        c1[1] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_sub_ps(one, _mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_add_ps(xx, zz))), sy); \
+        c1[2] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_add_ps(yz, wx)), sy); \
+        c1[3] = _mm##SUFFIX##_mul_ps(zero, sy); \
+        c2[0] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_add_ps(xz, wy)), sz); \
+        c2[1] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_sub_ps(yz, wx)), sz); \
+        c2[2] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_sub_ps(one, _mm##SUFFIX##_mul_ps(two, _mm##SUFFIX##_add_ps(xx, yy))), sz); \
+        c2[3] = _mm##SUFFIX##_mul_ps(zero, sz); \
+    }
+
+// the transposed inverse from the upper 3x3 of each model, element j of m[c][r] belongs to matrix j
+#define NORMAL_MATRIX(SUFFIX, XOR) \
+    { \
+        d0 = _mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m1[1], m2[2]), _mm##SUFFIX##_mul_ps(m2[1], m1[2])); \
+        d1 = _mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m0[1], m2[2]), _mm##SUFFIX##_mul_ps(m2[1], m0[2])); \
+        d2 = _mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m0[1], m1[2]), _mm##SUFFIX##_mul_ps(m1[1], m0[2])); \
+        o = _mm##SUFFIX##_div_ps(one, _mm##SUFFIX##_add_ps(_mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m0[0], d0), \
+                _mm##SUFFIX##_mul_ps(m1[0], d1)), _mm##SUFFIX##_mul_ps(m2[0], d2))); \
+        n[0] = _mm##SUFFIX##_mul_ps(d0, o); \
+        n[1] = _mm##SUFFIX##_mul_ps(XOR(_mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m1[0], m2[2]), _mm##SUFFIX##_mul_ps(m2[0], m1[2])), sign), o); \
+        n[2] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m1[0], m2[1]), _mm##SUFFIX##_mul_ps(m2[0], m1[1])), o); \
+        n[3] = _mm##SUFFIX##_mul_ps(XOR(d1, sign), o); \
+        n[4] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m0[0], m2[2]), _mm##SUFFIX##_mul_ps(m2[0], m0[2])), o); \
+        n[5] = _mm##SUFFIX##_mul_ps(XOR(_mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m0[0], m2[1]), _mm##SUFFIX##_mul_ps(m2[0], m0[1])), sign), o); \
+        n[6] = _mm##SUFFIX##_mul_ps(d2, o); \
+        n[7] = _mm##SUFFIX##_mul_ps(XOR(_mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m0[0], m1[2]), _mm##SUFFIX##_mul_ps(m1[0], m0[2])), sign), o); \
+        n[8] = _mm##SUFFIX##_mul_ps(_mm##SUFFIX##_sub_ps(_mm##SUFFIX##_mul_ps(m0[0], m1[1]), _mm##SUFFIX##_mul_ps(m1[0], m0[1])), o); \
+    }
+
+// ---- SSE4.1: 4 matrices or one column at a time ----
+
+__attribute__((target("sse4.1")))
+static inline __m128 columnSSE4(__m128 a0, __m128 a1, __m128 a2, __m128 a3, __m128 b)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_shuffle_ps(b, b, 0x00)), _mm_mul_ps(a1, _mm_shuffle_ps(b, b, 0x55))),
+                                 _mm_mul_ps(a2, _mm_shuffle_ps(b, b, 0xAA))), _mm_mul_ps(a3, _mm_shuffle_ps(b, b, 0xFF)));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 vectorSSE4(__m128 a0, __m128 a1, __m128 a2, __m128 a3, __m128 v)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_shuffle_ps(v, v, 0x00)), _mm_mul_ps(a1, _mm_shuffle_ps(v, v, 0x55))),
+                      _mm_add_ps(_mm_mul_ps(a2, _mm_shuffle_ps(v, v, 0xAA)), _mm_mul_ps(a3, _mm_shuffle_ps(v, v, 0xFF))));
+}
+
+__attribute__((target("sse4.1")))
+static void composeSSE4(const glm::vec3* p, const glm::quat* q, const glm::vec3* s, glm::mat4* out, size_t n)
+{
+    const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+    __m128 t0, t1, t2, t3, xx, yy, zz, xz, xy, yz, wx, wy, wz, c0[4], c1[4], c2[4];
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&q[i].x), y = _mm_loadu_ps(&q[i + 1].x), z = _mm_loadu_ps(&q[i + 2].x), w = _mm_loadu_ps(&q[i + 3].x);
+        TRANSPOSE4(, x, y, z, w);
+        __m128 sx = _mm_set_ps(s[i + 3].x, s[i + 2].x, s[i + 1].x, s[i].x);
+        __m128 sy = _mm_set_ps(s[i + 3].y, s[i + 2].y, s[i + 1].y, s[i].y);
+        __m128 sz = _mm_set_ps(s[i + 3].z, s[i + 2].z, s[i + 1].z, s[i].z);
+        COMPOSE_ROTATION();
+        TRANSPOSE4(, c0[0], c0[1], c0[2], c0[3]);
+        TRANSPOSE4(, c1[0], c1[1], c1[2], c1[3]);
+        TRANSPOSE4(, c2[0], c2[1], c2[2], c2[3]);
+        for (int k = 0; k < 4; k++)
+        {
+            _mm_storeu_ps(&out[i + k][0][0], c0[k]);
+            _mm_storeu_ps(&out[i + k][1][0], c1[k]);
+            _mm_storeu_ps(&out[i + k][2][0], c2[k]);
+            out[i + k][3] = glm::vec4(p[i + k], 1.0f);
+        }
+    }
+    composeScalar(p, q, s, out, i, n);
+}
+
+__attribute__((target("sse4.1")))
+static void multiplySSE4(const glm::mat4* left, size_t leftStride, const glm::mat4* right, glm::mat4* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const float* a = &left[i * leftStride][0][0];
+        const float* b = &right[i][0][0];
+        __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+        __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12);
+        float* r = &out[i][0][0];
+        _mm_storeu_ps(r, columnSSE4(a0, a1, a2, a3, b0));
+        _mm_storeu_ps(r + 4, columnSSE4(a0, a1, a2, a3, b1));
+        _mm_storeu_ps(r + 8, columnSSE4(a0, a1, a2, a3, b2));
+        _mm_storeu_ps(r + 12, columnSSE4(a0, a1, a2, a3, b3));
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void transformSSE4(const glm::mat4* m, size_t stride, const glm::vec4* in, glm::vec4* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const float* a = &m[i * stride][0][0];
+        __m128 v = _mm_loadu_ps(&in[i].x);
+        _mm_storeu_ps(&out[i].x, vectorSSE4(_mm_loadu_ps(a), _mm_loadu_ps(a + 4), _mm_loadu_ps(a + 8), _mm_loadu_ps(a + 12), v));
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void normalSSE4(const glm::mat4* models, glm::mat3* out, size_t count)
+{
+    const __m128 one = _mm_set1_ps(1.0f), sign = _mm_set1_ps(-0.0f);
+    __m128 t0, t1, t2, t3, m0[4], m1[4], m2[4], d0, d1, d2, o, n[9];
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            m0[k] = _mm_loadu_ps(&models[i + k][0][0]);
+            m1[k] = _mm_loadu_ps(&models[i + k][1][0]);
+            m2[k] = _mm_loadu_ps(&models[i + k][2][0]);
+        }
+        TRANSPOSE4(, m0[0], m0[1], m0[2], m0[3]);
+        TRANSPOSE4(, m1[0], m1[1], m1[2], m1[3]);
+        TRANSPOSE4(, m2[0], m2[1], m2[2], m2[3]);
+        NORMAL_MATRIX(, _mm_xor_ps);
+        // the 9 floats of each mat3 as 4 + 4 + 1
+        TRANSPOSE4(, n[0], n[1], n[2], n[3]);
+        TRANSPOSE4(, n[4], n[5], n[6], n[7]);
+        float last[4];
+        _mm_storeu_ps(last, n[8]);
+        for (int k = 0; k < 4; k++)
+        {
+            float* r = &out[i + k][0][0];
+            _mm_storeu_ps(r, n[k]);
+            _mm_storeu_ps(r + 4, n[4 + k]);
+            r[8] = last[k];
+        }
+    }
+    normalScalar(models, out, i, count);
+}
+
+// ---- AVX2: 8 matrices or two columns at a time ----
+
+__attribute__((target("avx2")))
+static inline __m256 load2AVX2(const float* lo, const float* hi)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+}
+
+__attribute__((target("avx2")))
+static inline void store2AVX2(float* lo, float* hi, __m256 v)
+{
+    _mm_storeu_ps(lo, _mm256_castps256_ps128(v));
+    _mm_storeu_ps(hi, _mm256_extractf128_ps(v, 1));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 columnsAVX2(__m256 a0, __m256 a1, __m256 a2, __m256 a3, __m256 b)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a0, _mm256_permute_ps(b, 0x00)), _mm256_mul_ps(a1, _mm256_permute_ps(b, 0x55))),
+                                       _mm256_mul_ps(a2, _mm256_permute_ps(b, 0xAA))), _mm256_mul_ps(a3, _mm256_permute_ps(b, 0xFF)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 vectorsAVX2(__m256 a0, __m256 a1, __m256 a2, __m256 a3, __m256 v)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a0, _mm256_permute_ps(v, 0x00)), _mm256_mul_ps(a1, _mm256_permute_ps(v, 0x55))),
+                         _mm256_add_ps(_mm256_mul_ps(a2, _mm256_permute_ps(v, 0xAA)), _mm256_mul_ps(a3, _mm256_permute_ps(v, 0xFF))));
+}
+
+__attribute__((target("avx2")))
+static void composeAVX2(const glm::vec3* p, const glm::quat* q, const glm::vec3* s, glm::mat4* out, size_t n)
+{
+    const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+    // element j of a gathered register is the scale of matrix j
+    const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    __m256 t0, t1, t2, t3, xx, yy, zz, xz, xy, yz, wx, wy, wz, c0[4], c1[4], c2[4];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        // lane 0 holds matrices i to i + 3, lane 1 the next four
+        __m256 x = load2AVX2(&q[i].x, &q[i + 4].x), y = load2AVX2(&q[i + 1].x, &q[i + 5].x);
+        __m256 z = load2AVX2(&q[i + 2].x, &q[i + 6].x), w = load2AVX2(&q[i + 3].x, &q[i + 7].x);
+        TRANSPOSE4(256, x, y, z, w);
+        __m256 sx = _mm256_i32gather_ps(&s[i].x, stride, 4);
+        __m256 sy = _mm256_i32gather_ps(&s[i].y, stride, 4);
+        __m256 sz = _mm256_i32gather_ps(&s[i].z, stride, 4);
+        COMPOSE_ROTATION(256);
+        TRANSPOSE4(256, c0[0], c0[1], c0[2], c0[3]);
+        TRANSPOSE4(256, c1[0], c1[1], c1[2], c1[3]);
+        TRANSPOSE4(256, c2[0], c2[1], c2[2], c2[3]);
+        for (int k = 0; k < 4; k++)
+        {
+            store2AVX2(&out[i + k][0][0], &out[i + 4 + k][0][0], c0[k]);
+            store2AVX2(&out[i + k][1][0], &out[i + 4 + k][1][0], c1[k]);
+            store2AVX2(&out[i + k][2][0], &out[i + 4 + k][2][0], c2[k]);
+        }
+        for (int k = 0; k < 8; k++)
+            out[i + k][3] = glm::vec4(p[i + k], 1.0f);
+    }
+    composeScalar(p, q, s, out, i, n);
+}
+
+__attribute__((target("avx2")))
+static void multiplyAVX2(const glm::mat4* left, size_t leftStride, const glm::mat4* right, glm::mat4* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        // every column of the left matrix in both lanes, columns 0 and 1 of the right one, then 2 and 3
+        const __m128* a = (const __m128*)&left[i * leftStride][0][0];
+        const float* b = &right[i][0][0];
+        __m256 a0 = _mm256_broadcast_ps(a), a1 = _mm256_broadcast_ps(a + 1), a2 = _mm256_broadcast_ps(a + 2), a3 = _mm256_broadcast_ps(a + 3);
+        __m256 b01 = _mm256_loadu_ps(b), b23 = _mm256_loadu_ps(b + 8);
+        float* r = &out[i][0][0];
+        _mm256_storeu_ps(r, columnsAVX2(a0, a1, a2, a3, b01));
+        _mm256_storeu_ps(r + 8, columnsAVX2(a0, a1, a2, a3, b23));
+    }
+}
+
+__attribute__((target("avx2")))
+static void transformAVX2(const glm::mat4* m, size_t stride, const glm::vec4* in, glm::vec4* out, size_t n)
+{
+    size_t i = 0;
+    if (stride == 0)
+    {
+        const __m128* a = (const __m128*)&m[0][0][0];
+        __m256 a0 = _mm256_broadcast_ps(a), a1 = _mm256_broadcast_ps(a + 1), a2 = _mm256_broadcast_ps(a + 2), a3 = _mm256_broadcast_ps(a + 3);
+        for (; i + 2 <= n; i += 2)
+            _mm256_storeu_ps(&out[i].x, vectorsAVX2(a0, a1, a2, a3, _mm256_loadu_ps(&in[i].x)));
+    }
+    else
+    {
+        for (; i + 2 <= n; i += 2)
+        {
+            const float* a = &m[i][0][0];
+            const float* b = &m[i + 1][0][0];
+            __m256 v = _mm256_loadu_ps(&in[i].x);
+            _mm256_storeu_ps(&out[i].x, vectorsAVX2(load2AVX2(a, b), load2AVX2(a + 4, b + 4), load2AVX2(a + 8, b + 8), load2AVX2(a + 12, b + 12), v));
+        }
+    }
+    transformScalar(m, stride, in, out, i, n);
+}
+
+__attribute__((target("avx2")))
+static void normalAVX2(const glm::mat4* models, glm::mat3* out, size_t count)
+{
+    const __m256 one = _mm256_set1_ps(1.0f), sign = _mm256_set1_ps(-0.0f);
+    __m256 t0, t1, t2, t3, m0[4], m1[4], m2[4], d0, d1, d2, o, n[9];
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            m0[k] = load2AVX2(&models[i + k][0][0], &models[i + 4 + k][0][0]);
+            m1[k] = load2AVX2(&models[i + k][1][0], &models[i + 4 + k][1][0]);
+            m2[k] = load2AVX2(&models[i + k][2][0], &models[i + 4 + k][2][0]);
+        }
+        TRANSPOSE4(256, m0[0], m0[1], m0[2], m0[3]);
+        TRANSPOSE4(256, m1[0], m1[1], m1[2], m1[3]);
+        TRANSPOSE4(256, m2[0], m2[1], m2[2], m2[3]);
+        NORMAL_MATRIX(256, _mm256_xor_ps);
+        TRANSPOSE4(256, n[0], n[1], n[2], n[3]);
+        TRANSPOSE4(256, n[4], n[5], n[6], n[7]);
+        float last[8];
+        _mm256_storeu_ps(last, n[8]);
+        for (int k = 0; k < 4; k++)
+        {
+            float* lo = &out[i + k][0][0];
+            float* hi = &out[i + 4 + k][0][0];
+            store2AVX2(lo, hi, n[k]);
+            store2AVX2(lo + 4, hi + 4, n[4 + k]);
+            lo[8] = last[k];
+            hi[8] = last[4 + k];
+        }
+    }
+    normalScalar(models, out, i, count);
+}
+
+// ---- AVX-512: 16 matrices or a whole matrix at a time ----
+
+__attribute__((target("avx512f")))
+static inline __m512 load4AVX512(const float* a, const float* b, const float* c, const float* d)
+{
+    __m512 v = _mm512_castps128_ps512(_mm_loadu_ps(a));
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(b), 1);
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(c), 2);
+    return _mm512_insertf32x4(v, _mm_loadu_ps(d), 3);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 columnsAVX512(__m512 a0, __m512 a1, __m512 a2, __m512 a3, __m512 b)
+{
+    return _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(a0, _mm512_permute_ps(b, 0x00)), _mm512_mul_ps(a1, _mm512_permute_ps(b, 0x55))),
+                                       _mm512_mul_ps(a2, _mm512_permute_ps(b, 0xAA))), _mm512_mul_ps(a3, _mm512_permute_ps(b, 0xFF)));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 vectorsAVX512(__m512 a0, __m512 a1, __m512 a2, __m512 a3, __m512 v)
+{
+    return _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(a0, _mm512_permute_ps(v, 0x00)), _mm512_mul_ps(a1, _mm512_permute_ps(v, 0x55))),
+                         _mm512_add_ps(_mm512_mul_ps(a2, _mm512_permute_ps(v, 0xAA)), _mm512_mul_ps(a3, _mm512_permute_ps(v, 0xFF))));
+}
+
+// The 512-bit float logic instructions need AVX512DQ, the integer ones do not
+__attribute__((target("avx512f")))
+static inline __m512 xorAVX512(__m512 a, __m512 b)
+{
+    return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_castps_si512(b)));
+}
+
+__attribute__((target("avx512f")))
+static void composeAVX512(const glm::vec3* p, const glm::quat* q, const glm::vec3* s, glm::mat4* out, size_t n)
+{
+    const __m512 one = _mm512_set1_ps(1.0f), two = _mm512_set1_ps(2.0f), zero = _mm512_setzero_ps();
+    const __m512i stride = _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45);
+    __m512 t0, t1, t2, t3, xx, yy, zz, xz, xy, yz, wx, wy, wz, c0[4], c1[4], c2[4];
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        // lane L holds matrices i + 4L to i + 4L + 3
+        __m512 x = load4AVX512(&q[i].x, &q[i + 4].x, &q[i + 8].x, &q[i + 12].x);
+        __m512 y = load4AVX512(&q[i + 1].x, &q[i + 5].x, &q[i + 9].x, &q[i + 13].x);
+        __m512 z = load4AVX512(&q[i + 2].x, &q[i + 6].x, &q[i + 10].x, &q[i + 14].x);
+        __m512 w = load4AVX512(&q[i + 3].x, &q[i + 7].x, &q[i + 11].x, &q[i + 15].x);
+        TRANSPOSE4(512, x, y, z, w);
+        __m512 sx = _mm512_i32gather_ps(stride, &s[i].x, 4);
+        __m512 sy = _mm512_i32gather_ps(stride, &s[i].y, 4);
+        __m512 sz = _mm512_i32gather_ps(stride, &s[i].z, 4);
+        COMPOSE_ROTATION(512);
+        TRANSPOSE4(512, c0[0], c0[1], c0[2], c0[3]);
+        TRANSPOSE4(512, c1[0], c1[1], c1[2], c1[3]);
+        TRANSPOSE4(512, c2[0], c2[1], c2[2], c2[3]);
+        for (int k = 0; k < 4; k++)
+        {
+            glm::mat4* m = &out[i + k];
+            _mm_storeu_ps(&m[0][0][0], _mm512_castps512_ps128(c0[k]));
+            _mm_storeu_ps(&m[0][1][0], _mm512_castps512_ps128(c1[k]));
+            _mm_storeu_ps(&m[0][2][0], _mm512_castps512_ps128(c2[k]));
+            _mm_storeu_ps(&m[4][0][0], _mm512_extractf32x4_ps(c0[k], 1));
+            _mm_storeu_ps(&m[4][1][0], _mm512_extractf32x4_ps(c1[k], 1));
+            _mm_storeu_ps(&m[4][2][0], _mm512_extractf32x4_ps(c2[k], 1));
+            _mm_storeu_ps(&m[8][0][0], _mm512_extractf32x4_ps(c0[k], 2));
+            _mm_storeu_ps(&m[8][1][0], _mm512_extractf32x4_ps(c1[k], 2));
+            _mm_storeu_ps(&m[8][2][0], _mm512_extractf32x4_ps(c2[k], 2));
+            _mm_storeu_ps(&m[12][0][0], _mm512_extractf32x4_ps(c0[k], 3));
+            _mm_storeu_ps(&m[12][1][0], _mm512_extractf32x4_ps(c1[k], 3));
+            _mm_storeu_ps(&m[12][2][0], _mm512_extractf32x4_ps(c2[k], 3));
+        }
+        for (int k = 0; k < 16; k++)
+            out[i + k][3] = glm::vec4(p[i + k], 1.0f);
+    }
+    composeScalar(p, q, s, out, i, n);
+}
+
+__attribute__((target("avx512f")))
+static void multiplyAVX512(const glm::mat4* left, size_t leftStride, const glm::mat4* right, glm::mat4* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const float* a = &left[i * leftStride][0][0];
+        __m512 a0 = _mm512_broadcast_f32x4(_mm_loadu_ps(a)), a1 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 4));
+        __m512 a2 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 8)), a3 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 12));
+        _mm512_storeu_ps(&out[i][0][0], columnsAVX512(a0, a1, a2, a3, _mm512_loadu_ps(&right[i][0][0])));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void transformAVX512(const glm::mat4* m, size_t stride, const glm::vec4* in, glm::vec4* out, size_t n)
+{
+    size_t i = 0;
+    if (stride == 0)
+    {
+        const float* a = &m[0][0][0];
+        __m512 a0 = _mm512_broadcast_f32x4(_mm_loadu_ps(a)), a1 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 4));
+        __m512 a2 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 8)), a3 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 12));
+        for (; i + 4 <= n; i += 4)
+            _mm512_storeu_ps(&out[i].x, vectorsAVX512(a0, a1, a2, a3, _mm512_loadu_ps(&in[i].x)));
+    }
+    else
+    {
+        for (; i + 4 <= n; i += 4)
+        {
+            const float* a = &m[i][0][0];
+            __m512 a0 = load4AVX512(a, a + 16, a + 32, a + 48), a1 = load4AVX512(a + 4, a + 20, a + 36, a + 52);
+            __m512 a2 = load4AVX512(a + 8, a + 24, a + 40, a + 56), a3 = load4AVX512(a + 12, a + 28, a + 44, a + 60);
+            _mm512_storeu_ps(&out[i].x, vectorsAVX512(a0, a1, a2, a3, _mm512_loadu_ps(&in[i].x)));
+        }
+    }
+    transformScalar(m, stride, in, out, i, n);
+}
+
+__attribute__((target("avx512f")))
+static void normalAVX512(const glm::mat4* models, glm::mat3* out, size_t count)
+{
+    const __m512 one = _mm512_set1_ps(1.0f), sign = _mm512_set1_ps(-0.0f);
+    __m512 t0, t1, t2, t3, m0[4], m1[4], m2[4], d0, d1, d2, o, n[9];
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            const glm::mat4* m = &models[i + k];
+            m0[k] = load4AVX512(&m[0][0][0], &m[4][0][0], &m[8][0][0], &m[12][0][0]);
+            m1[k] = load4AVX512(&m[0][1][0], &m[4][1][0], &m[8][1][0], &m[12][1][0]);
+            m2[k] = load4AVX512(&m[0][2][0], &m[4][2][0], &m[8][2][0], &m[12][2][0]);
+        }
+        TRANSPOSE4(512, m0[0], m0[1], m0[2], m0[3]);
+        TRANSPOSE4(512, m1[0], m1[1], m1[2], m1[3]);
+        TRANSPOSE4(512, m2[0], m2[1], m2[2], m2[3]);
+        NORMAL_MATRIX(512, xorAVX512);
+        TRANSPOSE4(512, n[0], n[1], n[2], n[3]);
+        TRANSPOSE4(512, n[4], n[5], n[6], n[7]);
+        float last[16];
+        _mm512_storeu_ps(last, n[8]);
+        for (int k = 0; k < 4; k++)
+        {
+            float* r[4] = { &out[i + k][0][0], &out[i + 4 + k][0][0], &out[i + 8 + k][0][0], &out[i + 12 + k][0][0] };
+            _mm_storeu_ps(r[0], _mm512_castps512_ps128(n[k]));
+            _mm_storeu_ps(r[0] + 4, _mm512_castps512_ps128(n[4 + k]));
+            _mm_storeu_ps(r[1], _mm512_extractf32x4_ps(n[k], 1));
+            _mm_storeu_ps(r[1] + 4, _mm512_extractf32x4_ps(n[4 + k], 1));
+            _mm_storeu_ps(r[2], _mm512_extractf32x4_ps(n[k], 2));
+            _mm_storeu_ps(r[2] + 4, _mm512_extractf32x4_ps(n[4 + k], 2));
+            _mm_storeu_ps(r[3], _mm512_extractf32x4_ps(n[k], 3));
+            _mm_storeu_ps(r[3] + 4, _mm512_extractf32x4_ps(n[4 + k], 3));
+            for (int l = 0; l < 4; l++)
+                r[l][8] = last[4 * l + k];
+        }
+    }
+    normalScalar(models, out, i, count);
+}
+
+#endif
+
+void composeMatrices(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* out, size_t n, MatrixPath path)
+{
+    switch (resolvePath(path))
+    {
+#ifdef MATRIX_X86
+        case MATRIX_AVX512:
+            return composeAVX512(positions, rotations, scales, out, n);
+        case MATRIX_AVX2:
+            return composeAVX2(positions, rotations, scales, out, n);
+        case MATRIX_SSE4:
+            return composeSSE4(positions, rotations, scales, out, n);
+#endif
+        default:
+            return composeScalar(positions, rotations, scales, out, 0, n);
+    }
+}
+
+// the single left matrix is the array case with a stride of 0
+static void multiply(const glm::mat4* left, size_t leftStride, const glm::mat4* right, glm::mat4* out, size_t n, MatrixPath path)
+{
+    switch (resolvePath(path))
+    {
+#ifdef MATRIX_X86
+        case MATRIX_AVX512:
+            return multiplyAVX512(left, leftStride, right, out, n);
+        case MATRIX_AVX2:
+            return multiplyAVX2(left, leftStride, right, out, n);
+        case MATRIX_SSE4:
+            return multiplySSE4(left, leftStride, right, out, n);
+#endif
+        default:
+            return multiplyScalar(left, leftStride, right, out, 0, n);
+    }
+}
+
+void multiplyMatrices(const glm::mat4 &left, const glm::mat4* right, glm::mat4* out, size_t n, MatrixPath path)
+{
+    // a copy, left may be one of the matrices being overwritten
+    glm::mat4 matrix = left;
+    multiply(&matrix, 0, right, out, n, path);
+}
+
+void multiplyMatrices(const glm::mat4* left, const glm::mat4* right, glm::mat4* out, size_t n, MatrixPath path)
+{
+    multiply(left, 1, right, out, n, path);
+}
+
+static void transform(const glm::mat4* matrices, size_t stride, const glm::vec4* in, glm::vec4* out, size_t n, MatrixPath path)
+{
+    switch (resolvePath(path))
+    {
+#ifdef MATRIX_X86
+        case MATRIX_AVX512:
+            return transformAVX512(matrices, stride, in, out, n);
+        case MATRIX_AVX2:
+            return transformAVX2(matrices, stride, in, out, n);
+        case MATRIX_SSE4:
+            return transformSSE4(matrices, stride, in, out, n);
+#endif
+        default:
+            return transformScalar(matrices, stride, in, out, 0, n);
+    }
+}
+
+void transformVectors(const glm::mat4 &matrix, const glm::vec4* in, glm::vec4* out, size_t n, MatrixPath path)
+{
+    transform(&matrix, 0, in, out, n, path);
+}
+
+void transformVectors(const glm::mat4* matrices, const glm::vec4* in, glm::vec4* out, size_t n, MatrixPath path)
+{
+    transform(matrices, 1, in, out, n, path);
+}
+
+void normalMatrices(const glm::mat4* models, glm::mat3* out, size_t n, MatrixPath path)
+{
+    switch (resolvePath(path))
+    {
+#ifdef MATRIX_X86
+        case MATRIX_AVX512:
+            return normalAVX512(models, out, n);
+        case MATRIX_AVX2:
+            return normalAVX2(models, out, n);
+        case MATRIX_SSE4:
+            return normalSSE4(models, out, n);
+#endif
+        default:
+            return normalScalar(models, out, 0, n);
+    }
+}
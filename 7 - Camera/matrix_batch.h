@@ -0,0 +1,36 @@
+#ifndef MATRIX_BATCH_H
+#define MATRIX_BATCH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+
+enum MatrixPath
+{
+    MATRIX_SCALAR,  // the reference, glm's own order of operations written out
+    MATRIX_SSE4,    // one matrix per step, or 4 for the kernels that work across matrices
+    MATRIX_AVX2,    // two columns per register, or 8 matrices
+    MATRIX_AVX512,  // a whole matrix per register, or 16 matrices
+    MATRIX_BEST     // the widest path the CPU supports
+};
+
+// Matrix math over arrays, for loops that would otherwise call glm once per object. Every path
+// multiplies and adds in the same order as glm and never fuses the two, so the results are the
+// same bits as glm's whichever path runs. Output may be the same array as an input of the same type
+
+// model = translate(position) * mat4_cast(rotation) * scale(scale)
+void composeMatrices(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* out, size_t n, MatrixPath path = MATRIX_BEST);
+// out[i] = left * right[i], e.g. view-projection times each model
+void multiplyMatrices(const glm::mat4 &left, const glm::mat4* right, glm::mat4* out, size_t n, MatrixPath path = MATRIX_BEST);
+// out[i] = left[i] * right[i]
+void multiplyMatrices(const glm::mat4* left, const glm::mat4* right, glm::mat4* out, size_t n, MatrixPath path = MATRIX_BEST);
+// out[i] = matrix * in[i]
+void transformVectors(const glm::mat4 &matrix, const glm::vec4* in, glm::vec4* out, size_t n, MatrixPath path = MATRIX_BEST);
+// out[i] = matrices[i] * in[i]
+void transformVectors(const glm::mat4* matrices, const glm::vec4* in, glm::vec4* out, size_t n, MatrixPath path = MATRIX_BEST);
+// out[i] = transpose(inverse(mat3(models[i]))), what normals are multiplied by
+void normalMatrices(const glm::mat4* models, glm::mat3* out, size_t n, MatrixPath path = MATRIX_BEST);
+
+bool matrixPathSupported(MatrixPath path);
+
+#endif
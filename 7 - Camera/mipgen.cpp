@@ -0,0 +1,644 @@
+#include "mipgen.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MIPGEN_X86 1
+#endif
+
+// taps of the Kaiser filter, centred between the two source texels of an output texel
+static const int KAISER_TAPS = 8;
+
+MipOptions::MipOptions()
+    : filter(MIP_BOX), srgb(true), preserveCoverage(true), alphaRef(0.5f), path(MIP_BEST)
+{
+}
+
+// 8-bit values to 16-bit linear and back
+struct MipTables
+{
+    uint16_t srgbToLinear[256];
+    uint16_t unormToLinear[256];
+    unsigned char linearToSrgb[65536];
+    unsigned char linearToUnorm[65536];
+    float kaiser[KAISER_TAPS];
+
+    MipTables()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            double c = i / 255.0;
+            double linear = c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+            srgbToLinear[i] = (uint16_t)(linear * 65535.0 + 0.5);
+            unormToLinear[i] = (uint16_t)(i * 257);
+        }
+        for (int i = 0; i < 65536; i++)
+        {
+            double linear = i / 65535.0;
+            double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * pow(linear, 1.0 / 2.4) - 0.055;
+            linearToSrgb[i] = (unsigned char)(c * 255.0 + 0.5);
+            linearToUnorm[i] = (unsigned char)((i * 255 + 32767) / 65535);
+        }
+        // sinc for a 2x reduction under a Kaiser window (beta 4) that reaches zero 4 source texels out
+        const double beta = 4.0, radius = 4.0;
+        double sum = 0.0, weights[KAISER_TAPS];
+        for (int k = 0; k < KAISER_TAPS; k++)
+        {
+            double d = k - KAISER_TAPS / 2 + 0.5;
+            double t = d / 2.0;
+            double sinc = sin(M_PI * t) / (M_PI * t);
+            double r = d / radius;
+            weights[k] = sinc * besselI0(beta * sqrt(1.0 - r * r)) / besselI0(beta);
+            sum += weights[k];
+        }
+        for (int k = 0; k < KAISER_TAPS; k++)
+            kaiser[k] = (float)(weights[k] / sum);
+    }
+
+    static double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 30; k++)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+};
+
+static const MipTables& tables()
+{
+    // built on first use, C++11 makes that safe from several worker threads
+    static MipTables t;
+    return t;
+}
+
+bool mipPathSupported(MipPath path)
+{
+    switch (path)
+    {
+        case MIP_SCALAR:
+        case MIP_BEST:
+            return true;
+#ifdef MIPGEN_X86
+        case MIP_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case MIP_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static MipPath resolvePath(MipPath path)
+{
+    if (path != MIP_BEST)
+        return mipPathSupported(path) ? path : MIP_SCALAR;
+    if (mipPathSupported(MIP_AVX2))
+        return MIP_AVX2;
+    return mipPathSupported(MIP_SSE2) ? MIP_SSE2 : MIP_SCALAR;
+}
+
+static void decodeLevel(const unsigned char* rgba, size_t pixels, bool srgb, uint16_t* out)
+{
+    const MipTables &t = tables();
+    const uint16_t* colour = srgb ? t.srgbToLinear : t.unormToLinear;
+    for (size_t i = 0; i < pixels * 4; i += 4)
+    {
+        out[i] = colour[rgba[i]];
+        out[i + 1] = colour[rgba[i + 1]];
+        out[i + 2] = colour[rgba[i + 2]];
+        out[i + 3] = t.unormToLinear[rgba[i + 3]];
+    }
+}
+
+static void encodeLevel(const uint16_t* in, size_t pixels, bool srgb, unsigned char* out)
+{
+    const MipTables &t = tables();
+    const unsigned char* colour = srgb ? t.linearToSrgb : t.linearToUnorm;
+    for (size_t i = 0; i < pixels * 4; i += 4)
+    {
+        out[i] = colour[in[i]];
+        out[i + 1] = colour[in[i + 1]];
+        out[i + 2] = colour[in[i + 2]];
+        out[i + 3] = t.linearToUnorm[in[i + 3]];
+    }
+}
+
+// Levels are filtered in bands of output rows. Source rows are reached through row pointers, so level 0
+// only ever has the band's rows decoded to 16 bits instead of a second full-size copy of the image
+static const int BAND_ROWS = 16;
+
+// ---- box filter into max(1, w/2) x max(1, h/2), a 1 texel wide side reuses its only row/column ----
+
+static void boxScalar(const uint16_t* const* rows, int w, int h, int y0, int y1, uint16_t* dst)
+{
+    int nw = w > 1 ? w / 2 : 1;
+    for (int y = y0; y < y1; y++)
+    {
+        const uint16_t* r0 = rows[std::min(2 * y, h - 1)];
+        const uint16_t* r1 = rows[std::min(2 * y + 1, h - 1)];
+        uint16_t* out = dst + (size_t)(y - y0) * nw * 4;
+        for (int x = 0; x < nw; x++)
+        {
+            int x0 = std::min(2 * x, w - 1) * 4, x1 = std::min(2 * x + 1, w - 1) * 4;
+            for (int c = 0; c < 4; c++)
+                out[x * 4 + c] = (uint16_t)((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+        }
+    }
+}
+
+#ifdef MIPGEN_X86
+// sums are widened to 32 bits so the rounding matches the scalar path exactly
+__attribute__((target("sse2")))
+static void boxSSE2(const uint16_t* const* rows, int w, int h, int y0, int y1, uint16_t* dst)
+{
+    if (w < 2)
+        return boxScalar(rows, w, h, y0, y1, dst);
+    int nw = w / 2;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    for (int y = y0; y < y1; y++)
+    {
+        const uint16_t* r0 = rows[std::min(2 * y, h - 1)];
+        const uint16_t* r1 = rows[std::min(2 * y + 1, h - 1)];
+        uint16_t* out = dst + (size_t)(y - y0) * nw * 4;
+        int x = 0;
+        // two output texels from four source texels per row
+        for (; x + 2 <= nw; x += 2)
+        {
+            __m128i a0 = _mm_loadu_si128((const __m128i*)(r0 + x * 8));
+            __m128i a1 = _mm_loadu_si128((const __m128i*)(r1 + x * 8));
+            __m128i b0 = _mm_loadu_si128((const __m128i*)(r0 + x * 8 + 8));
+            __m128i b1 = _mm_loadu_si128((const __m128i*)(r1 + x * 8 + 8));
+            __m128i q0 = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a0, zero), _mm_unpackhi_epi16(a0, zero)),
+                                       _mm_add_epi32(_mm_unpacklo_epi16(a1, zero), _mm_unpackhi_epi16(a1, zero)));
+            __m128i q1 = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(b0, zero), _mm_unpackhi_epi16(b0, zero)),
+                                       _mm_add_epi32(_mm_unpacklo_epi16(b1, zero), _mm_unpackhi_epi16(b1, zero)));
+            q0 = _mm_srli_epi32(_mm_add_epi32(q0, two), 2);
+            q1 = _mm_srli_epi32(_mm_add_epi32(q1, two), 2);
+            // SSE2 only packs with signed saturation, so go through the signed range and back
+            __m128i packed = _mm_packs_epi32(_mm_sub_epi32(q0, bias32), _mm_sub_epi32(q1, bias32));
+            _mm_storeu_si128((__m128i*)(out + x * 4), _mm_xor_si128(packed, bias16));
+        }
+        for (; x < nw; x++)
+            for (int c = 0; c < 4; c++)
+                out[x * 4 + c] = (uint16_t)((r0[x * 8 + c] + r0[x * 8 + 4 + c] + r1[x * 8 + c] + r1[x * 8 + 4 + c] + 2) >> 2);
+    }
+}
+
+__attribute__((target("avx2")))
+static void boxAVX2(const uint16_t* const* rows, int w, int h, int y0, int y1, uint16_t* dst)
+{
+    if (w < 2)
+        return boxScalar(rows, w, h, y0, y1, dst);
+    int nw = w / 2;
+    const __m256i two = _mm256_set1_epi32(2);
+    for (int y = y0; y < y1; y++)
+    {
+        const uint16_t* r0 = rows[std::min(2 * y, h - 1)];
+        const uint16_t* r1 = rows[std::min(2 * y + 1, h - 1)];
+        uint16_t* out = dst + (size_t)(y - y0) * nw * 4;
+        int x = 0;
+        // four output texels from eight source texels per row
+        for (; x + 4 <= nw; x += 4)
+        {
+            __m256i q[2];
+            for (int half = 0; half < 2; half++)
+            {
+                // [t0 | t1] and [t2 | t3] of this half widened to 32 bits, both rows added
+                const uint16_t* p0 = r0 + x * 8 + half * 16;
+                const uint16_t* p1 = r1 + x * 8 + half * 16;
+                __m256i lo = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p0)),
+                                              _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p1)));
+                __m256i hi = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(p0 + 8))),
+                                              _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(p1 + 8))));
+                // [t0 + t1 | t2 + t3]
+                __m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(lo, hi, 0x20), _mm256_permute2x128_si256(lo, hi, 0x31));
+                q[half] = _mm256_srli_epi32(_mm256_add_epi32(sum, two), 2);
+            }
+            // the pack works per 128-bit lane, [q0 q2 | q1 q3] is put back in order afterwards
+            __m256i packed = _mm256_packus_epi32(q[0], q[1]);
+            _mm256_storeu_si256((__m256i*)(out + x * 4), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+        for (; x < nw; x++)
+            for (int c = 0; c < 4; c++)
+                out[x * 4 + c] = (uint16_t)((r0[x * 8 + c] + r0[x * 8 + 4 + c] + r1[x * 8 + c] + r1[x * 8 + 4 + c] + 2) >> 2);
+    }
+}
+#endif
+
+// ---- Kaiser filter: separable, a horizontal pass into floats and a vertical pass back to 16 bits ----
+
+// clamped source index of every tap of every output texel
+static void kaiserTaps(int size, int outSize, std::vector<int> &taps)
+{
+    taps.resize((size_t)outSize * KAISER_TAPS);
+    for (int x = 0; x < outSize; x++)
+        for (int k = 0; k < KAISER_TAPS; k++)
+            taps[(size_t)x * KAISER_TAPS + k] = std::min(std::max(2 * x + k - KAISER_TAPS / 2 + 1, 0), size - 1);
+}
+
+static uint16_t toLinear16(float v)
+{
+    return (uint16_t)(std::min(std::max(v, 0.0f), 65535.0f) + 0.5f);
+}
+
+// source rows first..last - 1 into rows 0.. of tmp
+static void kaiserHorizontalScalar(const uint16_t* const* rows, int first, int last, int nw, const int* taps, float* tmp)
+{
+    const float* weights = tables().kaiser;
+    for (int y = first; y < last; y++)
+    {
+        const uint16_t* row = rows[y];
+        float* out = tmp + (size_t)(y - first) * nw * 4;
+        for (int x = 0; x < nw; x++)
+            for (int c = 0; c < 4; c++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < KAISER_TAPS; k++)
+                    sum += weights[k] * row[taps[x * KAISER_TAPS + k] * 4 + c];
+                out[x * 4 + c] = sum;
+            }
+    }
+}
+
+// output rows y0..y1 - 1 from tmp, whose row 0 is source row first
+static void kaiserVerticalScalar(const float* tmp, int first, int nw, int y0, int y1, const int* taps, uint16_t* dst)
+{
+    const float* weights = tables().kaiser;
+    for (int y = y0; y < y1; y++)
+        for (int x = 0; x < nw * 4; x++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < KAISER_TAPS; k++)
+                sum += weights[k] * tmp[(size_t)(taps[y * KAISER_TAPS + k] - first) * nw * 4 + x];
+            dst[(size_t)(y - y0) * nw * 4 + x] = toLinear16(sum);
+        }
+}
+
+#ifdef MIPGEN_X86
+// one texel per register, the four channels side by side. Multiplies and adds happen in the same order
+// as in the scalar loops, so the results are identical
+__attribute__((target("sse2")))
+static __m128 kaiserTexelSSE2(const uint16_t* row, const int* taps)
+{
+    const float* weights = tables().kaiser;
+    const __m128i zero = _mm_setzero_si128();
+    __m128 sum = _mm_setzero_ps();
+    for (int k = 0; k < KAISER_TAPS; k++)
+    {
+        __m128i texel = _mm_loadl_epi64((const __m128i*)(row + taps[k] * 4));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_cvtepi32_ps(_mm_unpacklo_epi16(texel, zero))));
+    }
+    return sum;
+}
+
+__attribute__((target("sse2")))
+static void kaiserHorizontalSSE2(const uint16_t* const* rows, int first, int last, int nw, const int* taps, float* tmp)
+{
+    for (int y = first; y < last; y++)
+    {
+        float* out = tmp + (size_t)(y - first) * nw * 4;
+        for (int x = 0; x < nw; x++)
+            _mm_storeu_ps(out + x * 4, kaiserTexelSSE2(rows[y], taps + x * KAISER_TAPS));
+    }
+}
+
+__attribute__((target("sse2")))
+static __m128i toLinear16SSE2(__m128 v)
+{
+    v = _mm_add_ps(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(65535.0f)), _mm_set1_ps(0.5f));
+    __m128i i = _mm_sub_epi32(_mm_cvttps_epi32(v), _mm_set1_epi32(32768));
+    return _mm_xor_si128(_mm_packs_epi32(i, i), _mm_set1_epi16((short)0x8000));
+}
+
+__attribute__((target("sse2")))
+static __m128 kaiserColumnSSE2(const float* tmp, int first, int nw, int x, const int* taps)
+{
+    const float* weights = tables().kaiser;
+    __m128 sum = _mm_setzero_ps();
+    for (int k = 0; k < KAISER_TAPS; k++)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(tmp + ((size_t)(taps[k] - first) * nw + x) * 4)));
+    return sum;
+}
+
+__attribute__((target("sse2")))
+static void kaiserVerticalSSE2(const float* tmp, int first, int nw, int y0, int y1, const int* taps, uint16_t* dst)
+{
+    for (int y = y0; y < y1; y++)
+    {
+        uint16_t* out = dst + (size_t)(y - y0) * nw * 4;
+        for (int x = 0; x < nw; x++)
+            _mm_storel_epi64((__m128i*)(out + x * 4), toLinear16SSE2(kaiserColumnSSE2(tmp, first, nw, x, taps + y * KAISER_TAPS)));
+    }
+}
+
+// two texels per register, an odd last one goes through the SSE2 code
+__attribute__((target("avx2")))
+static void kaiserHorizontalAVX2(const uint16_t* const* rows, int first, int last, int nw, const int* taps, float* tmp)
+{
+    const float* weights = tables().kaiser;
+    for (int y = first; y < last; y++)
+    {
+        const uint16_t* row = rows[y];
+        float* out = tmp + (size_t)(y - first) * nw * 4;
+        int x = 0;
+        for (; x + 2 <= nw; x += 2)
+        {
+            const int* t0 = taps + x * KAISER_TAPS;
+            const int* t1 = t0 + KAISER_TAPS;
+            __m256 sum = _mm256_setzero_ps();
+            for (int k = 0; k < KAISER_TAPS; k++)
+            {
+                __m128i texels = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(row + t0[k] * 4)),
+                                                    _mm_loadl_epi64((const __m128i*)(row + t1[k] * 4)));
+                __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(texels));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), v));
+            }
+            _mm256_storeu_ps(out + x * 4, sum);
+        }
+        if (x < nw)
+            _mm_storeu_ps(out + x * 4, kaiserTexelSSE2(row, taps + x * KAISER_TAPS));
+    }
+}
+
+__attribute__((target("avx2")))
+static void kaiserVerticalAVX2(const float* tmp, int first, int nw, int y0, int y1, const int* taps, uint16_t* dst)
+{
+    const float* weights = tables().kaiser;
+    for (int y = y0; y < y1; y++)
+    {
+        const int* t = taps + y * KAISER_TAPS;
+        uint16_t* out = dst + (size_t)(y - y0) * nw * 4;
+        int x = 0;
+        for (; x + 2 <= nw; x += 2)
+        {
+            __m256 sum = _mm256_setzero_ps();
+            for (int k = 0; k < KAISER_TAPS; k++)
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(tmp + ((size_t)(t[k] - first) * nw + x) * 4)));
+            sum = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(sum, _mm256_setzero_ps()), _mm256_set1_ps(65535.0f)), _mm256_set1_ps(0.5f));
+            __m256i i = _mm256_cvttps_epi32(sum);
+            // packing per lane leaves the two texels in the low halves of the two lanes
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(i, i), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128((__m128i*)(out + x * 4), _mm256_castsi256_si128(packed));
+        }
+        if (x < nw)
+            _mm_storel_epi64((__m128i*)(out + x * 4), toLinear16SSE2(kaiserColumnSSE2(tmp, first, nw, x, t)));
+    }
+}
+#endif
+
+// one level's filter and the scratch space its bands share
+struct LevelFilter
+{
+    MipFilter filter;
+    MipPath path;
+    int w, h, nw, nh;
+    std::vector<int> columnTaps, rowTaps;
+    std::vector<float> tmp;
+
+    void begin(int width, int height)
+    {
+        w = width;
+        h = height;
+        nw = w > 1 ? w / 2 : 1;
+        nh = h > 1 ? h / 2 : 1;
+        if (filter == MIP_KAISER)
+        {
+            kaiserTaps(w, nw, columnTaps);
+            kaiserTaps(h, nh, rowTaps);
+        }
+    }
+
+    // the source rows output rows y0..y1 - 1 read
+    void sourceRows(int y0, int y1, int &first, int &last) const
+    {
+        if (filter == MIP_KAISER)
+        {
+            first = rowTaps[y0 * KAISER_TAPS];
+            last = rowTaps[(y1 - 1) * KAISER_TAPS + KAISER_TAPS - 1] + 1;
+        }
+        else
+        {
+            first = std::min(2 * y0, h - 1);
+            last = std::min(2 * y1 - 1, h - 1) + 1;
+        }
+    }
+
+    // output rows y0..y1 - 1 into dst, rows has a pointer for every source row they read
+    void band(const uint16_t* const* rows, int y0, int y1, uint16_t* dst)
+    {
+        if (filter == MIP_BOX)
+        {
+#ifdef MIPGEN_X86
+            if (path == MIP_AVX2)
+                return boxAVX2(rows, w, h, y0, y1, dst);
+            if (path == MIP_SSE2)
+                return boxSSE2(rows, w, h, y0, y1, dst);
+#endif
+            return boxScalar(rows, w, h, y0, y1, dst);
+        }
+
+        int first, last;
+        sourceRows(y0, y1, first, last);
+        tmp.resize((size_t)nw * (last - first) * 4);
+#ifdef MIPGEN_X86
+        if (path == MIP_AVX2)
+        {
+            kaiserHorizontalAVX2(rows, first, last, nw, &columnTaps[0], &tmp[0]);
+            kaiserVerticalAVX2(&tmp[0], first, nw, y0, y1, &rowTaps[0], dst);
+            return;
+        }
+        if (path == MIP_SSE2)
+        {
+            kaiserHorizontalSSE2(rows, first, last, nw, &columnTaps[0], &tmp[0]);
+            kaiserVerticalSSE2(&tmp[0], first, nw, y0, y1, &rowTaps[0], dst);
+            return;
+        }
+#endif
+        kaiserHorizontalScalar(rows, first, last, nw, &columnTaps[0], &tmp[0]);
+        kaiserVerticalScalar(&tmp[0], first, nw, y0, y1, &rowTaps[0], dst);
+    }
+};
+
+// ---- alpha coverage ----
+
+static void alphaHistogram(const unsigned char* rgba, size_t pixels, size_t histogram[256])
+{
+    memset(histogram, 0, 256 * sizeof(size_t));
+    for (size_t i = 0; i < pixels; i++)
+        histogram[rgba[i * 4 + 3]]++;
+}
+
+// share of texels that pass the alpha test once alpha is scaled
+static double coverage(const size_t histogram[256], size_t pixels, int ref, float scale)
+{
+    size_t passed = 0;
+    for (int a = 0; a < 256; a++)
+        if (histogram[a] && std::min(255, (int)(a * scale + 0.5f)) >= ref)
+            passed += histogram[a];
+    return (double)passed / pixels;
+}
+
+// finds the alpha scale that brings the level's coverage closest to target and applies it
+static void scaleToCoverage(unsigned char* rgba, size_t pixels, int ref, double target)
+{
+    size_t histogram[256];
+    alphaHistogram(rgba, pixels, histogram);
+    // coverage only grows with the scale, so a bisection finds it
+    float low = 0.0f, high = 256.0f;
+    for (int i = 0; i < 24; i++)
+    {
+        float mid = 0.5f * (low + high);
+        if (coverage(histogram, pixels, ref, mid) < target)
+            low = mid;
+        else
+            high = mid;
+    }
+    float scale = fabs(coverage(histogram, pixels, ref, low) - target) < fabs(coverage(histogram, pixels, ref, high) - target) ? low : high;
+    // a level that is already as close as it gets keeps its alpha
+    if (fabs(coverage(histogram, pixels, ref, 1.0f) - target) <= fabs(coverage(histogram, pixels, ref, scale) - target))
+        return;
+    for (size_t i = 0; i < pixels; i++)
+        rgba[i * 4 + 3] = (unsigned char)std::min(255, (int)(rgba[i * 4 + 3] * scale + 0.5f));
+}
+
+void buildMipChain(const unsigned char* rgba, int width, int height, const MipOptions &options, KtxTexture &chain)
+{
+    chain = KtxTexture();
+    chain.internalFormat = GL_RGBA8;
+    chain.format = GL_RGBA;
+    chain.type = GL_UNSIGNED_BYTE;
+    // growing the block level by level would copy the whole chain a dozen times
+    chain.data.reserve(rgba8ChainBytes(width, height));
+    memcpy(chain.addLevel(width, height, (size_t)width * height * 4), rgba, (size_t)width * height * 4);
+
+    // cutouts keep the share of texels that pass the alpha test, opaque images are left alone
+    size_t histogram[256];
+    int ref = (int)ceilf(options.alphaRef * 255.0f);
+    bool cutout = false;
+    double target = 0.0;
+    if (options.preserveCoverage)
+    {
+        alphaHistogram(rgba, (size_t)width * height, histogram);
+        cutout = histogram[255] < (size_t)width * height;
+        target = coverage(histogram, (size_t)width * height, ref, 1.0f);
+    }
+
+    // every level is filtered from the unscaled 16-bit linear one above it, only the stored bytes are rounded
+    LevelFilter filter;
+    filter.filter = options.filter;
+    filter.path = resolvePath(options.path);
+    std::vector<uint16_t> src, dst, decoded;
+    std::vector<const uint16_t*> rows;
+    int w = width, h = height;
+    while (w > 1 || h > 1)
+    {
+        filter.begin(w, h);
+        int nw = filter.nw, nh = filter.nh;
+        dst.resize((size_t)nw * nh * 4);
+        rows.resize(h);
+        for (int y = 0; y < h && !src.empty(); y++)
+            rows[y] = &src[(size_t)y * w * 4];
+        for (int y0 = 0; y0 < nh; y0 += BAND_ROWS)
+        {
+            int y1 = std::min(y0 + BAND_ROWS, nh);
+            if (src.empty())
+            {
+                // level 0 is decoded a band at a time, rows shared with the previous band are decoded again
+                int first, last;
+                filter.sourceRows(y0, y1, first, last);
+                decoded.resize((size_t)(last - first) * w * 4);
+                decodeLevel(rgba + (size_t)first * w * 4, (size_t)(last - first) * w, options.srgb, &decoded[0]);
+                for (int y = first; y < last; y++)
+                    rows[y] = &decoded[(size_t)(y - first) * w * 4];
+            }
+            filter.band(&rows[0], y0, y1, &dst[(size_t)y0 * nw * 4]);
+        }
+        unsigned char* level = chain.addLevel(nw, nh, (size_t)nw * nh * 4);
+        encodeLevel(&dst[0], (size_t)nw * nh, options.srgb, level);
+        if (cutout)
+            scaleToCoverage(level, (size_t)nw * nh, ref, target);
+        src.swap(dst);
+        w = nw;
+        h = nh;
+    }
+}
+
+bool loadImageRgba(const std::string &path, std::vector<unsigned char> &rgba, int &width, int &height)
+{
+    SDL_Surface* raw = IMG_Load(path.c_str());
+    if (!raw)
+        return false;
+    SDL_Surface* image = SDL_ConvertSurfaceFormat(raw, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(raw);
+    if (!image)
+        return false;
+    width = image->w;
+    height = image->h;
+    rgba.resize((size_t)width * height * 4);
+    for (int y = 0; y < height; y++)
+        memcpy(&rgba[(size_t)y * width * 4], (unsigned char*)image->pixels + y * image->pitch, (size_t)width * 4);
+    SDL_FreeSurface(image);
+    return true;
+}
+
+std::string mipCachePath(const std::string &path, const MipOptions &options)
+{
+    size_t dot = path.rfind('.');
+    size_t slash = path.find_last_of("/\\");
+    std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? path.substr(0, dot) : path;
+    // the coverage target is named the way buildMipChain rounds it, as an 8-bit alpha
+    char coverage[32] = "";
+    if (options.preserveCoverage)
+        snprintf(coverage, sizeof(coverage), ".coverage%d", (int)ceilf(options.alphaRef * 255.0f));
+    return stem + (options.filter == MIP_KAISER ? ".kaiser" : ".box") + (options.srgb ? ".srgb" : ".linear")
+         + coverage + ".mips.ktx";
+}
+
+// the cache only counts when it was written after the image last changed
+static bool newerThan(const std::string &path, const std::string &than)
+{
+    struct stat a, b;
+    return stat(path.c_str(), &a) == 0 && stat(than.c_str(), &b) == 0 && a.st_mtime >= b.st_mtime;
+}
+
+bool loadMipChain(const std::string &path, const MipOptions &options, KtxTexture &chain, bool* cached)
+{
+    std::string cache = mipCachePath(path, options);
+    if (cached)
+        *cached = false;
+    if (newerThan(cache, path) && readKtx(cache, chain) && !chain.compressed() && chain.internalFormat == GL_RGBA8)
+    {
+        if (cached)
+            *cached = true;
+        return true;
+    }
+
+    std::vector<unsigned char> rgba;
+    int width, height;
+    if (!loadImageRgba(path, rgba, width, height))
+        return false;
+    buildMipChain(&rgba[0], width, height, options, chain);
+    // written under a temporary name and renamed into place, so a crash or a second process writing
+    // the same entry never leaves a truncated chain that loads as valid. A read-only directory just
+    // means the chain is built again next time
+    std::string temp = cache + ".tmp";
+    if (writeKtx(temp, chain))
+        rename(temp.c_str(), cache.c_str());
+    else
+        remove(temp.c_str());
+    return true;
+}
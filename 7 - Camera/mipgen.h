@@ -0,0 +1,49 @@
+#ifndef MIPGEN_H
+#define MIPGEN_H
+
+#include "ktx.h"
+#include <string>
+#include <vector>
+
+enum MipFilter
+{
+    MIP_BOX,        // 2x2 average
+    MIP_KAISER      // 8-tap Kaiser-windowed sinc, keeps more detail with less aliasing than the box
+};
+
+enum MipPath
+{
+    MIP_SCALAR,     // the reference the SIMD paths are checked against
+    MIP_SSE2,
+    MIP_AVX2,
+    MIP_BEST        // the widest path the CPU supports
+};
+
+struct MipOptions
+{
+    MipFilter filter;
+    bool srgb;              // the colour is sRGB encoded, filter it in linear space. Alpha is always linear
+    bool preserveCoverage;  // rescale each level's alpha so as many texels pass alphaRef as in level 0
+    float alphaRef;         // the alpha test threshold of cutouts, 0-1
+    MipPath path;
+
+    MipOptions();
+};
+
+// Builds the whole RGBA8 mip chain of a tightly packed RGBA8 image on the CPU, level 0 is a copy of it.
+// Filtering runs on 16-bit linear values, so colours don't darken level by level the way averaging sRGB
+// bytes (or a driver's glGenerateMipmap on GL_RGBA8) does, and thin cutouts don't fade away with
+// preserveCoverage. Every path gives the same result bit for bit
+void buildMipChain(const unsigned char* rgba, int width, int height, const MipOptions &options, KtxTexture &chain);
+
+// tightly packed RGBA8 pixels of an image file
+bool loadImageRgba(const std::string &path, std::vector<unsigned char> &rgba, int &width, int &height);
+// the chain of an image file, read from its cache file when that is newer than the image, built and
+// written to the cache otherwise. cached says which of the two happened
+bool loadMipChain(const std::string &path, const MipOptions &options, KtxTexture &chain, bool* cached = NULL);
+// the cache file sits next to the image and names the options, e.g. awesomeface.box.srgb.coverage128.mips.ktx
+std::string mipCachePath(const std::string &path, const MipOptions &options);
+
+bool mipPathSupported(MipPath path);
+
+#endif
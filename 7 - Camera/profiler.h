@@ -0,0 +1,89 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// CPU and GPU timing of named scopes. Every scope records CPU timestamps and a pair of GL timestamp
+// queries. Query results are read FRAME_LATENCY frames later, and only if they are already available,
+// so the profiler never stalls the pipeline waiting for the GPU.
+class Profiler
+{
+public:
+    // frames of query objects kept in flight before their results are read
+    static const int FRAME_LATENCY = 4;
+
+    // a finished scope, times are in microseconds on the CPU clock
+    struct Event
+    {
+        const char* name;
+        int depth;
+        double cpuStart, cpuDuration;
+        double gpuStart, gpuDuration;   // gpuDuration < 0 when the results were not available in time
+    };
+
+    Profiler();
+    // create the queries and calibrate the GPU clock against the CPU clock, needs a current context
+    void init();
+    // delete the queries, call before the context is destroyed
+    void release();
+
+    void beginFrame();
+    void endFrame();
+    // wait for the GPU and collect every frame still in flight, e.g. before exporting on exit
+    void flush();
+    // open a scope, names must outlive the profiler (string literals)
+    void begin(const char* name);
+    void end();
+
+    // average CPU/GPU milliseconds per scope over the last second of frames, e.g. for a window title
+    std::string summary() const;
+    // write every recorded event as a Chrome trace_event JSON file (chrome://tracing, Perfetto)
+    bool exportChromeTrace(const char* path) const;
+
+private:
+    struct Scope
+    {
+        const char* name;
+        int depth;
+        Uint64 cpuStart, cpuEnd;
+        GLuint queries[2];
+    };
+    struct Frame
+    {
+        std::vector<Scope> scopes;
+        std::vector<GLuint> queryPool;
+        size_t queriesUsed;
+        GLuint lastQuery;           // the timestamp issued last, scopes end in any order
+        bool pending;
+    };
+
+    Frame frames[FRAME_LATENCY];
+    int current;
+    std::vector<int> open;          // indices of the scopes not ended yet in the current frame
+    std::vector<Event> events;      // every collected scope, for the trace
+    size_t maxEvents;
+    double cpuToMicros;
+    Uint64 cpuOrigin;
+    int64_t gpuOrigin;              // GL_TIMESTAMP (ns) taken at cpuOrigin
+    bool enabled;
+
+    GLuint nextQuery(Frame &frame);
+    void collect(Frame &frame);
+};
+
+// Times the enclosing block
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler &profiler, const char* name) : profiler(profiler) { profiler.begin(name); }
+    ~ProfileScope() { profiler.end(); }
+
+private:
+    Profiler &profiler;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <iostream>
+#include <unordered_map>
+
+// EXT_texture_filter_anisotropic (core as ARB in 4.6 with the same values), not in the bundled glad loader
+#ifndef GL_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#endif
+
+// Everything that describes how a texture is sampled, independent of the texture itself
+struct SamplerDesc
+{
+    GLenum wrapS;
+    GLenum wrapT;
+    GLenum wrapR;
+    GLenum minFilter;
+    GLenum magFilter;
+    GLenum compareMode;     // GL_COMPARE_REF_TO_TEXTURE for shadow maps
+    GLenum compareFunc;
+    float lodBias;
+    // use the scene-wide anisotropy level of the SamplerCache instead of plain trilinear
+    bool anisotropic;
+
+    SamplerDesc(GLenum wrap = GL_REPEAT, GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR, GLenum magFilter = GL_LINEAR, bool anisotropic = true);
+    bool operator==(const SamplerDesc &other) const;
+};
+
+// FNV-1a over the descriptor fields
+struct SamplerDescHash
+{
+    size_t operator()(const SamplerDesc &desc) const;
+};
+
+// Hands out one shared sampler object per distinct SamplerDesc, so textures carry no filtering state
+// of their own and filtering can change without touching any texture. The anisotropy level is a
+// single setting for the whole scene: every anisotropic sampler is updated in place when it changes
+class SamplerCache
+{
+public:
+    SamplerCache();
+    // checks for anisotropic filtering and starts at the highest level, needs a current context
+    void init();
+    // delete every sampler, call before the context is destroyed
+    void release();
+
+    // the sampler object for desc, created on first use
+    GLuint get(const SamplerDesc &desc);
+    // get() and bind it to the texture unit (0, 1, ...) through gGLState
+    void bind(unsigned int unit, const SamplerDesc &desc);
+
+    // clamped to [1, maxAnisotropy()], 1 turns anisotropic filtering off
+    void setAnisotropy(float level);
+    float anisotropy() const { return level; }
+    float maxAnisotropy() const { return maxLevel; }
+    bool anisotropySupported() const { return supported; }
+    size_t size() const { return samplers.size(); }
+    void printStats(std::ostream &out) const;
+
+private:
+    std::unordered_map<SamplerDesc, GLuint, SamplerDescHash> samplers;
+    float level;
+    float maxLevel;
+    bool supported;
+    unsigned long lookups;
+};
+
+#endif
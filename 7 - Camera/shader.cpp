@@ -52,6 +52,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    // cache every active uniform so the setters never have to query GL
+    uniforms.reflect(ID);
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -59,25 +61,101 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 
 void Shader::use() 
 { 
-    glUseProgram(ID);
+    gGLState.useProgram(ID);
+}
+
+bool Shader::bindUniformBlock(const char* name, GLuint binding) const
+{
+    GLuint index = glGetUniformBlockIndex(ID, name);
+    if (index == GL_INVALID_INDEX)
+        return false;
+    glUniformBlockBinding(ID, index, binding);
+    return true;
+}
+
+GLint Shader::uniform(const std::string &name) const
+{
+    return uniforms.location(name);
+}
+
+void Shader::setBool(GLint location, bool value) const
+{
+    glUniform1i(location, (int)value);
+}
+void Shader::setInt(GLint location, int value) const
+{
+    glUniform1i(location, value);
+}
+void Shader::setFloat(GLint location, float value) const
+{
+    glUniform1f(location, value);
+}
+void Shader::setMat4(GLint location, const glm::mat4 &value) const
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+void Shader::setVec4Array(GLint location, const glm::vec4* values, GLsizei count) const
+{
+    glUniform4fv(location, count, glm::value_ptr(values[0]));
+}
+void Shader::setFloatArray(GLint location, const float* values, GLsizei count) const
+{
+    glUniform1fv(location, count, values);
+}
+
+bool Shader::require(std::initializer_list<UniformId> ids) const
+{
+    return uniforms.check(ids.begin(), ids.size(), ID);
+}
+
+void Shader::setBool(UniformId id, bool value) const
+{
+    setBool(uniforms.location(id), value);
+}
+void Shader::setInt(UniformId id, int value) const
+{
+    setInt(uniforms.location(id), value);
+}
+void Shader::setFloat(UniformId id, float value) const
+{
+    setFloat(uniforms.location(id), value);
+}
+void Shader::setMat4(UniformId id, const glm::mat4 &value) const
+{
+    setMat4(uniforms.location(id), value);
+}
+void Shader::setVec4Array(UniformId id, const glm::vec4* values, GLsizei count) const
+{
+    setVec4Array(uniforms.location(id), values, count);
+}
+void Shader::setFloatArray(UniformId id, const float* values, GLsizei count) const
+{
+    setFloatArray(uniforms.location(id), values, count);
 }
 
 void Shader::setBool(const std::string &name, bool value) const
-{         
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+{ 
+    setBool(uniforms.location(name), value); 
 }
 void Shader::setInt(const std::string &name, int value) const
 { 
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    setInt(uniforms.location(name), value); 
 }
 void Shader::setFloat(const std::string &name, float value) const
 { 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    setFloat(uniforms.location(name), value); 
 }
-
 void Shader::setMat4(const std::string &name, glm::mat4 value) const
 { 
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value)); 
+    setMat4(uniforms.location(name), value); 
+}
+void Shader::setVec4Array(const std::string &name, const glm::vec4* values, GLsizei count) const
+{ 
+    setVec4Array(uniforms.location(name), values, count); 
+}
+void Shader::setFloatArray(const std::string &name, const float* values, GLsizei count) const
+{ 
+    setFloatArray(uniforms.location(name), values, count); 
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
@@ -0,0 +1,72 @@
+#include "staging_ring.h"
+#include "glstate.h"
+#include <string.h>
+
+StagingRing::StagingRing(unsigned int count)
+    : buffers(count), next(0)
+{
+}
+
+void StagingRing::init()
+{
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        glGenBuffers(1, &buffers[i].pbo);
+        buffers[i].capacity = 0;
+        buffers[i].fence = 0;
+    }
+}
+
+void StagingRing::release()
+{
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        if (buffers[i].fence)
+            glDeleteSync(buffers[i].fence);
+        gGLState.deleteBuffers(1, &buffers[i].pbo);
+        buffers[i].pbo = 0;
+        buffers[i].fence = 0;
+    }
+}
+
+bool StagingRing::ready()
+{
+    Buffer &buffer = buffers[next];
+    if (buffer.fence)
+    {
+        if (glClientWaitSync(buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(buffer.fence);
+        buffer.fence = 0;
+    }
+    return true;
+}
+
+bool StagingRing::stage(const void* data, GLsizeiptr bytes)
+{
+    Buffer &buffer = buffers[next];
+    gGLState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo);
+    if (buffer.capacity < bytes)
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        buffer.capacity = bytes;
+    }
+    // the fence has signalled, so invalidating lets the driver hand back the same storage without a stall
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!dst)
+    {
+        gGLState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+    memcpy(dst, data, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    return true;
+}
+
+void StagingRing::submit()
+{
+    buffers[next].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // leaving it bound would turn every later client-memory upload into a buffer offset
+    gGLState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    next = (next + 1) % buffers.size();
+}
@@ -0,0 +1,39 @@
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+#include <glad/glad.h>
+#include <vector>
+
+// A few pixel unpack buffers used round-robin for texture uploads. A fence per buffer tells when the
+// driver has finished reading it, so a buffer is only rewritten once it's free and uploads never wait
+// on the GPU: when the next buffer is still busy the caller just tries again next frame
+class StagingRing
+{
+public:
+    StagingRing(unsigned int buffers = 2);
+
+    // needs a current context
+    void init();
+    void release();
+
+    // true when the next buffer can be written without a stall
+    bool ready();
+    // copies bytes into the next buffer and leaves it bound to GL_PIXEL_UNPACK_BUFFER, texture uploads
+    // then take offsets into it. Returns false, with nothing bound, when the buffer can't be mapped
+    bool stage(const void* data, GLsizeiptr bytes);
+    // fences the uploads that read the staged data, unbinds the buffer and moves on to the next one
+    void submit();
+
+private:
+    struct Buffer
+    {
+        GLuint pbo;
+        GLsizeiptr capacity;
+        GLsync fence;           // set by submit(), the buffer is free again once it has signalled
+    };
+
+    std::vector<Buffer> buffers;
+    size_t next;
+};
+
+#endif
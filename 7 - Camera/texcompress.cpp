@@ -0,0 +1,245 @@
+#include "texcompress.h"
+#include <math.h>
+#include <string.h>
+
+size_t blockBytes(BlockFormat format)
+{
+    return format == BLOCK_BC1 ? 8 : 16;
+}
+
+size_t compressedSize(BlockFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+static unsigned short packColor(const float c[3])
+{
+    int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+    r = r < 0 ? 0 : r > 31 ? 31 : r;
+    g = g < 0 ? 0 : g > 63 ? 63 : g;
+    b = b < 0 ? 0 : b > 31 ? 31 : b;
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor(unsigned short c, int out[3])
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// palette of a colour block, entry 3 is transparent black in the 3-colour mode
+static void colorPalette(unsigned short c0, unsigned short c1, bool fourColor, int palette[4][4])
+{
+    unpackColor(c0, palette[0]);
+    unpackColor(c1, palette[1]);
+    palette[0][3] = palette[1][3] = 255;
+    for (int i = 0; i < 3; i++)
+    {
+        if (fourColor)
+        {
+            palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+            palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+        }
+        else
+        {
+            palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+            palette[3][i] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = fourColor ? 255 : 0;
+}
+
+static void writeColorBlock(const unsigned char rgba[64], unsigned char out[8])
+{
+    // principal axis of the colours by power iteration on their covariance
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int p = 0; p < 16; p++)
+        for (int i = 0; i < 3; i++)
+            mean[i] += rgba[p * 4 + i] / 16.0f;
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int p = 0; p < 16; p++)
+    {
+        float r = rgba[p * 4] - mean[0], g = rgba[p * 4 + 1] - mean[1], b = rgba[p * 4 + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iter = 0; iter < 8; iter++)
+    {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = sqrtf(x * x + y * y + z * z);
+        if (length < 1e-6f)
+            break;
+        axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+    }
+
+    // the extreme projections become the endpoints
+    float minDot = 1e30f, maxDot = -1e30f;
+    int minPixel = 0, maxPixel = 0;
+    for (int p = 0; p < 16; p++)
+    {
+        float d = rgba[p * 4] * axis[0] + rgba[p * 4 + 1] * axis[1] + rgba[p * 4 + 2] * axis[2];
+        if (d < minDot) { minDot = d; minPixel = p; }
+        if (d > maxDot) { maxDot = d; maxPixel = p; }
+    }
+    float hi[3], lo[3];
+    for (int i = 0; i < 3; i++)
+    {
+        hi[i] = rgba[maxPixel * 4 + i];
+        lo[i] = rgba[minPixel * 4 + i];
+    }
+    unsigned short c0 = packColor(hi), c1 = packColor(lo);
+    if (c0 < c1)
+    {
+        unsigned short t = c0; c0 = c1; c1 = t;
+    }
+
+    unsigned int indices = 0;
+    if (c0 != c1)
+    {
+        int palette[4][4];
+        colorPalette(c0, c1, true, palette);
+        for (int p = 0; p < 16; p++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int e = 0; e < 4; e++)
+            {
+                int dr = rgba[p * 4] - palette[e][0], dg = rgba[p * 4 + 1] - palette[e][1], db = rgba[p * 4 + 2] - palette[e][2];
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError) { bestError = error; best = e; }
+            }
+            indices |= (unsigned int)best << (p * 2);
+        }
+    }
+    out[0] = c0 & 0xff; out[1] = c0 >> 8;
+    out[2] = c1 & 0xff; out[3] = c1 >> 8;
+    out[4] = indices & 0xff; out[5] = (indices >> 8) & 0xff; out[6] = (indices >> 16) & 0xff; out[7] = indices >> 24;
+}
+
+static void readColorBlock(const unsigned char in[8], bool forceFourColor, unsigned char rgba[64])
+{
+    unsigned short c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+    unsigned int indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((unsigned int)in[7] << 24);
+    int palette[4][4];
+    colorPalette(c0, c1, forceFourColor || c0 > c1, palette);
+    for (int p = 0; p < 16; p++)
+    {
+        const int* c = palette[(indices >> (p * 2)) & 3];
+        for (int i = 0; i < 4; i++)
+            rgba[p * 4 + i] = (unsigned char)c[i];
+    }
+}
+
+void encodeBC1Block(const unsigned char rgba[64], unsigned char out[8])
+{
+    writeColorBlock(rgba, out);
+}
+
+void encodeBC3Block(const unsigned char rgba[64], unsigned char out[16])
+{
+    int a0 = 0, a1 = 255;
+    for (int p = 0; p < 16; p++)
+    {
+        int a = rgba[p * 4 + 3];
+        if (a > a0) a0 = a;
+        if (a < a1) a1 = a;
+    }
+    // a0 > a1 selects the 8-value ramp between the extremes
+    unsigned long long indices = 0;
+    if (a0 != a1)
+    {
+        int ramp[8] = { a0, a1 };
+        for (int i = 1; i < 7; i++)
+            ramp[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        for (int p = 0; p < 16; p++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int e = 0; e < 8; e++)
+            {
+                int error = rgba[p * 4 + 3] - ramp[e];
+                error *= error;
+                if (error < bestError) { bestError = error; best = e; }
+            }
+            indices |= (unsigned long long)best << (p * 3);
+        }
+    }
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (i * 8));
+    writeColorBlock(rgba, out + 8);
+}
+
+void decodeBC1Block(const unsigned char in[8], unsigned char rgba[64])
+{
+    readColorBlock(in, false, rgba);
+}
+
+void decodeBC3Block(const unsigned char in[16], unsigned char rgba[64])
+{
+    readColorBlock(in + 8, true, rgba);
+    int a0 = in[0], a1 = in[1];
+    int ramp[8] = { a0, a1 };
+    if (a0 > a1)
+        for (int i = 1; i < 7; i++)
+            ramp[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    else
+    {
+        for (int i = 1; i < 5; i++)
+            ramp[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        ramp[6] = 0;
+        ramp[7] = 255;
+    }
+    unsigned long long indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= (unsigned long long)in[2 + i] << (i * 8);
+    for (int p = 0; p < 16; p++)
+        rgba[p * 4 + 3] = (unsigned char)ramp[(indices >> (p * 3)) & 7];
+}
+
+void compressImage(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out)
+{
+    unsigned char block[64];
+    size_t bytes = blockBytes(format);
+    for (int by = 0; by < height; by += 4)
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            for (int y = 0; y < 4; y++)
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = bx + x < width ? bx + x : width - 1;
+                    int sy = by + y < height ? by + y : height - 1;
+                    memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+                }
+            if (format == BLOCK_BC1)
+                encodeBC1Block(block, out);
+            else
+                encodeBC3Block(block, out);
+            out += bytes;
+        }
+}
+
+void decompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba)
+{
+    unsigned char block[64];
+    size_t bytes = blockBytes(format);
+    for (int by = 0; by < height; by += 4)
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            if (format == BLOCK_BC1)
+                decodeBC1Block(blocks, block);
+            else
+                decodeBC3Block(blocks, block);
+            blocks += bytes;
+            for (int y = 0; y < 4 && by + y < height; y++)
+                for (int x = 0; x < 4 && bx + x < width; x++)
+                    memcpy(rgba + ((size_t)(by + y) * width + bx + x) * 4, block + (y * 4 + x) * 4, 4);
+        }
+}
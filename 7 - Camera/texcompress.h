@@ -0,0 +1,27 @@
+#ifndef TEXCOMPRESS_H
+#define TEXCOMPRESS_H
+
+#include <cstddef>
+
+// S3TC block formats, both encode 4x4 pixel blocks
+enum BlockFormat
+{
+    BLOCK_BC1,      // 8 bytes per block, opaque RGB
+    BLOCK_BC3       // 16 bytes per block, BC1 colour plus interpolated alpha
+};
+
+size_t blockBytes(BlockFormat format);
+// bytes needed for a w x h image, partial blocks at the edges count as whole ones
+size_t compressedSize(BlockFormat format, int width, int height);
+
+// rgba is 16 pixels in row order; the colour endpoints are fitted along the principal axis of the block
+void encodeBC1Block(const unsigned char rgba[64], unsigned char out[8]);
+void encodeBC3Block(const unsigned char rgba[64], unsigned char out[16]);
+void decodeBC1Block(const unsigned char in[8], unsigned char rgba[64]);
+void decodeBC3Block(const unsigned char in[16], unsigned char rgba[64]);
+
+// whole images in tightly packed RGBA8, edge blocks are padded by repeating the last row/column
+void compressImage(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out);
+void decompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba);
+
+#endif
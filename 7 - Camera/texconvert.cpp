@@ -0,0 +1,165 @@
+// Offline converter: bakes an image and its full mip chain into a BC1 or BC3 compressed .ktx file
+//     texconvert [--bc1|--bc3] input.png output.ktx
+// Without a flag, BC1 is picked for fully opaque images and BC3 otherwise.
+//     texconvert --atlas [--bc1|--bc3] output.ktx input1.png input2.jpg ...
+// packs the inputs into one atlas with a skyline packer and writes its UV table next to it as output.atlas
+// Mips are filtered in linear space with the alpha coverage of cutouts kept, --kaiser picks the sharper
+// filter and --linear treats the colour as linear data (normal maps and the like). Atlases always use the
+// box filter, the Kaiser taps reach past the padding between images
+#include "ktx.h"
+#include "atlas.h"
+#include "mipgen.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// peak signal-to-noise ratio of the decoded top level against the source, in dB
+double psnr(const unsigned char* a, const unsigned char* b, size_t pixels)
+{
+    double error = 0.0;
+    for (size_t i = 0; i < pixels * 4; i++)
+    {
+        double d = (double)a[i] - b[i];
+        error += d * d;
+    }
+    if (error == 0.0)
+        return 99.0;
+    return 10.0 * log10(255.0 * 255.0 * pixels * 4 / error);
+}
+
+// every alpha is 255
+bool isOpaque(const std::vector<unsigned char> &rgba)
+{
+    for (size_t i = 3; i < rgba.size(); i += 4)
+        if (rgba[i] != 255)
+            return false;
+    return true;
+}
+
+// prints why an image couldn't be read
+bool loadRgba(const char* path, std::vector<unsigned char> &pixels, int &width, int &height)
+{
+    if (loadImageRgba(path, pixels, width, height))
+        return true;
+    std::cout << "Failed to load " << path << ": " << IMG_GetError() << std::endl;
+    return false;
+}
+
+// compresses the image and up to maxLevels of its mips, 0 for the whole chain
+void bakeChain(const std::vector<unsigned char> &rgba, int w, int h, BlockFormat format, int maxLevels, const MipOptions &options, KtxTexture &texture)
+{
+    KtxTexture mips;
+    buildMipChain(&rgba[0], w, h, options, mips);
+    texture.internalFormat = format == BLOCK_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    for (size_t i = 0; i < mips.levels.size() && (maxLevels == 0 || (int)i < maxLevels); i++)
+    {
+        const KtxLevel &level = mips.levels[i];
+        compressImage(&mips.data[level.offset], level.width, level.height, format,
+                      texture.addLevel(level.width, level.height, compressedSize(format, level.width, level.height)));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int forced = -1;
+    bool atlas = false;
+    MipOptions options;
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bc1") == 0)
+            forced = BLOCK_BC1;
+        else if (strcmp(argv[i], "--bc3") == 0)
+            forced = BLOCK_BC3;
+        else if (strcmp(argv[i], "--atlas") == 0)
+            atlas = true;
+        else if (strcmp(argv[i], "--kaiser") == 0)
+            options.filter = MIP_KAISER;
+        else if (strcmp(argv[i], "--linear") == 0)
+            options.srgb = false;
+        else
+            paths.push_back(argv[i]);
+    }
+    if (atlas ? paths.size() < 2 : paths.size() != 2)
+    {
+        std::cout << "usage: texconvert [--bc1|--bc3] [--kaiser] [--linear] input output.ktx" << std::endl;
+        std::cout << "       texconvert --atlas [--bc1|--bc3] [--linear] output.ktx input..." << std::endl;
+        return 1;
+    }
+    const char* output = atlas ? paths[0] : paths[1];
+
+    int width, height;
+    std::vector<unsigned char> level;
+    AtlasBuilder builder;
+    // decided on the sources, the empty space around packed images is transparent but never sampled
+    bool opaque = true;
+    if (atlas)
+    {
+        for (size_t i = 1; i < paths.size(); i++)
+        {
+            int w, h;
+            if (!loadRgba(paths[i], level, w, h))
+                return 1;
+            opaque = opaque && isOpaque(level);
+            builder.add(paths[i], &level[0], w, h);
+        }
+        if (!builder.build())
+        {
+            std::cout << "The images don't fit into a 4096x4096 atlas" << std::endl;
+            return 1;
+        }
+        options.filter = MIP_BOX;
+        width = builder.width();
+        height = builder.height();
+        level = builder.pixels();
+    }
+    else
+    {
+        if (!loadRgba(paths[0], level, width, height))
+            return 1;
+        opaque = isOpaque(level);
+    }
+
+    BlockFormat format = forced >= 0 ? (BlockFormat)forced : opaque ? BLOCK_BC1 : BLOCK_BC3;
+    // BC1 keeps no alpha, so the atlas's empty space decodes opaque, fill it that way for the PSNR
+    if (atlas && format == BLOCK_BC1)
+        for (size_t i = 3; i < level.size(); i += 4)
+            level[i] = 255;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    KtxTexture texture;
+    // an atlas stops at the mip where the padding between its images runs out
+    bakeChain(level, width, height, format, atlas ? builder.maxMipLevels() : 0, options, texture);
+    double encodeMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    if (!writeKtx(output, texture))
+    {
+        std::cout << "Failed to write " << output << std::endl;
+        return 1;
+    }
+    if (atlas)
+    {
+        std::string table = output;
+        table = table.substr(0, table.rfind('.')) + ".atlas";
+        if (!writeAtlasTable(table, builder.entries()))
+        {
+            std::cout << "Failed to write " << table << std::endl;
+            return 1;
+        }
+        std::cout << builder.entries().size() << " images packed into " << width << "x" << height << ", "
+                  << builder.occupancy() * 100.0 << "% used, table in " << table << std::endl;
+    }
+
+    std::vector<unsigned char> decoded((size_t)width * height * 4);
+    decompressImage(&texture.data[0], width, height, format, &decoded[0]);
+    size_t uncompressed = rgba8ChainBytes(width, height);
+    std::cout << (atlas ? "atlas" : paths[0]) << " " << width << "x" << height << " -> " << output << " "
+              << (format == BLOCK_BC1 ? "BC1" : "BC3") << ", " << texture.levels.size() << " levels" << std::endl;
+    std::cout << "  " << uncompressed / 1024 << " KB as RGBA8 -> " << texture.data.size() / 1024 << " KB ("
+              << (double)uncompressed / texture.data.size() << "x smaller), encoded in " << encodeMs << " ms, PSNR "
+              << psnr(&level[0], &decoded[0], (size_t)width * height) << " dB" << std::endl;
+    return 0;
+}
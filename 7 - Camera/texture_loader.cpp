@@ -0,0 +1,380 @@
+#include "texture_loader.h"
+#include "glstate.h"
+#include <SDL2/SDL_image.h>
+
+// magenta and black checker shown until the real image arrives
+static const unsigned char placeholder[] = {
+    255, 0, 255, 255,   0, 0, 0, 255,
+    0, 0, 0, 255,       255, 0, 255, 255
+};
+
+// array layers share one internal format, so channel remapping has to happen on the CPU
+static bool identitySwizzle(const SurfaceFormat &format)
+{
+    return format.swizzle[0] == GL_RED && format.swizzle[1] == GL_GREEN && format.swizzle[2] == GL_BLUE && format.swizzle[3] == GL_ALPHA;
+}
+
+static void setArrayPlaceholder()
+{
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 2, 2, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+}
+
+static double elapsedMs(Uint64 since)
+{
+    return (SDL_GetPerformanceCounter() - since) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+TextureLoaderStats::TextureLoaderStats()
+    : requested(0), uploaded(0), failed(0), bytesUploaded(0), bytesResident(0), bytesUncompressed(0), compressed(0), decodeMs(0.0), uploadMs(0.0), residentMs(0.0), residentFrames(0)
+{
+}
+
+void TextureLoaderStats::print(std::ostream &out) const
+{
+    out << "Textures: " << requested << " requested, " << uploaded << " uploaded, " << failed << " failed, "
+        << bytesUploaded / 1024 << " KB staged" << std::endl;
+    out << "Texture memory: " << bytesResident / 1024 << " KB for " << bytesUncompressed / 1024 << " KB of RGBA8 mip chains, "
+        << compressed << " textures block compressed" << std::endl;
+    out << "Texture loading (ms): decode " << decodeMs << " on workers, upload " << uploadMs << " on GL thread, all resident after "
+        << residentMs << " (" << residentFrames << " frames)" << std::endl;
+}
+
+TextureLoader::TextureLoader(ThreadPool &pool, double budgetMs, unsigned int stagingBuffers)
+    : cpuMipmaps(false), pool(pool), budgetMs(budgetMs), s3tc(false), staging(stagingBuffers), firstRequest(0), frames(0)
+{
+}
+
+void TextureLoader::init()
+{
+    s3tc = s3tcSupported();
+    staging.init();
+}
+
+void TextureLoader::release()
+{
+    pool.wait();
+    for (size_t i = 0; i < ready.size(); i++)
+        SDL_FreeSurface(ready[i].surface);
+    ready.clear();
+    staging.release();
+}
+
+GLuint TextureLoader::load(const std::string &path)
+{
+    if (loaderStats.requested == 0)
+        firstRequest = SDL_GetPerformanceCounter();
+    loaderStats.requested++;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gGLState.bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    // a single level, so the placeholder stays complete under mipmapped sampler filtering
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    pool.submit([this, texture, path] { decode(texture, path, -1, 0); });
+    return texture;
+}
+
+GLuint TextureLoader::loadArray(const std::vector<std::string> &paths)
+{
+    if (loaderStats.requested == 0)
+        firstRequest = SDL_GetPerformanceCounter();
+    loaderStats.requested++;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+    // a single placeholder layer, shaders clamp every layer index to it until the real storage exists
+    setArrayPlaceholder();
+
+    ArrayTexture array;
+    array.texture = texture;
+    array.layers = (unsigned int)paths.size();
+    array.arrived = 0;
+    array.width = array.height = 0;
+    array.internalFormat = 0;
+    array.levels = 0;
+    array.bytesResident = array.bytesUncompressed = 0;
+    array.failed = paths.empty();
+    int index = (int)arrays.size();
+    arrays.push_back(array);
+    if (paths.empty())
+        loaderStats.failed++;
+
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        std::string path = paths[i];
+        unsigned int layer = (unsigned int)i;
+        pool.submit([this, texture, path, index, layer] { decode(texture, path, index, layer); });
+    }
+    return texture;
+}
+
+bool TextureLoader::busy() const
+{
+    return loaderStats.uploaded + loaderStats.failed < loaderStats.requested;
+}
+
+void TextureLoader::decode(GLuint texture, const std::string &path, int array, unsigned int layer)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    Decoded image;
+    image.texture = texture;
+    image.path = path;
+    image.surface = NULL;
+    image.array = array;
+    image.layer = layer;
+    bool ktx = path.size() > 4 && path.compare(path.size() - 4, 4, ".ktx") == 0;
+    if (ktx || cpuMipmaps)
+    {
+        // without S3TC the blocks are decoded here so the GL thread still does a single plain upload
+        if (ktx ? !readKtx(path, image.ktx) || (image.ktx.compressed() && !s3tc && !decompressKtx(image.ktx))
+                : !loadMipChain(path, mipOptions, image.ktx))
+            image.ktx = KtxTexture();
+        image.decodeMs = elapsedMs(start);
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(std::move(image));
+        return;
+    }
+    image.surface = IMG_Load(path.c_str());
+    if (image.surface)
+    {
+        // most formats are handed to GL as they are, only the ones it can't read are converted here
+        GLint alignment, rowLength;
+        if (!surfaceFormat(image.surface, image.format) ||
+            !unpackPitch(image.surface->w, image.format.bytesPerPixel, image.surface->pitch, alignment, rowLength) ||
+            (array >= 0 && !identitySwizzle(image.format)))
+        {
+            // the RGBA32 copy always has a direct GL format
+            SDL_Surface* converted = convertForUpload(image.surface);
+            SDL_FreeSurface(image.surface);
+            image.surface = converted;
+            if (converted)
+                surfaceFormat(converted, image.format);
+        }
+    }
+    image.decodeMs = elapsedMs(start);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.push_back(std::move(image));
+}
+
+void TextureLoader::update()
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    bool wasBusy = busy();
+    frames++;
+
+    unsigned int uploads = 0;
+    for (;;)
+    {
+        // workers only append, so the front element stays put while it's used without the lock
+        Decoded* image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready.empty())
+                break;
+            image = &ready.front();
+        }
+        if (image->surface || !image->ktx.levels.empty())
+        {
+            if (uploads > 0 && elapsedMs(start) >= budgetMs)
+                break;
+            // the next staging buffer may still be read by an earlier upload, try again next frame
+            if (!staging.ready())
+                break;
+            upload(*image);
+            uploads++;
+        }
+        else
+        {
+            std::cout << "Failed to load texture " << image->path << std::endl;
+            if (image->array >= 0)
+                finishLayer(*image, false);
+            else
+                loaderStats.failed++;
+        }
+        loaderStats.decodeMs += image->decodeMs;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.pop_front();
+        }
+    }
+
+    loaderStats.uploadMs += elapsedMs(start);
+    if (wasBusy && !busy())
+    {
+        loaderStats.residentMs = elapsedMs(firstRequest);
+        loaderStats.residentFrames = frames;
+    }
+}
+
+void TextureLoader::upload(const Decoded &image)
+{
+    SDL_Surface* surface = image.surface;
+    const KtxTexture &ktx = image.ktx;
+    GLsizeiptr bytes = surface ? (GLsizeiptr)surface->pitch * surface->h : (GLsizeiptr)ktx.data.size();
+    bool layer = image.array >= 0;
+    // the array storage is allocated from client memory, before the staging buffer gets bound
+    if (layer && !prepareLayer(image))
+    {
+        finishLayer(image, false);
+        SDL_FreeSurface(surface);
+        return;
+    }
+
+    // rows are copied with their padding, the unpack row length skips it on the GL side
+    bool staged = staging.stage(surface ? surface->pixels : (void*)&ktx.data[0], bytes);
+    if (staged)
+    {
+        // with a pixel unpack buffer bound the data pointer is an offset into it
+        if (layer)
+            uploadLayer(image);
+        else if (surface)
+        {
+            const SurfaceFormat &format = image.format;
+            gGLState.bindTexture(0, GL_TEXTURE_2D, image.texture);
+            setUnpackPitch(surface->w, format.bytesPerPixel, surface->pitch);
+            glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, surface->w, surface->h, 0, format.format, format.type, (void*)0);
+            resetUnpack();
+            applySwizzle(GL_TEXTURE_2D, format);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            loaderStats.bytesResident += rgba8ChainBytes(surface->w, surface->h);
+        }
+        else
+        {
+            gGLState.bindTexture(0, GL_TEXTURE_2D, image.texture);
+            for (size_t i = 0; i < ktx.levels.size(); i++)
+            {
+                const KtxLevel &level = ktx.levels[i];
+                if (ktx.compressed())
+                    glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, ktx.internalFormat, level.width, level.height, 0, (GLsizei)level.size, (void*)level.offset);
+                else
+                    glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)level.offset);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)ktx.levels.size() - 1);
+            loaderStats.bytesResident += bytes;
+            if (ktx.compressed())
+                loaderStats.compressed++;
+        }
+        staging.submit();
+        loaderStats.bytesUploaded += bytes;
+        if (!layer)
+        {
+            loaderStats.bytesUncompressed += surface ? rgba8ChainBytes(surface->w, surface->h) : rgba8ChainBytes(ktx.width(), ktx.height());
+            loaderStats.uploaded++;
+        }
+    }
+    else
+    {
+        std::cout << "Failed to map staging buffer for " << image.path << std::endl;
+        if (!layer)
+            loaderStats.failed++;
+    }
+    if (layer)
+        finishLayer(image, staged);
+    SDL_FreeSurface(surface);
+}
+
+bool TextureLoader::prepareLayer(const Decoded &image)
+{
+    ArrayTexture &array = arrays[image.array];
+    if (array.failed)
+        return false;
+    const KtxTexture &ktx = image.ktx;
+    int width = image.surface ? image.surface->w : ktx.width();
+    int height = image.surface ? image.surface->h : ktx.height();
+    // surfaces are converted to RGBA8 by GL as their layer is uploaded, .ktx layers keep their own format
+    GLenum internalFormat = image.surface ? GL_RGBA8 : ktx.internalFormat;
+    size_t levels = image.surface ? 0 : ktx.levels.size();
+
+    gGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.texture);
+    if (array.width == 0)
+    {
+        // the first layer to arrive decides the size and format of the whole array
+        array.width = width;
+        array.height = height;
+        array.internalFormat = internalFormat;
+        array.levels = levels;
+        if (levels == 0)
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, array.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        for (size_t i = 0; i < levels; i++)
+        {
+            const KtxLevel &level = ktx.levels[i];
+            if (ktx.compressed())
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, internalFormat, level.width, level.height, array.layers, 0, (GLsizei)(level.size * array.layers), NULL);
+            else
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, GL_RGBA8, level.width, level.height, array.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels > 0 ? (GLint)levels - 1 : 0);
+        return true;
+    }
+    if (width != array.width || height != array.height || internalFormat != array.internalFormat || levels != array.levels)
+    {
+        std::cout << image.path << " doesn't match the size or format of the other layers in its texture array" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void TextureLoader::uploadLayer(const Decoded &image)
+{
+    SDL_Surface* surface = image.surface;
+    const KtxTexture &ktx = image.ktx;
+    ArrayTexture &array = arrays[image.array];
+    gGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.texture);
+    array.bytesUncompressed += rgba8ChainBytes(array.width, array.height);
+    if (surface)
+    {
+        const SurfaceFormat &format = image.format;
+        setUnpackPitch(surface->w, format.bytesPerPixel, surface->pitch);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, image.layer, surface->w, surface->h, 1, format.format, format.type, (void*)0);
+        resetUnpack();
+        array.bytesResident += rgba8ChainBytes(surface->w, surface->h);
+        return;
+    }
+    for (size_t i = 0; i < ktx.levels.size(); i++)
+    {
+        const KtxLevel &level = ktx.levels[i];
+        if (ktx.compressed())
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, image.layer, level.width, level.height, 1, ktx.internalFormat, (GLsizei)level.size, (void*)level.offset);
+        else
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, image.layer, level.width, level.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, (void*)level.offset);
+    }
+    array.bytesResident += ktx.data.size();
+}
+
+void TextureLoader::finishLayer(const Decoded &image, bool ok)
+{
+    ArrayTexture &array = arrays[image.array];
+    if (!ok && !array.failed)
+    {
+        // back to the placeholder rather than showing a partly filled array
+        array.failed = true;
+        gGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.texture);
+        setArrayPlaceholder();
+    }
+    if (++array.arrived < array.layers)
+        return;
+
+    if (array.failed)
+    {
+        loaderStats.failed++;
+        return;
+    }
+    gGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.texture);
+    if (array.levels == 0)
+    {
+        // one pass over all layers once the last one is in
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 1000);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    else if (array.internalFormat != GL_RGBA8)
+        loaderStats.compressed++;
+    loaderStats.bytesResident += array.bytesResident;
+    loaderStats.bytesUncompressed += array.bytesUncompressed;
+    loaderStats.uploaded++;
+}
@@ -0,0 +1,117 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include "thread_pool.h"
+#include "ktx.h"
+#include "mipgen.h"
+#include "staging_ring.h"
+#include "texture_upload.h"
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TextureLoaderStats
+{
+    unsigned int requested;
+    unsigned int uploaded;
+    unsigned int failed;
+    size_t bytesUploaded;
+    size_t bytesResident;       // texture memory including mip levels
+    size_t bytesUncompressed;   // what the same textures would take as RGBA8 with mips
+    unsigned int compressed;    // textures kept block compressed on the GPU
+    double decodeMs;            // summed over all workers
+    double uploadMs;            // time spent on the GL thread in update()
+    double residentMs;          // from the first load() until the last texture was uploaded
+    unsigned long residentFrames;
+
+    TextureLoaderStats();
+    void print(std::ostream &out) const;
+};
+
+// Decodes images on a ThreadPool and finishes the uploads on the GL thread. load() returns a texture
+// name straight away that shows a placeholder until update() has replaced its contents, so startup
+// doesn't wait for any image. Decoded pixels go through a StagingRing of pixel unpack buffers that are
+// reused for every upload.
+// .ktx files from texconvert are uploaded with their precomputed mips through glCompressedTexImage2D,
+// or decoded to RGBA8 on the worker when the driver has no S3TC support.
+// With cpuMipmaps, images get their mip chain from mipgen.h on the worker as well (read from its cache
+// file when there is one) instead of a glGenerateMipmap on the GL thread.
+// loadArray() streams same-size images into the layers of one GL_TEXTURE_2D_ARRAY the same way, so
+// objects with different textures can be drawn with a single bind (see atlas.h for the layer table)
+class TextureLoader
+{
+public:
+    // budgetMs caps the GL thread time update() spends per frame, at least one upload is always made
+    TextureLoader(ThreadPool &pool, double budgetMs = 2.0, unsigned int stagingBuffers = 2);
+
+    // create the staging buffers and check for S3TC support, needs a current context
+    void init();
+    // wait for outstanding decodes and free the staging buffers, call before the context is destroyed
+    void release();
+
+    // queue path for decoding and return its texture, bound to unit 0 so parameters can be set right away
+    GLuint load(const std::string &path);
+    // queue every path as one layer of a texture array, bound to unit 0 as GL_TEXTURE_2D_ARRAY.
+    // All layers must have the same size and, for .ktx files, the same format, otherwise the array
+    // fails and keeps showing the placeholder
+    GLuint loadArray(const std::vector<std::string> &paths);
+    // upload decoded images until the frame budget is used up, call once per frame on the GL thread
+    void update();
+    // true while some requested texture still shows the placeholder
+    bool busy() const;
+    const TextureLoaderStats& stats() const { return loaderStats; }
+
+    // set before the first load(), the workers read them
+    bool cpuMipmaps;
+    MipOptions mipOptions;
+
+private:
+    struct Decoded
+    {
+        GLuint texture;
+        std::string path;
+        SDL_Surface* surface;   // image in a format GL reads directly, mips are generated after the upload
+        SurfaceFormat format;   // how to describe surface to GL
+        KtxTexture ktx;         // full mip chain read from a .ktx file, used when surface is NULL
+        double decodeMs;
+        int array;              // index into arrays for a layer of loadArray(), -1 otherwise
+        unsigned int layer;
+    };
+    // a loadArray() texture, only touched on the GL thread
+    struct ArrayTexture
+    {
+        GLuint texture;
+        unsigned int layers;
+        unsigned int arrived;   // layers uploaded or dropped so far
+        int width, height;      // 0 until the first layer has allocated the storage
+        GLenum internalFormat;
+        size_t levels;          // mip levels coming with the layers, 0 when they are generated
+        size_t bytesResident;   // added to the stats once every layer is in
+        size_t bytesUncompressed;
+        bool failed;
+    };
+
+    ThreadPool &pool;
+    double budgetMs;
+    bool s3tc;
+    StagingRing staging;
+    std::mutex mutex;
+    std::deque<Decoded> ready;  // filled by workers, drained by update()
+    std::vector<ArrayTexture> arrays;
+    TextureLoaderStats loaderStats;
+    Uint64 firstRequest;
+    unsigned long frames;
+
+    void decode(GLuint texture, const std::string &path, int array, unsigned int layer);
+    void upload(const Decoded &image);
+    // checks a layer against its array and allocates the array storage for the first one
+    bool prepareLayer(const Decoded &image);
+    void uploadLayer(const Decoded &image);
+    void finishLayer(const Decoded &image, bool ok);
+};
+
+#endif
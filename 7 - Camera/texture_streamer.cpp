@@ -0,0 +1,367 @@
+#include "texture_streamer.h"
+#include "glstate.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// magenta and black checker shown until the mip tail arrives
+static const unsigned char placeholder[] = {
+    255, 0, 255, 255,   0, 0, 0, 255,
+    0, 0, 0, 255,       255, 0, 255, 255
+};
+
+static double elapsedMs(Uint64 since)
+{
+    return (SDL_GetPerformanceCounter() - since) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// respecifying a level with zero size is the only way GL 3.3 has to give a single level's memory back
+static void freeLevel(GLenum target, int level)
+{
+    if (target == GL_TEXTURE_2D_ARRAY)
+        glTexImage3D(target, level, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    else
+        glTexImage2D(target, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+}
+
+StreamingStats::StreamingStats()
+    : textures(0), budgetBytes(0), residentBytes(0), peakResidentBytes(0), wantedBytes(0), levelsStreamed(0), levelsEvicted(0),
+      budgetMisses(0), deferred(0), bytesStreamed(0), uploadMs(0.0), maxUpdateMs(0.0)
+{
+}
+
+void StreamingStats::print(std::ostream &out) const
+{
+    out << "Texture streaming: " << textures << " textures, " << residentBytes / 1024 << " KB resident (peak " << peakResidentBytes / 1024
+        << " KB) of a " << budgetBytes / 1024 << " KB budget, " << wantedBytes / 1024 << " KB wanted" << std::endl;
+    out << "Mip levels: " << levelsStreamed << " streamed (" << bytesStreamed / 1024 << " KB), " << levelsEvicted << " evicted, "
+        << budgetMisses << " held back by the budget, " << deferred << " frames out of upload time" << std::endl;
+    out << "Streaming (ms): " << uploadMs << " on GL thread, worst frame " << maxUpdateMs << std::endl;
+}
+
+TextureStreamer::TextureStreamer(ThreadPool &pool, size_t budgetBytes, double budgetMs, int tailSize)
+    : pool(pool), budgetBytes(budgetBytes), budgetMs(budgetMs), tailSize(tailSize), s3tc(false), frame(1), decoding(0), backlog(false)
+{
+    streamingStats.budgetBytes = budgetBytes;
+}
+
+void TextureStreamer::init()
+{
+    s3tc = s3tcSupported();
+    staging.init();
+}
+
+void TextureStreamer::release()
+{
+    pool.wait();
+    ready.clear();
+    staging.release();
+    for (size_t i = 0; i < textures.size(); i++)
+        gGLState.deleteTextures(1, &textures[i].texture);
+    textures.clear();
+    byName.clear();
+}
+
+GLuint TextureStreamer::load(const std::string &path)
+{
+    return create(GL_TEXTURE_2D, std::vector<std::string>(1, path));
+}
+
+GLuint TextureStreamer::loadArray(const std::vector<std::string> &paths)
+{
+    return create(GL_TEXTURE_2D_ARRAY, paths);
+}
+
+GLuint TextureStreamer::create(GLenum target, const std::vector<std::string> &paths)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gGLState.bindTexture(0, target, texture);
+    if (target == GL_TEXTURE_2D_ARRAY)
+        glTexImage3D(target, 0, GL_RGBA8, 2, 2, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    else
+        glTexImage2D(target, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+
+    Streamed t;
+    t.texture = texture;
+    t.target = target;
+    t.layers = (GLsizei)paths.size();
+    t.loaded = false;
+    t.failed = paths.empty();
+    t.tail = t.resident = t.wanted = 0;
+    t.pixels = 0.0f;
+    t.lastUsed = 0;
+    size_t index = textures.size();
+    textures.push_back(t);
+    byName[texture] = index;
+    streamingStats.textures++;
+
+    if (!paths.empty())
+    {
+        decoding++;
+        pool.submit([this, index, paths] { decode(index, paths); });
+    }
+    return texture;
+}
+
+void TextureStreamer::decode(size_t index, const std::vector<std::string> &paths)
+{
+    Decoded result;
+    result.index = index;
+    KtxTexture &chain = result.chain;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        const std::string &path = paths[i];
+        KtxTexture layer;
+        bool ok;
+        if (path.size() > 4 && path.compare(path.size() - 4, 4, ".ktx") == 0)
+            ok = readKtx(path, layer) && (!layer.compressed() || s3tc || decompressKtx(layer));
+        else
+            ok = loadMipChain(path, mipOptions, layer);
+        if (ok && i == 0)
+        {
+            chain.internalFormat = layer.internalFormat;
+            chain.format = layer.format;
+            chain.type = layer.type;
+            for (size_t l = 0; l < layer.levels.size(); l++)
+                chain.addLevel(layer.levels[l].width, layer.levels[l].height, layer.levels[l].size * paths.size());
+        }
+        // every layer has to fit the storage the first one laid out
+        ok = ok && layer.internalFormat == chain.internalFormat && layer.levels.size() == chain.levels.size() &&
+             layer.width() == chain.width() && layer.height() == chain.height();
+        if (!ok)
+        {
+            chain = KtxTexture();
+            result.failed = path;
+            break;
+        }
+        for (size_t l = 0; l < layer.levels.size(); l++)
+            memcpy(&chain.data[chain.levels[l].offset + i * layer.levels[l].size], &layer.data[layer.levels[l].offset], layer.levels[l].size);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.push_back(std::move(result));
+}
+
+void TextureStreamer::request(GLuint texture, float pixels)
+{
+    std::unordered_map<GLuint, size_t>::iterator found = byName.find(texture);
+    if (found == byName.end())
+        return;
+    Streamed &t = textures[found->second];
+    if (t.lastUsed != frame)
+    {
+        t.lastUsed = frame;
+        t.pixels = 0.0f;
+    }
+    t.pixels = std::max(t.pixels, pixels);
+}
+
+void TextureStreamer::setBudget(size_t bytes)
+{
+    budgetBytes = bytes;
+    streamingStats.budgetBytes = bytes;
+}
+
+int TextureStreamer::residentLevel(GLuint texture) const
+{
+    std::unordered_map<GLuint, size_t>::const_iterator found = byName.find(texture);
+    if (found == byName.end())
+        return -1;
+    const Streamed &t = textures[found->second];
+    return t.loaded && t.resident < (int)t.chain.levels.size() ? t.resident : -1;
+}
+
+void TextureStreamer::update()
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!ready.empty())
+        {
+            Decoded &decoded = ready.front();
+            Streamed &t = textures[decoded.index];
+            decoding--;
+            if (decoded.chain.levels.empty())
+            {
+                std::cout << "Failed to stream texture " << decoded.failed << std::endl;
+                t.failed = true;
+            }
+            else
+            {
+                t.chain = std::move(decoded.chain);
+                t.loaded = true;
+                int levels = (int)t.chain.levels.size();
+                t.tail = levels - 1;
+                while (t.tail > 0 && std::max(t.chain.levels[t.tail - 1].width, t.chain.levels[t.tail - 1].height) <= tailSize)
+                    t.tail--;
+                t.resident = levels;
+                t.wanted = t.tail;
+            }
+            ready.pop_front();
+        }
+    }
+
+    // the level whose texels come closest to one per pixel, textures not drawn this frame keep their last choice
+    streamingStats.wantedBytes = 0;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        Streamed &t = textures[i];
+        if (!t.loaded || t.failed)
+            continue;
+        if (t.lastUsed == frame && t.pixels > 0.0f)
+        {
+            int level = (int)floorf(log2f((float)t.chain.width() / t.pixels));
+            t.wanted = std::min(std::max(level, 0), t.tail);
+        }
+        const KtxLevel &wanted = t.chain.levels[t.wanted];
+        streamingStats.wantedBytes += t.chain.data.size() - wanted.offset;
+    }
+
+    // a lowered budget is met by dropping the least recently used levels first
+    while (streamingStats.residentBytes > budgetBytes && evictOlderThan(frame + 1))
+        ;
+
+    // tails first, then the textures drawn this frame, the ones furthest from the level they want first.
+    // Textures that weren't drawn keep what they have but get nothing finer
+    std::vector<Streamed*> queue;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        Streamed &t = textures[i];
+        if (t.loaded && !t.failed && (t.resident > t.tail || (t.lastUsed == frame && t.resident > t.wanted)))
+            queue.push_back(&t);
+    }
+    std::sort(queue.begin(), queue.end(), [](const Streamed* a, const Streamed* b) {
+        bool aTail = a->resident > a->tail, bTail = b->resident > b->tail;
+        if (aTail != bTail)
+            return aTail;
+        return a->resident - a->wanted > b->resident - b->wanted;
+    });
+
+    unsigned int uploads = 0;
+    bool outOfTime = false;
+    for (size_t i = 0; i < queue.size() && !outOfTime; i++)
+    {
+        Streamed &t = *queue[i];
+        int target = t.lastUsed == frame ? t.wanted : t.tail;
+        while (t.resident > target)
+        {
+            // at least one upload per frame, and never a wait for a staging buffer the GPU still reads
+            if ((uploads > 0 && elapsedMs(start) >= budgetMs) || !staging.ready())
+            {
+                outOfTime = true;
+                break;
+            }
+            bool ok;
+            if (t.resident > t.tail)
+                ok = upload(t, t.tail, (int)t.chain.levels.size() - 1);
+            else
+            {
+                // a finer level only goes up if textures used less recently can make room for it
+                size_t bytes = t.chain.levels[t.resident - 1].size;
+                while (streamingStats.residentBytes + bytes > budgetBytes && evictOlderThan(t.lastUsed))
+                    ;
+                if (streamingStats.residentBytes + bytes > budgetBytes)
+                {
+                    streamingStats.budgetMisses++;
+                    break;
+                }
+                ok = upload(t, t.resident - 1, t.resident - 1);
+            }
+            if (!ok)
+                break;
+            uploads++;
+        }
+    }
+    if (outOfTime)
+        streamingStats.deferred++;
+    backlog = outOfTime;
+
+    double ms = elapsedMs(start);
+    streamingStats.uploadMs += ms;
+    streamingStats.maxUpdateMs = std::max(streamingStats.maxUpdateMs, ms);
+    frame++;
+}
+
+void TextureStreamer::specify(Streamed &t, int level, const void* data)
+{
+    const KtxTexture &chain = t.chain;
+    const KtxLevel &l = chain.levels[level];
+    if (t.target == GL_TEXTURE_2D_ARRAY)
+    {
+        if (chain.compressed())
+            glCompressedTexImage3D(t.target, level, chain.internalFormat, l.width, l.height, t.layers, 0, (GLsizei)l.size, data);
+        else
+            glTexImage3D(t.target, level, chain.internalFormat, l.width, l.height, t.layers, 0, chain.format, chain.type, data);
+    }
+    else
+    {
+        if (chain.compressed())
+            glCompressedTexImage2D(t.target, level, chain.internalFormat, l.width, l.height, 0, (GLsizei)l.size, data);
+        else
+            glTexImage2D(t.target, level, chain.internalFormat, l.width, l.height, 0, chain.format, chain.type, data);
+    }
+}
+
+bool TextureStreamer::upload(Streamed &t, int first, int last)
+{
+    const KtxTexture &chain = t.chain;
+    size_t begin = chain.levels[first].offset;
+    size_t end = chain.levels[last].offset + chain.levels[last].size;
+    if (!staging.stage(&chain.data[begin], (GLsizeiptr)(end - begin)))
+    {
+        std::cout << "Failed to map staging buffer for texture " << t.texture << std::endl;
+        return false;
+    }
+    // with the staging buffer bound the data pointers are offsets into it
+    gGLState.bindTexture(0, t.target, t.texture);
+    for (int level = first; level <= last; level++)
+        specify(t, level, (void*)(chain.levels[level].offset - begin));
+    staging.submit();
+
+    int levels = (int)chain.levels.size();
+    bool placeholder = t.resident == levels;
+    if (placeholder)
+        glTexParameteri(t.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(t.target, GL_TEXTURE_BASE_LEVEL, first);
+    if (placeholder && first > 0)
+        freeLevel(t.target, 0);
+    t.resident = first;
+
+    streamingStats.levelsStreamed += last - first + 1;
+    streamingStats.bytesStreamed += end - begin;
+    streamingStats.residentBytes += end - begin;
+    streamingStats.peakResidentBytes = std::max(streamingStats.peakResidentBytes, streamingStats.residentBytes);
+    return true;
+}
+
+void TextureStreamer::evict(Streamed &t)
+{
+    int level = t.resident;
+    gGLState.bindTexture(0, t.target, t.texture);
+    glTexParameteri(t.target, GL_TEXTURE_BASE_LEVEL, level + 1);
+    freeLevel(t.target, level);
+    t.resident++;
+    streamingStats.residentBytes -= t.chain.levels[level].size;
+    streamingStats.levelsEvicted++;
+}
+
+bool TextureStreamer::evictOlderThan(unsigned long before)
+{
+    // least recently used first, among equals the texture holding the most levels beyond what it wants
+    Streamed* victim = NULL;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        Streamed &t = textures[i];
+        if (!t.loaded || t.failed || t.resident >= t.tail || t.lastUsed >= before)
+            continue;
+        if (!victim || t.lastUsed < victim->lastUsed ||
+            (t.lastUsed == victim->lastUsed && t.wanted - t.resident > victim->wanted - victim->resident))
+            victim = &t;
+    }
+    if (!victim)
+        return false;
+    evict(*victim);
+    return true;
+}
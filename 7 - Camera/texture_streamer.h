@@ -0,0 +1,122 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include "thread_pool.h"
+#include "ktx.h"
+#include "mipgen.h"
+#include "staging_ring.h"
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct StreamingStats
+{
+    unsigned int textures;
+    size_t budgetBytes;
+    size_t residentBytes;       // mip levels currently on the GPU
+    size_t peakResidentBytes;
+    size_t wantedBytes;         // what the levels asked for by the last frame's requests would take
+    unsigned long levelsStreamed;
+    unsigned long levelsEvicted;
+    unsigned long budgetMisses; // levels left out because the budget was full of more recently used ones
+    unsigned long deferred;     // frames that stopped early on the time budget or a busy staging buffer
+    size_t bytesStreamed;
+    double uploadMs;            // GL thread time in update(), summed
+    double maxUpdateMs;         // the worst single frame
+
+    StreamingStats();
+    void print(std::ostream &out) const;
+};
+
+// Texture residency manager. Every texture has its whole mip chain decoded into system memory on the
+// ThreadPool, but only part of it on the GPU: the mip tail goes up as soon as it's decoded, finer levels
+// follow when request() says the texture covers enough of the screen to need them. When the resident
+// levels exceed the VRAM budget, the finest levels of the least recently used textures are evicted.
+// The texture samples from GL_TEXTURE_BASE_LEVEL, which always points at its finest resident level,
+// and evicted levels are respecified with zero size so the driver releases their memory.
+// Uploads go through a StagingRing under a per-frame time budget, so frames never wait for them.
+class TextureStreamer
+{
+public:
+    // budgetBytes caps resident texture memory, budgetMs the GL thread time per frame. Levels up to tailSize
+    // texels on each side form the tail, which is never evicted and may push the total past the budget
+    TextureStreamer(ThreadPool &pool, size_t budgetBytes, double budgetMs = 1.0, int tailSize = 64);
+
+    // creates the staging buffers, needs a current context
+    void init();
+    // waits for outstanding decodes and deletes every texture, call before the context is destroyed
+    void release();
+
+    // the returned texture is owned by the streamer and shows a placeholder until its tail is in
+    GLuint load(const std::string &path);
+    // same-size images or .ktx files as the layers of one GL_TEXTURE_2D_ARRAY, streamed together
+    GLuint loadArray(const std::vector<std::string> &paths);
+
+    // the texture's level 0 is drawn about pixels wide this frame, call before update() for every use
+    void request(GLuint texture, float pixels);
+    // evicts down to the budget and streams requested levels, once per frame on the GL thread
+    void update();
+
+    // true while images are still decoding or the last update() ran out of time with levels left to stream
+    bool busy() const { return decoding > 0 || backlog; }
+    void setBudget(size_t bytes);
+    // finest level on the GPU, -1 while the texture still shows the placeholder
+    int residentLevel(GLuint texture) const;
+    const StreamingStats& stats() const { return streamingStats; }
+
+    // how the chains of image files are built, set before the first load()
+    MipOptions mipOptions;
+
+private:
+    struct Streamed
+    {
+        GLuint texture;
+        GLenum target;
+        GLsizei layers;
+        KtxTexture chain;       // every level in system memory, a level's layers stored one after another
+        bool loaded;
+        bool failed;
+        int tail;               // first level of the mip tail
+        int resident;           // GL_TEXTURE_BASE_LEVEL, the level count until the tail is in
+        int wanted;
+        float pixels;           // largest request this frame
+        unsigned long lastUsed; // frame of the last request
+    };
+    struct Decoded
+    {
+        size_t index;
+        KtxTexture chain;       // empty when a layer failed
+        std::string failed;     // the path that did
+    };
+
+    ThreadPool &pool;
+    size_t budgetBytes;
+    double budgetMs;
+    int tailSize;
+    bool s3tc;
+    StagingRing staging;
+    std::vector<Streamed> textures;
+    std::unordered_map<GLuint, size_t> byName;
+    std::mutex mutex;
+    std::deque<Decoded> ready;  // filled by workers, drained by update()
+    unsigned long frame;
+    unsigned int decoding;
+    bool backlog;
+    StreamingStats streamingStats;
+
+    GLuint create(GLenum target, const std::vector<std::string> &paths);
+    void decode(size_t index, const std::vector<std::string> &paths);
+    // uploads levels first..last, which sit next to each other in the chain, in one staging buffer
+    bool upload(Streamed &t, int first, int last);
+    void evict(Streamed &t);
+    // evicts one level of the least recently used texture last used before frame, false if there is none
+    bool evictOlderThan(unsigned long frame);
+    void specify(Streamed &t, int level, const void* data);
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "texture_upload.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TEXTURE_UPLOAD_AVX2 1
+#endif
+
+static bool setFormat(SurfaceFormat &out, GLenum internalFormat, GLenum format, GLenum type, int bytesPerPixel)
+{
+    out.internalFormat = internalFormat;
+    out.format = format;
+    out.type = type;
+    out.bytesPerPixel = bytesPerPixel;
+    out.swizzle[0] = GL_RED;
+    out.swizzle[1] = GL_GREEN;
+    out.swizzle[2] = GL_BLUE;
+    out.swizzle[3] = GL_ALPHA;
+    return true;
+}
+
+// SDL_image hands back grayscale images as 8-bit surfaces whose palette entry i is (i, i, i)
+static bool greyPalette(const SDL_Palette* palette)
+{
+    if (!palette)
+        return false;
+    for (int i = 0; i < palette->ncolors; i++)
+    {
+        const SDL_Color &c = palette->colors[i];
+        if (c.r != i || c.g != i || c.b != i || c.a != 255)
+            return false;
+    }
+    return true;
+}
+
+bool surfaceFormat(const SDL_Surface* surface, SurfaceFormat &out)
+{
+    switch (surface->format->format)
+    {
+    case SDL_PIXELFORMAT_INDEX8:
+        if (!greyPalette(surface->format->palette))
+            return false;
+        setFormat(out, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1);
+        out.swizzle[1] = out.swizzle[2] = GL_RED;
+        out.swizzle[3] = GL_ONE;
+        return true;
+    case SDL_PIXELFORMAT_RGB332:      return setFormat(out, GL_R3_G3_B2, GL_RGB, GL_UNSIGNED_BYTE_3_3_2, 1);
+    case SDL_PIXELFORMAT_RGB444:      return setFormat(out, GL_RGB4, GL_BGRA, GL_UNSIGNED_SHORT_4_4_4_4_REV, 2);
+    case SDL_PIXELFORMAT_ARGB4444:    return setFormat(out, GL_RGBA4, GL_BGRA, GL_UNSIGNED_SHORT_4_4_4_4_REV, 2);
+    case SDL_PIXELFORMAT_ABGR4444:    return setFormat(out, GL_RGBA4, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4_REV, 2);
+    case SDL_PIXELFORMAT_RGBA4444:    return setFormat(out, GL_RGBA4, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 2);
+    case SDL_PIXELFORMAT_BGRA4444:    return setFormat(out, GL_RGBA4, GL_BGRA, GL_UNSIGNED_SHORT_4_4_4_4, 2);
+    case SDL_PIXELFORMAT_RGB555:      return setFormat(out, GL_RGB5, GL_BGRA, GL_UNSIGNED_SHORT_1_5_5_5_REV, 2);
+    case SDL_PIXELFORMAT_BGR555:      return setFormat(out, GL_RGB5, GL_RGBA, GL_UNSIGNED_SHORT_1_5_5_5_REV, 2);
+    case SDL_PIXELFORMAT_ARGB1555:    return setFormat(out, GL_RGB5_A1, GL_BGRA, GL_UNSIGNED_SHORT_1_5_5_5_REV, 2);
+    case SDL_PIXELFORMAT_ABGR1555:    return setFormat(out, GL_RGB5_A1, GL_RGBA, GL_UNSIGNED_SHORT_1_5_5_5_REV, 2);
+    case SDL_PIXELFORMAT_RGBA5551:    return setFormat(out, GL_RGB5_A1, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, 2);
+    case SDL_PIXELFORMAT_BGRA5551:    return setFormat(out, GL_RGB5_A1, GL_BGRA, GL_UNSIGNED_SHORT_5_5_5_1, 2);
+    // GL_RGB565 only became a desktop internal format in 4.1, GL_RGB5 lets the driver pick 565
+    case SDL_PIXELFORMAT_RGB565:      return setFormat(out, GL_RGB5, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 2);
+    case SDL_PIXELFORMAT_BGR565:      return setFormat(out, GL_RGB5, GL_RGB, GL_UNSIGNED_SHORT_5_6_5_REV, 2);
+    case SDL_PIXELFORMAT_RGB24:       return setFormat(out, GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, 3);
+    case SDL_PIXELFORMAT_BGR24:       return setFormat(out, GL_RGB8, GL_BGR, GL_UNSIGNED_BYTE, 3);
+    // the X channel of the padded formats is simply dropped by the RGB internal format
+    case SDL_PIXELFORMAT_RGB888:      return setFormat(out, GL_RGB8, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 4);
+    case SDL_PIXELFORMAT_BGR888:      return setFormat(out, GL_RGB8, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, 4);
+    case SDL_PIXELFORMAT_RGBX8888:    return setFormat(out, GL_RGB8, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, 4);
+    case SDL_PIXELFORMAT_BGRX8888:    return setFormat(out, GL_RGB8, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8, 4);
+    case SDL_PIXELFORMAT_ARGB8888:    return setFormat(out, GL_RGBA8, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 4);
+    case SDL_PIXELFORMAT_ABGR8888:    return setFormat(out, GL_RGBA8, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, 4);
+    case SDL_PIXELFORMAT_RGBA8888:    return setFormat(out, GL_RGBA8, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, 4);
+    case SDL_PIXELFORMAT_BGRA8888:    return setFormat(out, GL_RGBA8, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8, 4);
+    case SDL_PIXELFORMAT_ARGB2101010: return setFormat(out, GL_RGB10_A2, GL_BGRA, GL_UNSIGNED_INT_2_10_10_10_REV, 4);
+    default:
+        // 1/4-bit palettes, colour palettes, YUV and anything newer
+        return false;
+    }
+}
+
+bool unpackPitch(int width, int bytesPerPixel, int pitch, GLint &alignment, GLint &rowLength)
+{
+    int row = width * bytesPerPixel;
+    for (alignment = 8; alignment >= 1; alignment /= 2)
+    {
+        if ((row + alignment - 1) / alignment * alignment == pitch)
+        {
+            rowLength = 0;
+            return true;
+        }
+    }
+    if (pitch % bytesPerPixel != 0)
+        return false;
+    alignment = 1;
+    rowLength = pitch / bytesPerPixel;
+    return true;
+}
+
+bool setUnpackPitch(int width, int bytesPerPixel, int pitch)
+{
+    GLint alignment, rowLength;
+    if (!unpackPitch(width, bytesPerPixel, pitch, alignment, rowLength))
+        return false;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+    return true;
+}
+
+void resetUnpack()
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void applySwizzle(GLenum target, const SurfaceFormat &format)
+{
+    if (format.swizzle[0] != GL_RED || format.swizzle[1] != GL_GREEN || format.swizzle[2] != GL_BLUE || format.swizzle[3] != GL_ALPHA)
+        glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, format.swizzle);
+}
+
+static void expandRowScalar(const unsigned char* src, int width, const Uint32* table, Uint32* dst)
+{
+    for (int x = 0; x < width; x++)
+        dst[x] = table[src[x]];
+}
+
+#ifdef TEXTURE_UPLOAD_AVX2
+__attribute__((target("avx2")))
+static void expandRowAVX2(const unsigned char* src, int width, const Uint32* table, Uint32* dst)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + x)));
+        _mm256_storeu_si256((__m256i*)(dst + x), _mm256_i32gather_epi32((const int*)table, index, 4));
+    }
+    expandRowScalar(src + x, width - x, table, dst + x);
+}
+#endif
+
+void expandIndexed(const unsigned char* src, int srcPitch, int width, int height, const SDL_Palette* palette,
+                   unsigned char* dst, int dstPitch, bool simd)
+{
+    // SDL_Color is laid out r, g, b, a, which is exactly one RGBA8 texel; missing entries are opaque black
+    Uint32 table[256];
+    SDL_Color black = { 0, 0, 0, 255 };
+    for (int i = 0; i < 256; i++)
+        memcpy(&table[i], palette && i < palette->ncolors ? &palette->colors[i] : &black, 4);
+
+    void (*expandRow)(const unsigned char*, int, const Uint32*, Uint32*) = expandRowScalar;
+#ifdef TEXTURE_UPLOAD_AVX2
+    if (simd && __builtin_cpu_supports("avx2"))
+        expandRow = expandRowAVX2;
+#endif
+    for (int y = 0; y < height; y++)
+        expandRow(src + (size_t)y * srcPitch, width, table, (Uint32*)(dst + (size_t)y * dstPitch));
+}
+
+SDL_Surface* convertForUpload(SDL_Surface* surface)
+{
+    if (surface->format->format != SDL_PIXELFORMAT_INDEX8)
+        return SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+
+    SDL_Surface* rgba = SDL_CreateRGBSurfaceWithFormat(0, surface->w, surface->h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!rgba)
+        return NULL;
+    expandIndexed((const unsigned char*)surface->pixels, surface->pitch, surface->w, surface->h, surface->format->palette,
+                  (unsigned char*)rgba->pixels, rgba->pitch);
+    return rgba;
+}
+
+bool uploadSurface(GLenum target, SDL_Surface* surface)
+{
+    SurfaceFormat format;
+    SDL_Surface* converted = NULL;
+    if (!surfaceFormat(surface, format))
+    {
+        converted = convertForUpload(surface);
+        if (!converted || !surfaceFormat(converted, format))
+        {
+            SDL_FreeSurface(converted);
+            return false;
+        }
+        surface = converted;
+    }
+
+    if (SDL_MUSTLOCK(surface))
+        SDL_LockSurface(surface);
+    if (setUnpackPitch(surface->w, format.bytesPerPixel, surface->pitch))
+        glTexImage2D(target, 0, format.internalFormat, surface->w, surface->h, 0, format.format, format.type, surface->pixels);
+    else
+    {
+        // a pitch that isn't a whole number of pixels, hand GL one row at a time rather than repacking
+        glTexImage2D(target, 0, format.internalFormat, surface->w, surface->h, 0, format.format, format.type, NULL);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int y = 0; y < surface->h; y++)
+            glTexSubImage2D(target, 0, 0, y, surface->w, 1, format.format, format.type, (const unsigned char*)surface->pixels + (size_t)y * surface->pitch);
+    }
+    resetUnpack();
+    applySwizzle(target, format);
+    if (SDL_MUSTLOCK(surface))
+        SDL_UnlockSurface(surface);
+
+    SDL_FreeSurface(converted);
+    return true;
+}
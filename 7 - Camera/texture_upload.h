@@ -0,0 +1,43 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+
+// How an SDL surface's pixels are described to glTexImage2D so GL can read them as they are
+struct SurfaceFormat
+{
+    GLenum internalFormat;  // always sized, e.g. GL_RGB8 rather than GL_RGB
+    GLenum format;
+    GLenum type;
+    GLint swizzle[4];       // GL_TEXTURE_SWIZZLE_RGBA, identity unless the channels need remapping
+    int bytesPerPixel;
+};
+
+// Maps the surface's SDL pixel format to its GL equivalent. Packed formats use the packed GL types,
+// which match SDL's channel order on either endianness. An 8-bit surface with a grey ramp palette
+// becomes a single-channel GL_R8 texture swizzled to grey. Returns false when GL has no equivalent
+// and the surface has to go through convertForUpload() first
+bool surfaceFormat(const SDL_Surface* surface, SurfaceFormat &format);
+
+// GL_UNPACK_ALIGNMENT and GL_UNPACK_ROW_LENGTH that make GL step pitch bytes between rows,
+// returns false when the pitch can't be expressed that way
+bool unpackPitch(int width, int bytesPerPixel, int pitch, GLint &alignment, GLint &rowLength);
+// sets the two from unpackPitch() on the current context
+bool setUnpackPitch(int width, int bytesPerPixel, int pitch);
+// back to the GL defaults
+void resetUnpack();
+// sets GL_TEXTURE_SWIZZLE_RGBA on the bound texture when the format isn't identity mapped
+void applySwizzle(GLenum target, const SurfaceFormat &format);
+
+// RGBA32 copy of a surface that surfaceFormat() rejects, or NULL on failure. 8-bit palettes are
+// expanded here (AVX2 gathers when the CPU has them), anything else goes through SDL
+SDL_Surface* convertForUpload(SDL_Surface* surface);
+// INDEX8 to RGBA8 through the 256-entry palette table, simd = false forces the scalar loop
+void expandIndexed(const unsigned char* src, int srcPitch, int width, int height, const SDL_Palette* palette,
+                   unsigned char* dst, int dstPitch, bool simd = true);
+
+// Uploads the surface to level 0 of the texture bound to target, converting only when unavoidable
+bool uploadSurface(GLenum target, SDL_Surface* surface);
+
+#endif
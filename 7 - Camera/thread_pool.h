@@ -0,0 +1,37 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads pulling jobs from one shared FIFO queue. Jobs must not touch GL,
+// the context is only current on the main thread
+class ThreadPool
+{
+public:
+    // threads = 0 picks one less than the number of hardware threads, but at least one
+    ThreadPool(unsigned int threads = 0);
+    ~ThreadPool();
+
+    void submit(const std::function<void()> &job);
+    // blocks until the queue is empty and no job is running
+    void wait();
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    unsigned int active;
+    bool stopping;
+
+    void work();
+};
+
+#endif
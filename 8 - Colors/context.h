@@ -0,0 +1,71 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include <EGL/egl.h>
+
+// An OpenGL 3.3 core context plus whatever it presents to. Mains only talk to this interface, so
+// the same scene can run in an SDL window or offscreen on a machine without a display.
+class Context
+{
+public:
+    int width;
+    int height;
+
+    Context() : width(0), height(0) {}
+    virtual ~Context() {}
+    // create the context, make it current and load the GL functions with glad
+    virtual bool create(const char* title, int width, int height) = 0;
+    // present the finished frame
+    virtual void swap() = 0;
+    // the loader passed to glad, for fetching extension entry points later
+    virtual GLADloadproc procLoader() const = 0;
+    virtual bool headless() const = 0;
+    // the SDL window, NULL when headless
+    virtual SDL_Window* window() const { return NULL; }
+};
+
+// SDL window with a vsynced default framebuffer
+class WindowContext : public Context
+{
+public:
+    WindowContext();
+    ~WindowContext();
+    bool create(const char* title, int width, int height);
+    void swap();
+    GLADloadproc procLoader() const;
+    bool headless() const { return false; }
+    SDL_Window* window() const { return sdlWindow; }
+
+private:
+    SDL_Window* sdlWindow;
+    SDL_GLContext glContext;
+};
+
+// EGL context without a window (surfaceless on Mesa, e.g. llvmpipe, or a 1x1 pbuffer elsewhere)
+// rendering into a framebuffer object with color and depth/stencil renderbuffers
+class OffscreenContext : public Context
+{
+public:
+    OffscreenContext();
+    ~OffscreenContext();
+    bool create(const char* title, int width, int height);
+    void swap();
+    GLADloadproc procLoader() const;
+    bool headless() const { return true; }
+
+private:
+    EGLDisplay display;
+    EGLContext eglContext;
+    EGLSurface surface;
+    GLuint fbo;
+    GLuint renderbuffers[2];
+};
+
+// returns a new OffscreenContext when headless is set, otherwise a WindowContext
+Context* createContext(bool headless);
+// parses "--headless N" from the command line, frames is left alone if the flag is missing
+bool parseHeadless(int argc, char* argv[], unsigned long &frames);
+
+#endif
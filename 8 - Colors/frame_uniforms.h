@@ -0,0 +1,59 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// binding point of the PerFrame uniform block, shared by every program
+const GLuint PER_FRAME_BINDING = 0;
+
+// C++ mirror of the std140 block every vertex shader declares:
+//     layout (std140) uniform PerFrame
+//     {
+//         mat4 view;
+//         mat4 projection;
+//         mat4 viewProj;
+//         vec3 cameraPos;
+//         float time;
+//     };
+struct PerFrameUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProj;
+    glm::vec3 cameraPos;
+    float time;     // std140 packs a float into the last 4 bytes of the preceding vec3's 16-byte slot
+};
+
+// std140: mat4 is four 16-byte aligned vec4 columns, vec3 is 16-byte aligned with size 12,
+// and the block size is rounded up to a multiple of 16
+static_assert(sizeof(glm::mat4) == 64 && sizeof(glm::vec3) == 12, "glm types must be tightly packed floats");
+static_assert(offsetof(PerFrameUniforms, view) == 0, "std140 offset of view");
+static_assert(offsetof(PerFrameUniforms, projection) == 64, "std140 offset of projection");
+static_assert(offsetof(PerFrameUniforms, viewProj) == 128, "std140 offset of viewProj");
+static_assert(offsetof(PerFrameUniforms, cameraPos) == 192, "std140 offset of cameraPos");
+static_assert(offsetof(PerFrameUniforms, time) == 204, "std140 offset of time");
+static_assert(sizeof(PerFrameUniforms) == 208 && sizeof(PerFrameUniforms) % 16 == 0, "std140 size of PerFrame");
+
+// Uniform buffer holding PerFrameUniforms, bound once to PER_FRAME_BINDING. Programs pick it up through
+// Shader::bindUniformBlock("PerFrame", PER_FRAME_BINDING), so the camera is uploaded once per frame
+// no matter how many programs read it
+class FrameUniforms
+{
+public:
+    PerFrameUniforms data;
+
+    FrameUniforms();
+    // create the buffer and attach it to the binding point, needs a current context
+    void init();
+    // free the buffer, call before the context is destroyed
+    void release();
+    // fill in the camera, derive viewProj and upload everything with one glBufferSubData
+    void update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &cameraPos, float time);
+
+private:
+    GLuint ubo;
+};
+
+#endif
@@ -1,11 +1,19 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+// shared by every program, see frame_uniforms.h
+layout (std140) uniform PerFrame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec3 cameraPos;
+    float time;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = viewProj * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
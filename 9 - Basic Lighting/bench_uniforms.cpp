@@ -0,0 +1,41 @@
+// Microbenchmark for the uniform lookup paths used by the Shader setters.
+// No GL context is needed: the table is filled by hand with the uniforms of the lighting shaders.
+#include "uniforms.h"
+#include <chrono>
+#include <iostream>
+
+static const int ITERATIONS = 10000000;
+
+int main()
+{
+    UniformTable table;
+    const char* names[] = { "model", "view", "projection", "objectColor", "lightColor", "lightPos" };
+    for (int i = 0; i < 6; i++)
+        table.add(names[i], i, GL_FLOAT_MAT4, 1);
+
+    constexpr UniformId uProjection = "projection"_u;
+    volatile GLint sink = 0;
+
+    // what Shader::setMat4("projection", ...) pays: a std::string from the literal, then a lookup by name
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        sink = table.location(std::string("projection"));
+    double stringNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS;
+
+    // lookup by name without building a std::string
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        sink = table.location("projection");
+    double charNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS;
+
+    // lookup by compile-time hash
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        sink = table.location(uProjection);
+    double idNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / ITERATIONS;
+
+    std::cout << "std::string lookup: " << stringNs << " ns/call" << std::endl;
+    std::cout << "const char* lookup: " << charNs << " ns/call" << std::endl;
+    std::cout << "UniformId lookup:   " << idNs << " ns/call" << std::endl;
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <vector>
 
@@ -21,111 +22,287 @@ const float PITCH      =  0.0f;
 const float SPEED      =  2.5f;
 const float SENSITIVTY =  0.1f;
 const float ZOOM       =  45.0f;
+const float NEAR_PLANE =  0.1f;
+const float FAR_PLANE  =  100.0f;
 
+// Frustum planes in the order GetFrustumPlanes() returns them
+enum Frustum_Plane {
+    PLANE_LEFT,
+    PLANE_RIGHT,
+    PLANE_BOTTOM,
+    PLANE_TOP,
+    PLANE_NEAR,
+    PLANE_FAR
+};
+
+// dot(Normal, p) + Distance is the signed distance of p from the plane, positive on the inside of the frustum
+struct Plane
+{
+    glm::vec3 Normal;
+    float Distance;
+};
 
-// An abstract camera class that processes input and calculates the corresponding Eular Angles, Vectors and Matrices for use in OpenGL
+// A camera that keeps its orientation as a quaternion. Input only accumulates until Update(), which applies
+// it in one step, so a burst of mouse events costs a few additions instead of trigonometry per event.
+// View, projection, their product, the inverses and the frustum planes are cached and only rebuilt after
+// something they depend on changed; Version() tells callers when that happened
 class Camera
 {
 public:
-    // Camera Attributes
-    glm::vec3 Position;
-    glm::vec3 Front;
-    glm::vec3 Up;
-    glm::vec3 Right;
-    glm::vec3 WorldUp;
-    // Eular Angles
-    float Yaw;
-    float Pitch;
     // Camera options
     float MovementSpeed;
     float MouseSensitivity;
-    float Zoom;
 
     // Constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH)
+        : MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), WorldUp(up), Zoom(ZOOM), Aspect(4.0f / 3.0f), Near(NEAR_PLANE), Far(FAR_PLANE)
     {
-        Position = position;
-        WorldUp = up;
-        Yaw = yaw;
-        Pitch = pitch;
-        updateCameraVectors();
+        Place(position, yaw, pitch);
     }
     // Constructor with scalar values
-    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), Zoom(ZOOM)
+    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch)
+        : MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), WorldUp(upX, upY, upZ), Zoom(ZOOM), Aspect(4.0f / 3.0f), Near(NEAR_PLANE), Far(FAR_PLANE)
     {
-        Position = glm::vec3(posX, posY, posZ);
-        WorldUp = glm::vec3(upX, upY, upZ);
-        Yaw = yaw;
-        Pitch = pitch;
-        updateCameraVectors();
+        Place(glm::vec3(posX, posY, posZ), yaw, pitch);
     }
 
-    // Returns the view matrix calculated using Eular Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    // Moves the camera to position looking along the Euler angles, dropping any input not applied yet
+    void Place(glm::vec3 position, float yaw, float pitch)
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        // the only place angles are turned into vectors, later rotations are applied to the quaternion
+        glm::vec3 front;
+        front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
+        front.y = sin(glm::radians(Pitch));
+        front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
+        front = glm::normalize(front);
+        glm::vec3 right = glm::normalize(glm::cross(front, WorldUp));
+        glm::vec3 up = glm::cross(right, front);
+        // columns are where the camera's x, y and z axes end up, it looks down its -z
+        Orientation = glm::normalize(glm::quat_cast(glm::mat3(right, up, -front)));
+        pendingMove = glm::vec3(0.0f);
+        pendingYaw = pendingPitch = 0.0f;
+        constrainPitch = true;
+        updateCameraVectors();
+        viewDirty = true;
     }
 
     // Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
+        // gathered along the camera's own axes, x right and z forward, and turned into world space by Update()
         float velocity = MovementSpeed * deltaTime;
         if (direction == FORWARD)
-            Position += Front * velocity;
+            pendingMove.z += velocity;
         if (direction == BACKWARD)
-            Position -= Front * velocity;
+            pendingMove.z -= velocity;
         if (direction == LEFT)
-            Position -= Right * velocity;
+            pendingMove.x -= velocity;
         if (direction == RIGHT)
-            Position += Right * velocity;
+            pendingMove.x += velocity;
     }
 
     // Processes input received from a mouse input system. Expects the offset value in both the x and y direction.
     void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true)
     {
-        xoffset *= MouseSensitivity;
-        yoffset *= MouseSensitivity;
+        pendingYaw += xoffset * MouseSensitivity;
+        pendingPitch += yoffset * MouseSensitivity;
+        this->constrainPitch = constrainPitch;
+    }
 
-        Yaw   += xoffset;
-        Pitch += yoffset;
+    // Processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
+    void ProcessMouseScroll(float yoffset)
+    {
+        float zoom = glm::clamp(Zoom - yoffset, 1.0f, 45.0f);
+        if (zoom != Zoom)
+        {
+            Zoom = zoom;
+            projectionDirty = true;
+        }
+    }
 
-        // Make sure that when pitch is out of bounds, screen doesn't get flipped
-        if (constrainPitch)
+    // Applies the input gathered since the last call, once per frame before the matrices are read
+    void Update()
+    {
+        if (pendingYaw != 0.0f || pendingPitch != 0.0f)
         {
-            if (Pitch > 89.0f)
-                Pitch = 89.0f;
-            if (Pitch < -89.0f)
-                Pitch = -89.0f;
+            // Make sure that when pitch is out of bounds, screen doesn't get flipped
+            float pitch = Pitch + pendingPitch;
+            if (constrainPitch)
+                pitch = glm::clamp(pitch, -89.0f, 89.0f);
+            float yaw = pendingYaw;
+            float tilt = pitch - Pitch;
+            Yaw += yaw;
+            Pitch = pitch;
+            // yaw turns around the world's up axis and pitch around the camera's right one, so no roll creeps in
+            Orientation = glm::normalize(glm::angleAxis(glm::radians(-yaw), WorldUp) * Orientation *
+                                         glm::angleAxis(glm::radians(tilt), glm::vec3(1.0f, 0.0f, 0.0f)));
+            updateCameraVectors();
+            pendingYaw = pendingPitch = 0.0f;
+            viewDirty = true;
         }
+        if (pendingMove != glm::vec3(0.0f))
+        {
+            Position += Right * pendingMove.x + Front * pendingMove.z;
+            pendingMove = glm::vec3(0.0f);
+            viewDirty = true;
+        }
+    }
 
-        // Update Front, Right and Up Vectors using the updated Eular angles
-        updateCameraVectors();
+    // Field of view in degrees, width over height and the clip distances. Rebuilds the projection only when they change
+    void SetPerspective(float zoom, float aspect, float nearPlane = NEAR_PLANE, float farPlane = FAR_PLANE)
+    {
+        if (zoom != Zoom || aspect != Aspect || nearPlane != Near || farPlane != Far)
+        {
+            Zoom = zoom;
+            Aspect = aspect;
+            Near = nearPlane;
+            Far = farPlane;
+            projectionDirty = true;
+        }
+    }
+    void SetAspect(float aspect)
+    {
+        SetPerspective(Zoom, aspect, Near, Far);
     }
 
-    // Processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
-    void ProcessMouseScroll(float yoffset)
+    const glm::vec3& GetPosition() const { return Position; }
+    const glm::vec3& GetFront() const { return Front; }
+    const glm::vec3& GetUp() const { return Up; }
+    const glm::vec3& GetRight() const { return Right; }
+    const glm::quat& GetOrientation() const { return Orientation; }
+    float GetYaw() const { return Yaw; }
+    float GetPitch() const { return Pitch; }
+    float GetZoom() const { return Zoom; }
+    float GetAspect() const { return Aspect; }
+    float GetNear() const { return Near; }
+    float GetFar() const { return Far; }
+
+    // Returns the view matrix, rebuilt from the orientation only after the camera moved or turned
+    const glm::mat4& GetViewMatrix()
+    {
+        updateMatrices();
+        return View;
+    }
+    const glm::mat4& GetProjectionMatrix()
+    {
+        updateMatrices();
+        return Projection;
+    }
+    // projection * view
+    const glm::mat4& GetViewProjection()
+    {
+        updateMatrices();
+        return ViewProjection;
+    }
+    // the camera's world transform
+    const glm::mat4& GetInverseView()
+    {
+        updateMatrices();
+        return InverseView;
+    }
+    // clip space back to world space, for picking rays and reconstructing positions from depth
+    const glm::mat4& GetInverseViewProjection()
+    {
+        updateMatrices();
+        return InverseViewProjection;
+    }
+    // six planes indexed by Frustum_Plane, with unit normals pointing inwards
+    const Plane* GetFrustumPlanes()
     {
-        if (Zoom >= 1.0f && Zoom <= 45.0f)
-            Zoom -= yoffset;
-        if (Zoom <= 1.0f)
-            Zoom = 1.0f;
-        if (Zoom >= 45.0f)
-            Zoom = 45.0f;
+        updateMatrices();
+        return Planes;
+    }
+    // changes every time the matrices are rebuilt, cheaper to compare than the matrices themselves
+    unsigned long Version()
+    {
+        updateMatrices();
+        return version;
     }
 
 private:
-    // Calculates the front vector from the Camera's (updated) Eular Angles
+    // Camera Attributes
+    glm::vec3 Position;
+    glm::vec3 Front;
+    glm::vec3 Up;
+    glm::vec3 Right;
+    glm::vec3 WorldUp;
+    glm::quat Orientation;
+    // Eular Angles, kept for the pitch limit and for anyone who wants to read them
+    float Yaw;
+    float Pitch;
+    // Projection
+    float Zoom;
+    float Aspect;
+    float Near;
+    float Far;
+
+    // Input gathered since the last Update()
+    glm::vec3 pendingMove;
+    float pendingYaw;
+    float pendingPitch;
+    bool constrainPitch;
+
+    // Cached matrices
+    bool viewDirty = true;
+    bool projectionDirty = true;
+    unsigned long version = 0;
+    glm::mat4 View;
+    glm::mat4 Projection;
+    glm::mat4 ViewProjection;
+    glm::mat4 InverseView;
+    glm::mat4 InverseProjection;
+    glm::mat4 InverseViewProjection;
+    Plane Planes[6];
+
+    // Calculates the camera's axes from its orientation
     void updateCameraVectors()
     {
-        // Calculate the new Front vector
-        glm::vec3 front;
-        front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        front.y = sin(glm::radians(Pitch));
-        front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        Front = glm::normalize(front);
-        // Also re-calculate the Right and Up vector
-        Right = glm::normalize(glm::cross(Front, WorldUp));  // Normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
-        Up    = glm::normalize(glm::cross(Right, Front));
+        Front = Orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+        Right = Orientation * glm::vec3(1.0f, 0.0f, 0.0f);
+        Up    = Orientation * glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    void updateMatrices()
+    {
+        if (!viewDirty && !projectionDirty)
+            return;
+        if (viewDirty)
+        {
+            // a rotation and a translation invert without a general 4x4 inverse
+            glm::mat4 rotation = glm::mat4_cast(Orientation);
+            InverseView = rotation;
+            InverseView[3] = glm::vec4(Position, 1.0f);
+            View = glm::transpose(rotation);
+            View[3] = glm::vec4(-(glm::transpose(glm::mat3(rotation)) * Position), 1.0f);
+        }
+        if (projectionDirty)
+        {
+            Projection = glm::perspective(glm::radians(Zoom), Aspect, Near, Far);
+            InverseProjection = glm::inverse(Projection);
+        }
+        ViewProjection = Projection * View;
+        InverseViewProjection = InverseView * InverseProjection;
+        updateFrustumPlanes();
+        viewDirty = projectionDirty = false;
+        version++;
+    }
+
+    // Gribb and Hartmann: each plane is the last row of the view-projection matrix plus or minus one of the others
+    void updateFrustumPlanes()
+    {
+        const glm::mat4 &m = ViewProjection;
+        for (int i = 0; i < 6; i++)
+        {
+            int row = i / 2;
+            float sign = i % 2 == 0 ? 1.0f : -1.0f;
+            glm::vec4 p(m[0][3] + sign * m[0][row], m[1][3] + sign * m[1][row], m[2][3] + sign * m[2][row], m[3][3] + sign * m[3][row]);
+            float length = glm::length(glm::vec3(p));
+            Planes[i].Normal = glm::vec3(p) / length;
+            Planes[i].Distance = p.w / length;
+        }
     }
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,235 @@
+#include "context.h"
+#include <EGL/eglext.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static void* sdlProcLoader(const char* name)
+{
+    return SDL_GL_GetProcAddress(name);
+}
+
+static void* eglProcLoader(const char* name)
+{
+    return (void*)eglGetProcAddress(name);
+}
+
+static bool hasExtension(const char* extensions, const char* name)
+{
+    if (!extensions)
+        return false;
+    size_t length = std::strlen(name);
+    for (const char* p = std::strstr(extensions, name); p; p = std::strstr(p + length, name))
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+            return true;
+    return false;
+}
+
+WindowContext::WindowContext()
+    : sdlWindow(NULL), glContext(NULL)
+{
+}
+
+WindowContext::~WindowContext()
+{
+    if (glContext)
+        SDL_GL_DeleteContext(glContext);
+    if (sdlWindow)
+        SDL_DestroyWindow(sdlWindow);
+}
+
+bool WindowContext::create(const char* title, int w, int h)
+{
+    width = w;
+    height = h;
+    //Use OpenGL 3.3 core
+    SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
+    SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
+    SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
+
+    //Create window
+    sdlWindow = SDL_CreateWindow( title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, w, h, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN );
+    if( sdlWindow == NULL )
+    {
+        std::cout <<  "Window could not be created! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    //Create context
+    glContext = SDL_GL_CreateContext( sdlWindow );
+    if( glContext == NULL )
+    {
+        std::cout <<  "OpenGL context could not be created! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    // GLAD: load all OpenGL function pointers
+    if (!gladLoadGLLoader(sdlProcLoader))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    //Use Vsync
+    if( SDL_GL_SetSwapInterval(1) < 0 )
+    {
+        std::cout <<  "Warning: Unable to set VSync! SDL Error: " << SDL_GetError() << std::endl;
+    }
+    return true;
+}
+
+void WindowContext::swap()
+{
+    SDL_GL_SwapWindow(sdlWindow);
+}
+
+GLADloadproc WindowContext::procLoader() const
+{
+    return sdlProcLoader;
+}
+
+OffscreenContext::OffscreenContext()
+    : display(EGL_NO_DISPLAY), eglContext(EGL_NO_CONTEXT), surface(EGL_NO_SURFACE), fbo(0)
+{
+    renderbuffers[0] = renderbuffers[1] = 0;
+}
+
+OffscreenContext::~OffscreenContext()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+    if (fbo)
+    {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(2, renderbuffers);
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    if (eglContext != EGL_NO_CONTEXT)
+        eglDestroyContext(display, eglContext);
+    eglTerminate(display);
+}
+
+bool OffscreenContext::create(const char* title, int w, int h)
+{
+    width = w;
+    height = h;
+
+    // prefer Mesa's surfaceless platform, which needs neither X11 nor a GPU device
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        std::cout << "EGL display could not be initialized! EGL Error: " << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cout << "EGL has no desktop OpenGL support!" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0)
+    {
+        std::cout << "No suitable EGL config found!" << std::endl;
+        return false;
+    }
+
+    //Use OpenGL 3.3 core
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    eglContext = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT)
+    {
+        std::cout << "OpenGL context could not be created! EGL Error: " << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+
+    // we render into our own framebuffer, so a surface is only needed when surfaceless isn't supported
+    if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+    {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    }
+    if (!eglMakeCurrent(display, surface, surface, eglContext))
+    {
+        std::cout << "EGL context could not be made current! EGL Error: " << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+    // GLAD: load all OpenGL function pointers
+    if (!gladLoadGLLoader(eglProcLoader))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+
+    // offscreen render target the size of the window we would have opened
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Offscreen framebuffer is not complete!" << std::endl;
+        return false;
+    }
+    glViewport(0, 0, w, h);
+    std::cout << "Headless: " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << std::endl;
+    return true;
+}
+
+void OffscreenContext::swap()
+{
+    // nothing to present, so wait for the GPU to finish the frame instead. A flush alone returns as
+    // soon as the commands are queued, and headless frame times would only measure submission
+    glFinish();
+}
+
+GLADloadproc OffscreenContext::procLoader() const
+{
+    return eglProcLoader;
+}
+
+Context* createContext(bool headless)
+{
+    if (headless)
+        return new OffscreenContext();
+    return new WindowContext();
+}
+
+bool parseHeadless(int argc, char* argv[], unsigned long &frames)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--headless") == 0)
+        {
+            if (i + 1 < argc)
+                frames = std::strtoul(argv[i + 1], NULL, 10);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,32 @@
+#include "frame_uniforms.h"
+#include "glstate.h"
+
+FrameUniforms::FrameUniforms()
+    : ubo(0)
+{
+}
+
+void FrameUniforms::init()
+{
+    glGenBuffers(1, &ubo);
+    gGLState.bindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(PerFrameUniforms), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, PER_FRAME_BINDING, ubo);
+}
+
+void FrameUniforms::release()
+{
+    gGLState.deleteBuffers(1, &ubo);
+    ubo = 0;
+}
+
+void FrameUniforms::update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &cameraPos, float time)
+{
+    data.view = view;
+    data.projection = projection;
+    data.viewProj = projection * view;
+    data.cameraPos = cameraPos;
+    data.time = time;
+    gGLState.bindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PerFrameUniforms), &data);
+}
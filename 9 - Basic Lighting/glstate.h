@@ -0,0 +1,81 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+#include <iostream>
+
+// Number of issued and elided GL calls
+struct GLStateCounters
+{
+    unsigned long issued;
+    unsigned long elided;
+
+    GLStateCounters() : issued(0), elided(0) {}
+};
+
+// Shadows the bits of GL state the render loops touch and drops calls that wouldn't change anything.
+// All binds, enables and clear color changes should go through here, otherwise call invalidate()
+// after touching GL directly so the shadow copy is not trusted anymore.
+class GLState
+{
+public:
+    // texture units with a shadow copy, binds on higher units are always issued
+    static const unsigned int MAX_UNITS = 16;
+
+    // calls in the current frame and the running total of all finished frames
+    GLStateCounters frame;
+    GLStateCounters total;
+    unsigned long frames;
+
+    GLState();
+    // forget everything, the next call of each kind is always issued
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER are shadowed, other targets pass through
+    void bindBuffer(GLenum target, GLuint buffer);
+    // unit is the GL_TEXTUREi enum
+    void activeTexture(GLenum unit);
+    // binds on the given unit (0, 1, ...), switching the active unit only when the binding changes
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+    // GL_DEPTH_TEST and GL_BLEND are shadowed, other caps pass through
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void clearColor(float r, float g, float b, float a);
+
+    // delete objects and drop them from the shadow copy, so a recycled name isn't mistaken for the old binding
+    void deleteProgram(GLuint program);
+    void deleteVertexArrays(GLsizei n, const GLuint* vaos);
+    void deleteBuffers(GLsizei n, const GLuint* buffers);
+    void deleteTextures(GLsizei n, const GLuint* textures);
+
+    // fold this frame's counters into the total
+    void endFrame();
+    void printStats(std::ostream &out) const;
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    // texture targets with a shadow copy per unit
+    enum { TEX_2D, TEX_2D_ARRAY, TEX_CUBE_MAP, TEX_TARGETS };
+
+    GLuint program;
+    GLuint vao;
+    GLuint arrayBuffer;
+    GLuint elementBuffer;
+    GLenum activeUnit;
+    GLuint textures[MAX_UNITS][TEX_TARGETS];
+    int depthTest;      // -1 unknown, 0 disabled, 1 enabled
+    int blend;
+    float clear[4];
+    bool clearKnown;
+
+    bool changed(GLuint &shadow, GLuint value);
+    int* capShadow(GLenum cap);
+    static int targetIndex(GLenum target);
+};
+
+// the state tracker for the (only) GL context
+extern GLState gGLState;
+
+#endif
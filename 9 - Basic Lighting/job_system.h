@@ -0,0 +1,169 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Chase-Lev work-stealing deque of job pointers: its owner pushes and pops at the bottom, any thread
+// steals from the top. Fixed capacity, push() fails when it is full
+template <class T>
+class WorkQueue
+{
+public:
+    WorkQueue(size_t capacity) : slots(capacity), mask(capacity - 1), top(0), bottom(0) {}
+
+    // owner only
+    bool push(T* item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > (int64_t)mask)
+            return false;
+        slots[b & mask].store(item, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+    // owner only, the most recently pushed item or NULL
+    T* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        // claims the bottom item before looking at top, thieves that read bottom after this leave it alone
+        bottom.store(b, std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_seq_cst);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_release);
+            return NULL;
+        }
+        T* item = slots[b & mask].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // the last item, a thief may be taking it right now
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = NULL;
+            bottom.store(b + 1, std::memory_order_release);
+        }
+        return item;
+    }
+    // any thread, the oldest item or NULL when there is none or another thread got to it first
+    T* steal()
+    {
+        int64_t t = top.load(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_seq_cst);
+        if (t >= b)
+            return NULL;
+        T* item = slots[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return NULL;
+        return item;
+    }
+    // a snapshot, only exact on the owner's thread while nobody steals
+    size_t size() const
+    {
+        int64_t n = bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed);
+        return n > 0 ? (size_t)n : 0;
+    }
+
+private:
+    std::vector<std::atomic<T*> > slots;
+    size_t mask;
+    // each on its own cache line, thieves hammer top while the owner works the bottom
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+};
+
+struct JobStats
+{
+    uint64_t executed;      // jobs run, by any thread
+    uint64_t stolen;        // jobs taken from another thread's queue
+    uint64_t failedSteals;  // queues found empty or lost to another thief
+    uint64_t sleeps;        // times a thread found nothing to do and blocked
+
+    JobStats() : executed(0), stolen(0), failedSteals(0), sleeps(0) {}
+};
+
+// Work-stealing job scheduler. Every worker thread, and the thread that created the system, has a
+// deque: jobs a thread runs go on its own, it pops the newest from there and steals the oldest from
+// the others when it runs dry. Other threads hand their jobs in through a locked queue. A job counts
+// as finished once its work and every child created under it are done, so waiting on a parent waits
+// on the whole tree. Waiting helps: the waiting thread runs jobs until the one it waits for finishes.
+// Jobs must not touch GL, the context is only current on the main thread
+class JobSystem
+{
+public:
+    struct Job;
+
+    // threads counts the calling thread, which helps whenever it waits: threads - 1 workers are
+    // started, none for 1. threads = 0 uses every hardware thread
+    JobSystem(unsigned int threads = 0);
+    // jobs still queued are dropped, wait for them first
+    ~JobSystem();
+
+    // A job that runs work once run() has been called. The parent, when given, does not finish before
+    // it does; children may be created until the parent finishes, from inside its work or before it
+    // runs. The pointer stays valid until wait() or release() is called on it, exactly once
+    Job* create(const std::function<void()> &work, Job* parent = NULL);
+    // queues a created job
+    void run(Job* job);
+    // create(), run() and release() for jobs nobody waits on directly, children usually
+    void spawn(const std::function<void()> &work, Job* parent = NULL);
+    // blocks until the job and its children are done and releases it. With help the calling thread
+    // runs queued jobs, any of them, while it waits, and sleeps only when there are none left
+    void wait(Job* job, bool help = true);
+    void release(Job* job);
+
+    // Runs work(first, last) over ranges covering [0, count) and returns once all are done. Ranges are
+    // split in halves as long as other threads are out of work and never below grain, grain = 0
+    // picks one for the thread count. The calling thread takes part
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)> &work, size_t grain = 0);
+
+    // threads including the creating one
+    unsigned int size() const { return (unsigned int)queues.size(); }
+    unsigned int workers() const { return (unsigned int)workerThreads.size(); }
+    // summed over all threads, exact once every job is done
+    JobStats stats() const;
+
+private:
+    struct Counters
+    {
+        std::atomic<uint64_t> executed, stolen, failedSteals, sleeps;
+
+        Counters() : executed(0), stolen(0), failedSteals(0), sleeps(0) {}
+    };
+
+    // queues[0] belongs to the creating thread, queues[i] to workerThreads[i - 1]
+    std::vector<WorkQueue<Job>*> queues;
+    std::vector<Counters*> counters;
+    std::vector<std::thread> workerThreads;
+    // jobs run from threads without a queue
+    std::deque<Job*> inbox;
+    std::mutex inboxMutex;
+    std::atomic<size_t> inboxSize;
+    // sleeping threads wake when epoch moves, every run() moves it
+    std::atomic<uint64_t> epoch;
+    std::atomic<unsigned int> sleeping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::atomic<bool> stopping;
+
+    void work(unsigned int index);
+    // the calling thread's queue index in this system, or -1
+    int current() const;
+    Job* find(int index, unsigned int &victim);
+    void execute(Job* job, int index);
+    void complete(Job* job);
+    void notify();
+    void splitRange(Job* root, size_t first, size_t last, size_t grain, const std::function<void(size_t, size_t)> &work);
+
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+};
+
+#endif
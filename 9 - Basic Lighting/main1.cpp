@@ -1,6 +1,13 @@
 #include "glad/glad.h"
 #include "shader.h"
 #include "camera.h"
+#include "frameloop.h"
+#include "mesh.h"
+#include "context.h"
+#include "frame_uniforms.h"
+#include "transforms.h"
+#include "matrix_batch.h"
+#include "render_queue.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <iostream>
@@ -12,87 +19,76 @@
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-//The window we'll be rendering to
-SDL_Window* gWindow = NULL;
-
 //Camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// Timing
-float deltaTime = 0.0f;	// time between current frame and last frame
-float lastFrame = 0.0f;
-
 //Lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
-//OpenGL context
-SDL_GLContext gContext;
+//OpenGL context and the window or offscreen framebuffer it renders to
+Context* gContext = NULL;
 
-int main()
+//Uniform names, hashed at compile time
+constexpr UniformId uModel = "model"_u;
+constexpr UniformId uNormalMatrix = "normalMatrix"_u;
+constexpr UniformId uObjectColor = "objectColor"_u;
+constexpr UniformId uLightColor = "lightColor"_u;
+constexpr UniformId uLightPos = "lightPos"_u;
+
+int main(int argc, char* argv[])
 {
 	//Initialization flag
 	int success = 0;
 
-	//Initialize SDL
-	if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+	// "--headless N" renders N frames into an offscreen framebuffer and exits, for machines without a display
+	unsigned long frameLimit = 0;
+	bool headless = parseHeadless(argc, argv, frameLimit);
+	if (headless && frameLimit == 0)
+		frameLimit = 1000;
+
+	//Initialize SDL, the offscreen context only needs its timer and event queue
+	if( SDL_Init( headless ? 0 : SDL_INIT_VIDEO ) < 0 )
 	{
 		std::cout <<  "SDL could not initialize! SDL Error: " << SDL_GetError() << std::endl;
 		success = 1;
 	}
 	else
 	{
-		//Use OpenGL 3.1 core
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
-		SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
-		
-		//Create window
-		gWindow = SDL_CreateWindow( "OpenGL with SDL", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCR_WIDTH, SCR_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN );
-		if( gWindow == NULL )
-		{
-			std::cout <<  "Window could not be created! SDL Error: " << SDL_GetError() << std::endl;
+		//Create the window or offscreen context
+		gContext = createContext(headless);
+		if( !gContext->create( "OpenGL with SDL", SCR_WIDTH, SCR_HEIGHT ) )
 			success = 1;
-		}
 		else
 		{
-			//Create context
-			gContext = SDL_GL_CreateContext( gWindow );
-			if( gContext == NULL )
+			int imgFlags = IMG_INIT_JPG;
+			if( !( IMG_Init( imgFlags ) & imgFlags ) )
 			{
-				std::cout <<  "OpenGL context could not be created! SDL Error: " << SDL_GetError() << std::endl;
+				std::cout << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
 				success = 1;
 			}
-			else
-			{
-				// GLAD: load all OpenGL function pointers
-				if (!gladLoadGLLoader(SDL_GL_GetProcAddress))
-				{
-					std::cout << "Failed to initialize GLAD" << std::endl;
-					success = 1;
-				}    
-
-				//Use Vsync
-				if( SDL_GL_SetSwapInterval(1) < 0 )
-				{
-					std::cout <<  "Warning: Unable to set VSync! SDL Error: " << SDL_GetError() << std::endl;
-				}
-				int imgFlags = IMG_INIT_JPG;
-				if( !( IMG_Init( imgFlags ) & imgFlags ) )
-				{
-					std::cout << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
-					success = 1;
-				}
-			}
 		}
 	}
+	if( success )
+	{
+		delete gContext;
+		SDL_Quit();
+		return success;
+	}
 
-	glEnable(GL_DEPTH_TEST); 
+	gGLState.enable(GL_DEPTH_TEST);
 
-    Shader objShader("shaders/shader.vert", "shaders/object.frag");
-    Shader lightShader("shaders/shader.vert", "shaders/light.frag");
+	// Linked programs are cached on disk, the second launch skips compiling and linking
+	ProgramCache programCache;
+	programCache.init(gContext->procLoader());
+	Uint64 shaderStart = SDL_GetPerformanceCounter();
+    Shader objShader("shaders/shader.vert", "shaders/object.frag", &programCache);
+    Shader lightShader("shaders/shader.vert", "shaders/light.frag", &programCache);
+	double shaderMs = (SDL_GetPerformanceCounter() - shaderStart) * 1000.0 / SDL_GetPerformanceFrequency();
+	std::cout << "Shader setup: " << shaderMs << " ms (" << (programCache.hits ? "warm" : "cold") << " start, "
+		<< programCache.hits << " cached, " << programCache.misses << " compiled)" << std::endl;
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -140,116 +136,189 @@ float vertices[] = {
     -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
 };
 
-    unsigned int VBO, objVAO;
+    // weld the 36 flat vertices into an indexed mesh ordered for the post-transform vertex cache
+    Mesh cube = optimizeMesh(vertices, 36, 6);
+    GLsizei cubeIndexCount = (GLsizei)cube.indices.size();
+
+    unsigned int VBO, EBO, objVAO;
     glGenVertexArrays(1, &objVAO);
     glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(objVAO);
+    gGLState.bindVertexArray(objVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, cube.vertices.size() * sizeof(float), &cube.vertices[0], GL_STATIC_DRAW);
+    gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube.indices.size() * sizeof(unsigned int), &cube.indices[0], GL_STATIC_DRAW);
 
     // position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
+    // normal attribute
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
 
     unsigned int lightVAO;
 	glGenVertexArrays(1, &lightVAO);
-	glBindVertexArray(lightVAO);
-	// we only need to bind to the VBO, the container's VBO's data already contains the correct data.
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	gGLState.bindVertexArray(lightVAO);
+	// we only need to bind to the VBO and EBO, the container's buffers already contain the correct data.
+	gGLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+	gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	// set the vertex attributes (only position data for our lamp)
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);
 
-	bool quit = false;
-	float angle;
-	SDL_Event e;
-	while (!quit)
+	// make sure every uniform the render loop sets exists in the linked programs
+	objShader.require({ uModel, uNormalMatrix, uObjectColor, uLightColor, uLightPos });
+	lightShader.require({ uModel });
+
+	// view and projection live in a uniform buffer shared by both programs
+	FrameUniforms frameUniforms;
+	frameUniforms.init();
+	objShader.bindUniformBlock("PerFrame", PER_FRAME_BINDING);
+	lightShader.bindUniformBlock("PerFrame", PER_FRAME_BINDING);
+
+	// the object sits at the origin and the lamp is a small cube at the light, neither moves so their
+	// model matrices are computed once here instead of every frame
+	TransformHierarchy transforms;
+	uint32_t objectNode = transforms.add();
+	uint32_t lampNode = transforms.add(TransformHierarchy::NO_PARENT, lightPos, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.2f));
+	transforms.update();
+
+	// both draws go through the render queue each frame, the payload says which one it is. The keys
+	// get the object's program and vertex array 0 and the lamp's 1, both draw without textures
+	enum { DRAW_OBJECT, DRAW_LAMP };
+	RenderQueue renderQueue;
+	StateChanges addedOrder, sortedOrder;
+
+	// CPU and GPU timings of the frame, shown in the window title and written to a Chrome trace on exit
+	Profiler profiler;
+	profiler.init();
+
+	// the projection is only rebuilt when the aspect or the zoom changes
+	camera.SetAspect((float)SCR_WIDTH / (float)SCR_HEIGHT);
+
+	FrameLoop loop(*gContext);
+	loop.profiler = &profiler;
+	loop.onEvent = [&](const SDL_Event& e)
 	{
-		while( SDL_PollEvent( &e ) != 0 )
+		// A bunch of SDL events for mouse and keyboard input
+		if( e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) )
+			loop.quit();
+		if (e.type == SDL_MOUSEMOTION)
 		{
-			// Camera speed
-			float currentFrame = SDL_GetTicks()/1000.0f;
-			deltaTime = currentFrame - lastFrame;
-			lastFrame = currentFrame;  
-
-			// A bunch of SDL events for mouse and keyboard input
-			if( e.key.keysym.sym == SDLK_ESCAPE || e.type == SDL_QUIT)
-				quit = true;
-			if( e.key.keysym.sym == SDLK_w )
-				camera.ProcessKeyboard(FORWARD, deltaTime);
-			if( e.key.keysym.sym == SDLK_s )
-				camera.ProcessKeyboard(BACKWARD, deltaTime);
-			if( e.key.keysym.sym == SDLK_a )
-				camera.ProcessKeyboard(LEFT, deltaTime);
-			if( e.key.keysym.sym == SDLK_d )
-				camera.ProcessKeyboard(RIGHT, deltaTime);
-			if (e.type == SDL_MOUSEMOTION)
+			float xPos = e.motion.x;
+			float yPos = e.motion.y;
+			if(firstMouse)
 			{
-				float xPos = e.motion.x;
-				float yPos = e.motion.y;
-				if(firstMouse)
-    			{
-        			lastX = xPos;
-        			lastY = yPos;
-        			firstMouse = false;
-    			}
-				float delX = (xPos - lastX);
-				float delY = (lastY - yPos);
 				lastX = xPos;
 				lastY = yPos;
-				camera.ProcessMouseMovement(delX, delY);
+				firstMouse = false;
 			}
-			if (e.type == SDL_MOUSEWHEEL)
+			float delX = (xPos - lastX);
+			float delY = (lastY - yPos);
+			lastX = xPos;
+			lastY = yPos;
+			camera.ProcessMouseMovement(delX, delY);
+		}
+		if (e.type == SDL_MOUSEWHEEL)
+		{
+			float yPos = e.wheel.y;
+			camera.ProcessMouseScroll(yPos);
+		}
+	};
+	loop.onUpdate = [&](float deltaTime)
+	{
+		// Keys are sampled once per simulation step so camera speed doesn't depend on key repeat
+		const Uint8* keys = SDL_GetKeyboardState(NULL);
+		if( keys[SDL_SCANCODE_W] )
+			camera.ProcessKeyboard(FORWARD, deltaTime);
+		if( keys[SDL_SCANCODE_S] )
+			camera.ProcessKeyboard(BACKWARD, deltaTime);
+		if( keys[SDL_SCANCODE_A] )
+			camera.ProcessKeyboard(LEFT, deltaTime);
+		if( keys[SDL_SCANCODE_D] )
+			camera.ProcessKeyboard(RIGHT, deltaTime);
+	};
+	loop.onRender = [&](float alpha)
+	{
+		// only does work once something moved
+		transforms.update();
+		profiler.begin("clear");
+		gGLState.clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		profiler.end();
+
+		// mouse and keyboard input since the last frame is applied in one step
+		camera.Update();
+		frameUniforms.update(camera.GetViewMatrix(), camera.GetProjectionMatrix(), camera.GetPosition(), (float)loop.stats().totalSeconds);
+
+		glm::vec3 eye = camera.GetPosition();
+		renderQueue.clear();
+		renderQueue.add(RenderQueue::makeKey(0, false, 0, 0, 0, glm::length(glm::vec3(transforms.world(objectNode)[3]) - eye)), DRAW_OBJECT);
+		renderQueue.add(RenderQueue::makeKey(0, false, 1, 0, 1, glm::length(glm::vec3(transforms.world(lampNode)[3]) - eye)), DRAW_LAMP);
+		addedOrder += renderQueue.stateChanges();
+		renderQueue.sort();
+		sortedOrder += renderQueue.stateChanges();
+		for (size_t i = 0; i < renderQueue.size(); i++)
+		{
+			if (renderQueue.payload(i) == DRAW_OBJECT)
 			{
-				float yPos = e.wheel.y;
-				camera.ProcessMouseScroll(yPos);
+				profiler.begin("object");
+				objShader.use();
+				objShader.setVec3(uObjectColor, glm::vec3(1.0f, 0.5f, 0.31f));
+				objShader.setVec3(uLightColor, glm::vec3(1.0f, 1.0f, 1.0f));
+				objShader.setVec3(uLightPos, lightPos);
+
+				objShader.setMat4(uModel, transforms.world(objectNode));
+				glm::mat3 normalMatrix;
+				normalMatrices(&transforms.world(objectNode), &normalMatrix, 1);
+				objShader.setMat3(uNormalMatrix, normalMatrix);
+
+				gGLState.bindVertexArray(objVAO);
+				glDrawElements(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_INT, 0);
+				profiler.end();
 			}
+			else
+			{
+				profiler.begin("lamp");
+				lightShader.use();
+				lightShader.setMat4(uModel, transforms.world(lampNode));
 
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-			objShader.use();
-			objShader.setVec3("objectColor", glm::vec3(1.0f, 0.5f, 0.31f));
-			objShader.setVec3("lightColor",  glm::vec3(1.0f, 1.0f, 1.0f));
-			objShader.setVec3("lightPos", lightPos);
-
-			glm::mat4 viewMatrix = camera.GetViewMatrix();
-			glm::mat4 projectionMatrix = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        	objShader.setMat4("projection", projectionMatrix);
-        	objShader.setMat4("view", viewMatrix);
-
-        	glm::mat4 modelMatrix = glm::mat4();
-			objShader.setMat4("model", modelMatrix);
-
-			glBindVertexArray(objVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-
-			lightShader.use();
-			lightShader.setMat4("view", viewMatrix);
-			lightShader.setMat4("projection", projectionMatrix);
-			modelMatrix = glm::mat4();
-			modelMatrix = glm::translate(modelMatrix, lightPos);
-			modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f));
-			lightShader.setMat4("model", modelMatrix);
-
-			glBindVertexArray(lightVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-
-			SDL_GL_SwapWindow( gWindow );
-
+				gGLState.bindVertexArray(lightVAO);
+				glDrawElements(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_INT, 0);
+				profiler.end();
+			}
 		}
-	}
+		gGLState.endFrame();
+
+		// on-screen summary of where the frame time goes, refreshed twice a second
+		if (gContext->window() && loop.stats().frames % 30 == 0)
+			SDL_SetWindowTitle(gContext->window(), profiler.summary().c_str());
+	};
+	loop.run(frameLimit);
+	loop.stats().print(std::cout);
+	gGLState.printStats(std::cout);
+	double frames = loop.stats().frames ? (double)loop.stats().frames : 1.0;
+	addedOrder.print(std::cout, "Draws in the order added", frames);
+	sortedOrder.print(std::cout, "Draws sorted by key", frames);
+	profiler.flush();
+	std::cout << profiler.summary() << std::endl;
+	if (profiler.exportChromeTrace("trace.json"))
+		std::cout << "Frame trace written to trace.json" << std::endl;
+	profiler.release();
+	frameUniforms.release();
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &objVAO);
-    glDeleteVertexArrays(1, &lightVAO);
-    glDeleteBuffers(1, &VBO);
+    gGLState.deleteVertexArrays(1, &objVAO);
+    gGLState.deleteVertexArrays(1, &lightVAO);
+    gGLState.deleteBuffers(1, &VBO);
+    gGLState.deleteBuffers(1, &EBO);
 
-	SDL_DestroyWindow( gWindow );
-	gWindow = NULL;
+	delete gContext;
+	gContext = NULL;
 	IMG_Quit();
 	SDL_Quit();
 	return success;
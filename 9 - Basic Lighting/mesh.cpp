@@ -0,0 +1,292 @@
+#include "mesh.h"
+#include "job_system.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <unordered_map>
+
+// A vertex in the source array, hashed and compared by its raw bytes
+struct VertexKey
+{
+    const float* data;
+    unsigned int stride;
+
+    bool operator==(const VertexKey &other) const
+    {
+        return std::memcmp(data, other.data, stride * sizeof(float)) == 0;
+    }
+};
+
+struct VertexKeyHash
+{
+    size_t operator()(const VertexKey &key) const
+    {
+        const unsigned char* bytes = (const unsigned char*)key.data;
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < key.stride * sizeof(float); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return (size_t)hash;
+    }
+};
+
+void VertexCacheStats::print(std::ostream &out, const char* label) const
+{
+    out << label << ": ACMR " << acmr << ", ATVR " << atvr << std::endl;
+}
+
+Mesh weldVertices(const float* vertices, size_t vertexCount, unsigned int stride)
+{
+    Mesh mesh;
+    mesh.stride = stride;
+    mesh.indices.reserve(vertexCount);
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash> unique;
+    unique.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        VertexKey key = { vertices + i * stride, stride };
+        std::pair<std::unordered_map<VertexKey, unsigned int, VertexKeyHash>::iterator, bool> result =
+            unique.insert(std::make_pair(key, (unsigned int)mesh.vertexCount()));
+        if (result.second)
+            mesh.vertices.insert(mesh.vertices.end(), key.data, key.data + stride);
+        mesh.indices.push_back(result.first->second);
+    }
+    return mesh;
+}
+
+// Forsyth's scoring constants, see "Linear-Speed Vertex Cache Optimisation"
+static const int FORSYTH_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRI_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // the three vertices of the last triangle get a fixed score so the next triangle isn't biased by their order
+        if (cachePosition < 3)
+            score = LAST_TRI_SCORE;
+        else
+        {
+            const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+    // favour vertices with few triangles left so they get finished off instead of left stranded
+    score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangles adjacency, stored flat
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+        remaining[indices[i]]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    // LRU cache, with room for the three vertices pushed in before the overflow is dropped
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    long best = 0;
+    for (size_t t = 1; t < triangleCount; t++)
+        if (triangleScore[t] > triangleScore[best])
+            best = (long)t;
+    size_t scanFrom = 0;
+
+    while (best >= 0)
+    {
+        const unsigned int* tri = &indices[best * 3];
+        emitted[best] = true;
+        output.insert(output.end(), tri, tri + 3);
+
+        // move the triangle's vertices to the front of the cache and drop it from their adjacency
+        nextCache.assign(tri, tri + 3);
+        for (size_t i = 0; i < cache.size(); i++)
+            if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+                nextCache.push_back(cache[i]);
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = tri[k];
+            unsigned int* begin = &adjacency[offsets[v]];
+            unsigned int* end = begin + remaining[v];
+            *std::find(begin, end, (unsigned int)best) = *(end - 1);
+            remaining[v]--;
+        }
+
+        // update scores of everything that was or is in the cache
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            unsigned int v = nextCache[i];
+            int position = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+            cachePosition[v] = position;
+            float newScore = vertexScore(position, remaining[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+            for (unsigned int a = 0; a < remaining[v]; a++)
+                triangleScore[adjacency[offsets[v] + a]] += delta;
+        }
+        if (nextCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+
+        // the next triangle is the best one touching the cache, otherwise the next one not emitted yet
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cache.size(); i++)
+        {
+            unsigned int v = cache[i];
+            for (unsigned int a = 0; a < remaining[v]; a++)
+            {
+                unsigned int t = adjacency[offsets[v] + a];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (long)t;
+                }
+            }
+        }
+        if (best < 0)
+        {
+            // in input order, as Forsyth's reference does. Scoring everything left instead would be
+            // quadratic on meshes that keep running out of cached triangles, the scan only moves forward
+            while (scanFrom < triangleCount && emitted[scanFrom])
+                scanFrom++;
+            if (scanFrom < triangleCount)
+                best = (long)scanFrom;
+        }
+    }
+    indices.swap(output);
+}
+
+void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount, JobSystem &jobs, size_t clusterTriangles)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (jobs.workers() == 0 || clusterTriangles == 0 || triangleCount <= clusterTriangles)
+    {
+        optimizeVertexCache(indices, vertexCount);
+        return;
+    }
+    size_t clusters = (triangleCount + clusterTriangles - 1) / clusterTriangles;
+    jobs.parallelFor(clusters, [&indices, clusterTriangles](size_t first, size_t last) {
+        std::vector<unsigned int> local, globalIndex;
+        std::unordered_map<unsigned int, unsigned int> localIndex;
+        for (size_t c = first; c < last; c++)
+        {
+            size_t begin = c * clusterTriangles * 3;
+            size_t end = std::min(begin + clusterTriangles * 3, indices.size());
+            // number the cluster's vertices from 0, so its pass costs O(cluster) and not O(mesh)
+            local.assign(indices.begin() + begin, indices.begin() + end);
+            localIndex.clear();
+            globalIndex.clear();
+            for (size_t i = 0; i < local.size(); i++)
+            {
+                std::pair<std::unordered_map<unsigned int, unsigned int>::iterator, bool> result =
+                    localIndex.insert(std::make_pair(local[i], (unsigned int)globalIndex.size()));
+                if (result.second)
+                    globalIndex.push_back(local[i]);
+                local[i] = result.first->second;
+            }
+            optimizeVertexCache(local, globalIndex.size());
+            // clusters write disjoint ranges of the index buffer
+            for (size_t i = 0; i < local.size(); i++)
+                indices[begin + i] = globalIndex[local[i]];
+        }
+    }, 1);
+}
+
+void optimizeVertexFetch(Mesh &mesh)
+{
+    const unsigned int none = 0xFFFFFFFFu;
+    std::vector<unsigned int> remap(mesh.vertexCount(), none);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    unsigned int next = 0;
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+    {
+        unsigned int &index = mesh.indices[i];
+        if (remap[index] == none)
+        {
+            remap[index] = next++;
+            const float* source = &mesh.vertices[index * mesh.stride];
+            vertices.insert(vertices.end(), source, source + mesh.stride);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    if (indices.empty() || vertexCount == 0)
+        return stats;
+    // FIFO: a vertex is a hit while fewer than cacheSize misses happened since it was loaded
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    std::vector<bool> seen(vertexCount, false);
+    size_t misses = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (!seen[v] || misses - loadedAt[v] >= cacheSize)
+        {
+            seen[v] = true;
+            loadedAt[v] = misses;
+            misses++;
+        }
+    }
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / vertexCount;
+    return stats;
+}
+
+Mesh optimizeMesh(const float* vertices, size_t vertexCount, unsigned int stride, bool report, JobSystem* jobs)
+{
+    Mesh mesh = weldVertices(vertices, vertexCount, stride);
+    VertexCacheStats before = analyzeVertexCache(mesh.indices, mesh.vertexCount());
+    if (jobs)
+        optimizeVertexCache(mesh.indices, mesh.vertexCount(), *jobs);
+    else
+        optimizeVertexCache(mesh.indices, mesh.vertexCount());
+    optimizeVertexFetch(mesh);
+    if (report)
+    {
+        VertexCacheStats after = analyzeVertexCache(mesh.indices, mesh.vertexCount());
+        std::cout << "Mesh: " << vertexCount << " vertices welded to " << mesh.vertexCount() << ", " << mesh.triangleCount() << " triangles" << std::endl;
+        before.print(std::cout, "  before");
+        after.print(std::cout, "  after ");
+    }
+    return mesh;
+}
@@ -0,0 +1,49 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+class JobSystem;
+
+// Indexed triangle mesh with interleaved float vertex attributes
+struct Mesh
+{
+    std::vector<float> vertices;        // stride floats per vertex
+    std::vector<unsigned int> indices;  // three per triangle
+    unsigned int stride;
+
+    Mesh() : stride(0) {}
+    size_t vertexCount() const { return stride ? vertices.size() / stride : 0; }
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Post-transform vertex cache efficiency of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats
+{
+    float acmr;     // average cache miss ratio: transformed vertices per triangle (0.5 best, 3 worst)
+    float atvr;     // average transform to vertex ratio: transformed vertices per unique vertex (1 best)
+
+    void print(std::ostream &out, const char* label) const;
+};
+
+// Build an indexed mesh from a flat (non-indexed) triangle list, merging bitwise identical vertices
+Mesh weldVertices(const float* vertices, size_t vertexCount, unsigned int stride);
+// Reorder triangles for post-transform vertex cache hits (Forsyth's linear-speed algorithm)
+void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+// The same per cluster of clusterTriangles consecutive triangles, clusters spread over the job system's
+// threads. Each cluster starts with a cold cache, which costs a little ACMR, and clusters follow the
+// input order, so this suits meshes whose triangles are already roughly local, as exported ones are.
+// Without workers it is the single pass above
+void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount, JobSystem &jobs, size_t clusterTriangles = 16384);
+// Reorder vertices in the order they are first referenced so vertex fetch walks memory linearly.
+// Vertices that no triangle references are dropped
+void optimizeVertexFetch(Mesh &mesh);
+// Simulate a FIFO post-transform cache with cacheSize entries
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = 16);
+// Weld, then optimize for the vertex cache and for vertex fetch, printing ACMR/ATVR before and after.
+// Given a job system, the vertex cache pass runs in parallel clusters
+Mesh optimizeMesh(const float* vertices, size_t vertexCount, unsigned int stride, bool report = true, JobSystem* jobs = NULL);
+
+#endif
@@ -0,0 +1,214 @@
+#include "profiler.h"
+#include <fstream>
+#include <map>
+#include <sstream>
+
+Profiler::Profiler()
+    : current(0), maxEvents(1000000), cpuToMicros(0.0), cpuOrigin(0), gpuOrigin(0), enabled(false)
+{
+    for (int i = 0; i < FRAME_LATENCY; i++)
+    {
+        frames[i].queriesUsed = 0;
+        frames[i].lastQuery = 0;
+        frames[i].pending = false;
+    }
+}
+
+void Profiler::init()
+{
+    cpuToMicros = 1000000.0 / SDL_GetPerformanceFrequency();
+    // sample both clocks back to back, the offset lets GPU events line up with CPU events in the trace
+    glFinish();
+    cpuOrigin = SDL_GetPerformanceCounter();
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    gpuOrigin = gpuNow;
+    enabled = true;
+}
+
+void Profiler::release()
+{
+    for (int i = 0; i < FRAME_LATENCY; i++)
+    {
+        if (!frames[i].queryPool.empty())
+            glDeleteQueries((GLsizei)frames[i].queryPool.size(), &frames[i].queryPool[0]);
+        frames[i].queryPool.clear();
+        frames[i].scopes.clear();
+        frames[i].pending = false;
+    }
+    enabled = false;
+}
+
+GLuint Profiler::nextQuery(Frame &frame)
+{
+    if (frame.queriesUsed == frame.queryPool.size())
+    {
+        GLuint query;
+        glGenQueries(1, &query);
+        frame.queryPool.push_back(query);
+    }
+    return frame.queryPool[frame.queriesUsed++];
+}
+
+void Profiler::beginFrame()
+{
+    if (!enabled)
+        return;
+    Frame &frame = frames[current];
+    // this slot was last used FRAME_LATENCY frames ago, its queries should be done by now
+    if (frame.pending)
+        collect(frame);
+    frame.scopes.clear();
+    frame.queriesUsed = 0;
+    frame.lastQuery = 0;
+    frame.pending = true;
+    open.clear();
+}
+
+void Profiler::endFrame()
+{
+    if (!enabled)
+        return;
+    current = (current + 1) % FRAME_LATENCY;
+}
+
+void Profiler::flush()
+{
+    if (!enabled)
+        return;
+    glFinish();
+    // oldest frame first, so events stay in order
+    for (int i = 0; i < FRAME_LATENCY; i++)
+    {
+        Frame &frame = frames[(current + i) % FRAME_LATENCY];
+        if (frame.pending)
+            collect(frame);
+        frame.scopes.clear();
+    }
+}
+
+void Profiler::begin(const char* name)
+{
+    if (!enabled)
+        return;
+    Frame &frame = frames[current];
+    Scope scope;
+    scope.name = name;
+    scope.depth = (int)open.size();
+    scope.queries[0] = nextQuery(frame);
+    scope.queries[1] = nextQuery(frame);
+    // timestamps rather than GL_TIME_ELAPSED, which can't be nested
+    glQueryCounter(scope.queries[0], GL_TIMESTAMP);
+    frame.lastQuery = scope.queries[0];
+    scope.cpuStart = SDL_GetPerformanceCounter();
+    scope.cpuEnd = scope.cpuStart;
+    open.push_back((int)frame.scopes.size());
+    frame.scopes.push_back(scope);
+}
+
+void Profiler::end()
+{
+    if (!enabled || open.empty())
+        return;
+    Frame &frame = frames[current];
+    Scope &scope = frame.scopes[open.back()];
+    open.pop_back();
+    scope.cpuEnd = SDL_GetPerformanceCounter();
+    glQueryCounter(scope.queries[1], GL_TIMESTAMP);
+    frame.lastQuery = scope.queries[1];
+}
+
+void Profiler::collect(Frame &frame)
+{
+    frame.pending = false;
+    if (frame.scopes.empty())
+        return;
+    // queries complete in the order they were issued, so if the last one is done all of them are.
+    // That is not the end of the last scope opened: "frame" ends after the "swap" scope inside it
+    GLuint available = 0;
+    glGetQueryObjectuiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    for (size_t i = 0; i < frame.scopes.size() && events.size() < maxEvents; i++)
+    {
+        const Scope &scope = frame.scopes[i];
+        Event event;
+        event.name = scope.name;
+        event.depth = scope.depth;
+        event.cpuStart = (double)(scope.cpuStart - cpuOrigin) * cpuToMicros;
+        event.cpuDuration = (double)(scope.cpuEnd - scope.cpuStart) * cpuToMicros;
+        event.gpuStart = 0.0;
+        event.gpuDuration = -1.0;
+        if (available)
+        {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(scope.queries[0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(scope.queries[1], GL_QUERY_RESULT, &end);
+            event.gpuStart = (double)((int64_t)start - gpuOrigin) / 1000.0;
+            event.gpuDuration = (double)(end - start) / 1000.0;
+        }
+        events.push_back(event);
+    }
+}
+
+std::string Profiler::summary() const
+{
+    // average over the events of roughly the last second
+    struct Totals { double cpu, gpu; int count, gpuCount; };
+    std::map<std::string, Totals> totals;
+    std::vector<std::string> order;
+    double newest = events.empty() ? 0.0 : events.back().cpuStart;
+    for (size_t i = events.size(); i-- > 0 && newest - events[i].cpuStart < 1000000.0; )
+    {
+        const Event &event = events[i];
+        std::map<std::string, Totals>::iterator it = totals.find(event.name);
+        if (it == totals.end())
+        {
+            Totals zero = { 0.0, 0.0, 0, 0 };
+            it = totals.insert(std::make_pair(std::string(event.name), zero)).first;
+            order.insert(order.begin(), event.name);
+        }
+        it->second.cpu += event.cpuDuration;
+        it->second.count++;
+        if (event.gpuDuration >= 0.0)
+        {
+            it->second.gpu += event.gpuDuration;
+            it->second.gpuCount++;
+        }
+    }
+    std::ostringstream out;
+    out.precision(3);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const Totals &t = totals[order[i]];
+        out << (i ? " | " : "") << order[i] << " cpu " << t.cpu / t.count / 1000.0 << " gpu ";
+        if (t.gpuCount)
+            out << t.gpu / t.gpuCount / 1000.0;
+        else
+            out << "-";
+    }
+    out << " (ms)";
+    return out.str();
+}
+
+bool Profiler::exportChromeTrace(const char* path) const
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    // complete ("X") events, CPU scopes on thread 1 and GPU scopes on thread 2
+    out << "{\"traceEvents\":[" << std::endl;
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}," << std::endl;
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const Event &event = events[i];
+        out << "," << std::endl << "{\"name\":\"" << event.name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+            << event.cpuStart << ",\"dur\":" << event.cpuDuration << "}";
+        if (event.gpuDuration >= 0.0)
+            out << "," << std::endl << "{\"name\":\"" << event.name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":"
+                << event.gpuStart << ",\"dur\":" << event.gpuDuration << "}";
+    }
+    out << std::endl << "]}" << std::endl;
+    return (bool)out;
+}
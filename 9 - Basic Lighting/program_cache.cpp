@@ -0,0 +1,143 @@
+#include "program_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <sys/stat.h>
+
+// every cache file starts with this header, followed by the binary itself
+struct ProgramCacheHeader
+{
+    char magic[4];
+    uint32_t format;
+    uint32_t length;
+};
+
+static uint64_t fnv1a64(const std::string &data, uint64_t hash)
+{
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string glString(GLenum name)
+{
+    const GLubyte* str = glGetString(name);
+    return str ? std::string((const char*)str) : std::string();
+}
+
+ProgramCache::ProgramCache(const std::string &directory)
+    : hits(0), misses(0), directory(directory), enabled(false), getProgramBinary(NULL), programBinary(NULL), programParameteri(NULL)
+{
+}
+
+bool ProgramCache::init(GLADloadproc loadProc)
+{
+    enabled = false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    // an unknown enum on drivers without the extension leaves formats at 0
+    while (glGetError() != GL_NO_ERROR)
+        ;
+    getProgramBinary = (GetProgramBinaryProc)loadProc("glGetProgramBinary");
+    programBinary = (ProgramBinaryProc)loadProc("glProgramBinary");
+    programParameteri = (ProgramParameteriProc)loadProc("glProgramParameteri");
+    if (formats <= 0 || !getProgramBinary || !programBinary || !programParameteri)
+    {
+        std::cout << "Program binary cache disabled: driver exposes no program binary formats" << std::endl;
+        return false;
+    }
+    driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+    mkdir(directory.c_str(), 0755);
+    enabled = true;
+    return true;
+}
+
+std::string ProgramCache::path(const std::string &vertexCode, const std::string &fragmentCode) const
+{
+    uint64_t hash = 14695981039346656037ull;
+    hash = fnv1a64(vertexCode, hash);
+    hash = fnv1a64(std::string(1, '\0'), hash);
+    hash = fnv1a64(fragmentCode, hash);
+    hash = fnv1a64(std::string(1, '\0'), hash);
+    hash = fnv1a64(driver, hash);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    return directory + "/" + name;
+}
+
+unsigned int ProgramCache::load(const std::string &vertexCode, const std::string &fragmentCode)
+{
+    if (!enabled)
+        return 0;
+    std::string file = path(vertexCode, fragmentCode);
+    std::ifstream in(file.c_str(), std::ios::binary);
+    ProgramCacheHeader header;
+    if (!in || !in.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, "PBIN", 4) != 0)
+    {
+        misses++;
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    if (header.length == 0 || !in.read(&binary[0], header.length))
+    {
+        misses++;
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    programBinary(program, header.format, &binary[0], (GLsizei)header.length);
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        // the driver rejected the binary (e.g. it was built by an older driver), rebuild from source
+        glDeleteProgram(program);
+        std::remove(file.c_str());
+        misses++;
+        return 0;
+    }
+    hits++;
+    return program;
+}
+
+void ProgramCache::prepare(unsigned int program) const
+{
+    if (enabled)
+        programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(unsigned int program, const std::string &vertexCode, const std::string &fragmentCode)
+{
+    if (!enabled)
+        return;
+    GLint success = 0, length = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!success || length <= 0)
+        return;
+    std::vector<char> binary(length);
+    ProgramCacheHeader header;
+    std::memcpy(header.magic, "PBIN", 4);
+    GLenum format = 0;
+    GLsizei written = 0;
+    getProgramBinary(program, length, &written, &format, &binary[0]);
+    header.format = format;
+    header.length = (uint32_t)written;
+
+    // write to a temporary file first so a crash never leaves a truncated entry behind
+    std::string file = path(vertexCode, fragmentCode);
+    std::string temp = file + ".tmp";
+    std::ofstream out(temp.c_str(), std::ios::binary);
+    out.write((const char*)&header, sizeof(header));
+    out.write(&binary[0], written);
+    out.close();
+    if (out)
+        std::rename(temp.c_str(), file.c_str());
+    else
+        std::remove(temp.c_str());
+}
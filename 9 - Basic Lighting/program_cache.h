@@ -0,0 +1,51 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <string>
+#include <stdint.h>
+
+// GL_ARB_get_program_binary / GL 4.1 bits that the 3.3 glad loader doesn't provide
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH          0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS     0x87FE
+#endif
+
+// On-disk cache of linked program binaries. Entries are keyed by a hash of both shader sources and
+// the GL vendor/renderer/version strings, so a driver update or a source edit just misses the cache.
+class ProgramCache
+{
+public:
+    // number of programs loaded from / written to the cache since init()
+    unsigned int hits;
+    unsigned int misses;
+
+    ProgramCache(const std::string &directory = "shadercache");
+    // call once after the context is current, loadProc is the same loader passed to glad
+    // (e.g. SDL_GL_GetProcAddress). Returns false if the driver can't retrieve program binaries
+    bool init(GLADloadproc loadProc);
+    bool supported() const { return enabled; }
+    // returns a linked program built from the cached binary, or 0 on a miss or a rejected binary
+    unsigned int load(const std::string &vertexCode, const std::string &fragmentCode);
+    // call before glLinkProgram so the driver keeps the binary around
+    void prepare(unsigned int program) const;
+    // write the binary of a successfully linked program
+    void store(unsigned int program, const std::string &vertexCode, const std::string &fragmentCode);
+
+private:
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint, GLenum, const void*, GLsizei);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint, GLenum, GLint);
+
+    std::string directory;
+    std::string driver;     // vendor, renderer and version strings, part of every key
+    bool enabled;
+    GetProgramBinaryProc getProgramBinary;
+    ProgramBinaryProc programBinary;
+    ProgramParameteriProc programParameteri;
+
+    std::string path(const std::string &vertexCode, const std::string &fragmentCode) const;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "render_queue.h"
+#include <string.h>
+
+static const uint64_t DEPTH_MAX = (1ull << RenderQueue::DEPTH_BITS) - 1;
+// program, texture set and vertex array together, the state part of a key
+static const unsigned int STATE_BITS = RenderQueue::PROGRAM_BITS + RenderQueue::TEXTURE_BITS + RenderQueue::VAO_BITS;
+// queues up to this long are insertion sorted
+static const size_t SMALL_QUEUE = 64;
+
+// the bits of a positive float order the same way as its value, the top 26 below the sign are kept
+static uint64_t depthBits(float depth)
+{
+    if (!(depth > 0.0f))
+        return 0;
+    if (depth > 3.0e38f)
+        return DEPTH_MAX;
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits >> (31 - RenderQueue::DEPTH_BITS)) & DEPTH_MAX;
+}
+
+static uint64_t stateOf(uint64_t key)
+{
+    return RenderQueue::blended(key) ? key & ((1ull << STATE_BITS) - 1) : (key >> RenderQueue::DEPTH_BITS) & ((1ull << STATE_BITS) - 1);
+}
+
+StateChanges& StateChanges::operator+=(const StateChanges &other)
+{
+    programs += other.programs;
+    textureSets += other.textureSets;
+    vaos += other.vaos;
+    return *this;
+}
+
+void StateChanges::print(std::ostream &out, const char* label, double frames) const
+{
+    out << label << ": " << total() / frames << " state changes per frame (" << programs / frames << " programs, "
+        << textureSets / frames << " texture sets, " << vaos / frames << " vertex arrays)" << std::endl;
+}
+
+uint64_t RenderQueue::makeKey(unsigned int pass, bool blended, unsigned int program, unsigned int textureSet, unsigned int vao, float depth)
+{
+    uint64_t state = ((uint64_t)(program & ((1u << PROGRAM_BITS) - 1)) << (TEXTURE_BITS + VAO_BITS)) |
+                     ((uint64_t)(textureSet & ((1u << TEXTURE_BITS) - 1)) << VAO_BITS) |
+                     (vao & ((1u << VAO_BITS) - 1));
+    uint64_t key = (uint64_t)(pass & ((1u << PASS_BITS) - 1)) << 60;
+    if (blended)
+        return key | (1ull << 59) | ((DEPTH_MAX - depthBits(depth)) << STATE_BITS) | state;
+    return key | (state << DEPTH_BITS) | depthBits(depth);
+}
+
+unsigned int RenderQueue::program(uint64_t key)
+{
+    return (unsigned int)(stateOf(key) >> (TEXTURE_BITS + VAO_BITS));
+}
+
+unsigned int RenderQueue::textureSet(uint64_t key)
+{
+    return (unsigned int)(stateOf(key) >> VAO_BITS) & ((1u << TEXTURE_BITS) - 1);
+}
+
+unsigned int RenderQueue::vao(uint64_t key)
+{
+    return (unsigned int)stateOf(key) & ((1u << VAO_BITS) - 1);
+}
+
+void RenderQueue::clear()
+{
+    keys.clear();
+    payloads.clear();
+}
+
+void RenderQueue::reserve(size_t n)
+{
+    keys.reserve(n);
+    payloads.reserve(n);
+}
+
+void RenderQueue::add(uint64_t key, uint32_t payload)
+{
+    keys.push_back(key);
+    payloads.push_back(payload);
+}
+
+void RenderQueue::sort()
+{
+    size_t n = keys.size();
+    // a handful of draws, like most frames of the chapters, is done sooner by insertion
+    if (n <= SMALL_QUEUE)
+    {
+        for (size_t i = 1; i < n; i++)
+        {
+            uint64_t key = keys[i];
+            uint32_t payload = payloads[i];
+            size_t j = i;
+            for (; j > 0 && keys[j - 1] > key; j--)
+            {
+                keys[j] = keys[j - 1];
+                payloads[j] = payloads[j - 1];
+            }
+            keys[j] = key;
+            payloads[j] = payload;
+        }
+        return;
+    }
+    // one read of the keys counts the digits of all eight passes
+    size_t counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t k = keys[i];
+        for (int b = 0; b < 8; b++)
+            counts[b][(k >> (b * 8)) & 0xFF]++;
+    }
+    sortedKeys.resize(n);
+    sortedPayloads.resize(n);
+    for (int b = 0; b < 8; b++)
+    {
+        // a byte every key shares leaves the order as it is, depth and unused ids usually do
+        if (counts[b][(keys[0] >> (b * 8)) & 0xFF] == n)
+            continue;
+        size_t offsets[256], sum = 0;
+        for (int d = 0; d < 256; d++)
+        {
+            offsets[d] = sum;
+            sum += counts[b][d];
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t to = offsets[(keys[i] >> (b * 8)) & 0xFF]++;
+            sortedKeys[to] = keys[i];
+            sortedPayloads[to] = payloads[i];
+        }
+        keys.swap(sortedKeys);
+        payloads.swap(sortedPayloads);
+    }
+}
+
+StateChanges RenderQueue::stateChanges() const
+{
+    StateChanges changes;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        uint64_t key = keys[i], last = i ? keys[i - 1] : 0;
+        changes.programs += !i || program(key) != program(last);
+        changes.textureSets += !i || textureSet(key) != textureSet(last);
+        changes.vaos += !i || vao(key) != vao(last);
+    }
+    return changes;
+}
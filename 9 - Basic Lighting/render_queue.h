@@ -0,0 +1,67 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+
+// How often the bound program, texture set and vertex array change walking a list of draws, the
+// first draw binding all three
+struct StateChanges
+{
+    unsigned long programs;
+    unsigned long textureSets;
+    unsigned long vaos;
+
+    StateChanges() : programs(0), textureSets(0), vaos(0) {}
+    unsigned long total() const { return programs + textureSets + vaos; }
+    StateChanges& operator+=(const StateChanges &other);
+    void print(std::ostream &out, const char* label, double frames = 1.0) const;
+};
+
+// The draws of a frame as 64-bit sort keys, each with a payload index that tells the caller what to
+// draw. From the most significant bit down, opaque keys hold
+//     pass (4) | 0 | program (10) | texture set (12) | vertex array (11) | depth (26)
+// so sorting groups draws by state and runs each group front to back, and blended keys hold
+//     pass (4) | 1 | inverted depth (26) | program (10) | texture set (12) | vertex array (11)
+// so they come after the opaque ones of their pass, back to front. Programs, texture sets and vertex
+// arrays are small ids the caller hands out, not GL names. Depth is the distance from the camera,
+// only its order is kept
+class RenderQueue
+{
+public:
+    static const unsigned int PASS_BITS = 4;
+    static const unsigned int PROGRAM_BITS = 10;
+    static const unsigned int TEXTURE_BITS = 12;
+    static const unsigned int VAO_BITS = 11;
+    static const unsigned int DEPTH_BITS = 26;
+
+    static uint64_t makeKey(unsigned int pass, bool blended, unsigned int program, unsigned int textureSet, unsigned int vao, float depth);
+    static unsigned int pass(uint64_t key) { return (unsigned int)(key >> 60); }
+    static bool blended(uint64_t key) { return (key >> 59) & 1; }
+    static unsigned int program(uint64_t key);
+    static unsigned int textureSet(uint64_t key);
+    static unsigned int vao(uint64_t key);
+
+    void clear();
+    void reserve(size_t n);
+    void add(uint64_t key, uint32_t payload);
+    // LSD radix sort on the keys, a byte per pass, skipping bytes every key shares, short queues are
+    // insertion sorted. Stable, draws with equal keys stay in the order they were added
+    void sort();
+
+    size_t size() const { return keys.size(); }
+    uint64_t key(size_t i) const { return keys[i]; }
+    uint32_t payload(size_t i) const { return payloads[i]; }
+    // state changes drawing the queue in its current order
+    StateChanges stateChanges() const;
+
+private:
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> payloads;
+    // the other half of each radix pass
+    std::vector<uint64_t> sortedKeys;
+    std::vector<uint32_t> sortedPayloads;
+};
+
+#endif
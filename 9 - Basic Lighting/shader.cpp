@@ -1,6 +1,6 @@
 #include "shader.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+Shader::Shader(const char* vertexPath, const char* fragmentPath, ProgramCache* cache)
 {
         // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
@@ -30,6 +30,12 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     {
         std::cout << "Shader File not successfully read!" << std::endl;
     }
+    // a cached binary skips compiling and linking entirely
+    if (cache && (ID = cache->load(vertexCode, fragmentCode)) != 0)
+    {
+        uniforms.reflect(ID);
+        return;
+    }
     const char* vShaderCode = vertexCode.c_str();
     const char * fShaderCode = fragmentCode.c_str();
     // 2. compile shaders
@@ -50,8 +56,14 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
+    if (cache)
+        cache->prepare(ID);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    if (cache)
+        cache->store(ID, vertexCode, fragmentCode);
+    // cache every active uniform so the setters never have to query GL
+    uniforms.reflect(ID);
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -59,30 +71,110 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 
 void Shader::use() 
 { 
-    glUseProgram(ID);
+    gGLState.useProgram(ID);
+}
+
+bool Shader::bindUniformBlock(const char* name, GLuint binding) const
+{
+    GLuint index = glGetUniformBlockIndex(ID, name);
+    if (index == GL_INVALID_INDEX)
+        return false;
+    glUniformBlockBinding(ID, index, binding);
+    return true;
+}
+
+GLint Shader::uniform(const std::string &name) const
+{
+    return uniforms.location(name);
+}
+
+void Shader::setBool(GLint location, bool value) const
+{
+    glUniform1i(location, (int)value);
+}
+void Shader::setInt(GLint location, int value) const
+{
+    glUniform1i(location, value);
+}
+void Shader::setFloat(GLint location, float value) const
+{
+    glUniform1f(location, value);
+}
+
+void Shader::setMat4(GLint location, const glm::mat4 &value) const
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setMat3(GLint location, const glm::mat3 &value) const
+{
+    glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setVec3(GLint location, const glm::vec3 &value) const
+{
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+bool Shader::require(std::initializer_list<UniformId> ids) const
+{
+    return uniforms.check(ids.begin(), ids.size(), ID);
+}
+
+void Shader::setBool(UniformId id, bool value) const
+{
+    setBool(uniforms.location(id), value);
+}
+void Shader::setInt(UniformId id, int value) const
+{
+    setInt(uniforms.location(id), value);
+}
+void Shader::setFloat(UniformId id, float value) const
+{
+    setFloat(uniforms.location(id), value);
+}
+
+void Shader::setMat4(UniformId id, const glm::mat4 &value) const
+{
+    setMat4(uniforms.location(id), value);
+}
+
+void Shader::setMat3(UniformId id, const glm::mat3 &value) const
+{
+    setMat3(uniforms.location(id), value);
+}
+
+void Shader::setVec3(UniformId id, const glm::vec3 &value) const
+{
+    setVec3(uniforms.location(id), value);
 }
 
 void Shader::setBool(const std::string &name, bool value) const
 {         
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    setBool(uniforms.location(name), value); 
 }
 void Shader::setInt(const std::string &name, int value) const
 { 
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    setInt(uniforms.location(name), value); 
 }
 void Shader::setFloat(const std::string &name, float value) const
 { 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    setFloat(uniforms.location(name), value); 
 }
 
 void Shader::setMat4(const std::string &name, glm::mat4 value) const
 { 
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value)); 
+    setMat4(uniforms.location(name), value); 
+}
+
+void Shader::setMat3(const std::string &name, glm::mat3 value) const
+{ 
+    setMat3(uniforms.location(name), value); 
 }
 
 void Shader::setVec3(const std::string &name, glm::vec3 value) const
 { 
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value)); 
+    setVec3(uniforms.location(name), value); 
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
@@ -6,25 +6,52 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <initializer_list>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "uniforms.h"
+#include "program_cache.h"
+#include "glstate.h"
 
 class Shader
 {
 public:
     // the program ID
     unsigned int ID;
+    // active uniforms reflected after linking
+    UniformTable uniforms;
   
-    // constructor reads and builds the shader
-    Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
+    // constructor reads and builds the shader, loading the linked program from cache when one is given
+    Shader(const GLchar* vertexPath, const GLchar* fragmentPath, ProgramCache* cache = NULL);
     // use/activate the shader
     void use();
-    // utility uniform functions
+    // attach the named uniform block to a binding point, returns false if the program has no such block
+    bool bindUniformBlock(const char* name, GLuint binding) const;
+    // resolve a uniform handle once, -1 if the program has no such uniform
+    GLint uniform(const std::string &name) const;
+    // utility uniform functions taking a pre-resolved handle
+    void setBool(GLint location, bool value) const;
+    void setInt(GLint location, int value) const;
+    void setFloat(GLint location, float value) const;
+    void setMat4(GLint location, const glm::mat4 &value) const;
+    void setMat3(GLint location, const glm::mat3 &value) const;
+    void setVec3(GLint location, const glm::vec3 &value) const;
+    // warns about every id the linked program doesn't have, call it once after construction
+    bool require(std::initializer_list<UniformId> ids) const;
+    // utility uniform functions taking a name hashed at compile time
+    void setBool(UniformId id, bool value) const;
+    void setInt(UniformId id, int value) const;
+    void setFloat(UniformId id, float value) const;
+    void setMat4(UniformId id, const glm::mat4 &value) const;
+    void setMat3(UniformId id, const glm::mat3 &value) const;
+    void setVec3(UniformId id, const glm::vec3 &value) const;
+    // utility uniform functions looking the name up in the uniform cache
     void setBool(const std::string &name, bool value) const;  
     void setInt(const std::string &name, int value) const;   
     void setFloat(const std::string &name, float value) const;
     void setMat4(const std::string &name, glm::mat4 value) const;
+    void setMat3(const std::string &name, glm::mat3 value) const;
     void setVec3(const std::string &name, glm::vec3 value) const;
 
 private:
@@ -2,16 +2,25 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 
+// shared by every program, see frame_uniforms.h
+layout (std140) uniform PerFrame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec3 cameraPos;
+    float time;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix;	// transpose(inverse(mat3(model))), keeps normals perpendicular under scaling
 
 out vec3 FragPos;  
 out vec3 Normal;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    gl_Position = viewProj * vec4(FragPos, 1.0);
+    Normal = normalMatrix * aNormal;
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "transforms.h"
+#include "matrix_batch.h"
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+
+// the fewest nodes a parallel job gets, and the smallest level worth splitting
+static const uint32_t GRAIN = 1024;
+static const uint32_t PARALLEL_MIN = 8 * GRAIN;
+static const uint32_t CLEAN = 0xFFFFFFFF;
+// dirty nodes in a row go through the matrix kernels this many at a time
+static const uint32_t BATCH = 64;
+
+const uint32_t TransformHierarchy::NO_PARENT;
+
+TransformHierarchy::TransformHierarchy()
+    : sorted(true), shallowestDirty(CLEAN)
+{
+}
+
+void TransformHierarchy::reserve(size_t n)
+{
+    slotOf.reserve(n);
+    depthOf.reserve(n);
+    parents.reserve(n);
+    ids.reserve(n);
+    positions.reserve(n);
+    rotations.reserve(n);
+    scales.reserve(n);
+    worlds.reserve(n);
+    dirty.reserve(n);
+}
+
+uint32_t TransformHierarchy::add(uint32_t parent, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    uint32_t id = (uint32_t)slotOf.size(), slot = (uint32_t)positions.size();
+    uint32_t depth = parent == NO_PARENT ? 0 : depthOf[parent] + 1;
+    // appending keeps the depth order as long as the node is no shallower than the last one,
+    // otherwise the arrays are sorted again on the next update()
+    if (depth == levels.size())
+        levels.push_back(slot);
+    else if (depth + 1 < levels.size())
+        sorted = false;
+    slotOf.push_back(slot);
+    depthOf.push_back(depth);
+    parents.push_back(parent == NO_PARENT ? NO_PARENT : slotOf[parent]);
+    ids.push_back(id);
+    positions.push_back(position);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    worlds.push_back(glm::mat4(1.0f));
+    dirty.push_back(0);
+    markDirty(slot);
+    return id;
+}
+
+void TransformHierarchy::markDirty(uint32_t slot)
+{
+    dirty[slot] = 1;
+    shallowestDirty = std::min(shallowestDirty, depthOf[ids[slot]]);
+}
+
+void TransformHierarchy::setPosition(uint32_t id, const glm::vec3 &position)
+{
+    positions[slotOf[id]] = position;
+    markDirty(slotOf[id]);
+}
+
+void TransformHierarchy::setRotation(uint32_t id, const glm::quat &rotation)
+{
+    rotations[slotOf[id]] = rotation;
+    markDirty(slotOf[id]);
+}
+
+void TransformHierarchy::setScale(uint32_t id, const glm::vec3 &scale)
+{
+    scales[slotOf[id]] = scale;
+    markDirty(slotOf[id]);
+}
+
+void TransformHierarchy::setLocal(uint32_t id, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    uint32_t slot = slotOf[id];
+    positions[slot] = position;
+    rotations[slot] = rotation;
+    scales[slot] = scale;
+    markDirty(slot);
+}
+
+template <typename T>
+static void permute(std::vector<T> &values, const std::vector<uint32_t> &newSlot)
+{
+    std::vector<T> moved(values.size());
+    for (size_t slot = 0; slot < values.size(); slot++)
+        moved[newSlot[slot]] = values[slot];
+    values.swap(moved);
+}
+
+void TransformHierarchy::sortByDepth()
+{
+    // counting sort, nodes of the same depth keep the order they were added in
+    size_t n = positions.size();
+    uint32_t depths = 0;
+    for (size_t id = 0; id < n; id++)
+        depths = std::max(depths, depthOf[id] + 1);
+    levels.assign(depths, 0);
+    for (size_t id = 0; id < n; id++)
+        if (depthOf[id] + 1 < depths)
+            levels[depthOf[id] + 1]++;
+    for (uint32_t d = 1; d < depths; d++)
+        levels[d] += levels[d - 1];
+    std::vector<uint32_t> next(levels), newSlot(n);
+    for (size_t slot = 0; slot < n; slot++)
+        newSlot[slot] = next[depthOf[ids[slot]]]++;
+
+    for (size_t slot = 0; slot < n; slot++)
+        if (parents[slot] != NO_PARENT)
+            parents[slot] = newSlot[parents[slot]];
+    permute(parents, newSlot);
+    permute(ids, newSlot);
+    permute(positions, newSlot);
+    permute(rotations, newSlot);
+    permute(scales, newSlot);
+    permute(worlds, newSlot);
+    permute(dirty, newSlot);
+    for (size_t id = 0; id < n; id++)
+        slotOf[id] = newSlot[slotOf[id]];
+    sorted = true;
+}
+
+// sorts if needed and returns the first slot update() has to look at
+size_t TransformHierarchy::prepare()
+{
+    if (!sorted)
+        sortByDepth();
+    return shallowestDirty < levels.size() ? levels[shallowestDirty] : positions.size();
+}
+
+bool TransformHierarchy::propagateDirty(uint32_t slot)
+{
+    // the parent is on an earlier level, so its flag already says whether it moved this update
+    uint32_t parent = parents[slot];
+    if (parent != NO_PARENT && dirty[parent])
+        dirty[slot] = 1;
+    return dirty[slot] != 0;
+}
+
+size_t TransformHierarchy::updateSlots(uint32_t first, uint32_t last)
+{
+    glm::mat4 parentWorlds[BATCH];
+    size_t updated = 0;
+    uint32_t slot = first;
+    while (slot < last)
+    {
+        if (!propagateDirty(slot))
+        {
+            slot++;
+            continue;
+        }
+        uint32_t end = slot + 1;
+        while (end < last && end - slot < BATCH && propagateDirty(end))
+            end++;
+        size_t n = end - slot;
+        composeMatrices(&positions[slot], &rotations[slot], &scales[slot], &worlds[slot], n);
+        // the slots are on one level, either all roots or all with a parent
+        if (parents[slot] != NO_PARENT)
+        {
+            for (size_t i = 0; i < n; i++)
+                parentWorlds[i] = worlds[parents[slot + i]];
+            multiplyMatrices(parentWorlds, &worlds[slot], &worlds[slot], n);
+        }
+        updated += n;
+        slot = end;
+    }
+    return updated;
+}
+
+size_t TransformHierarchy::update()
+{
+    size_t first = prepare(), n = positions.size();
+    if (first == n)
+        return 0;
+    size_t updated = 0;
+    for (uint32_t d = shallowestDirty; d < levels.size(); d++)
+        updated += updateSlots(levels[d], d + 1 < levels.size() ? levels[d + 1] : (uint32_t)n);
+    // the flags were needed until every child had looked at its parent's
+    memset(&dirty[first], 0, n - first);
+    shallowestDirty = CLEAN;
+    return updated;
+}
+
+size_t TransformHierarchy::update(JobSystem &jobs)
+{
+    size_t first = prepare(), n = positions.size();
+    if (first == n)
+        return 0;
+    std::atomic<size_t> updated(0);
+    for (uint32_t d = shallowestDirty; d < levels.size(); d++)
+    {
+        uint32_t begin = levels[d], end = d + 1 < levels.size() ? levels[d + 1] : (uint32_t)n;
+        if (end - begin < PARALLEL_MIN)
+        {
+            updated += updateSlots(begin, end);
+            continue;
+        }
+        jobs.parallelFor(end - begin, [this, begin, &updated](size_t from, size_t to) {
+            updated += updateSlots(begin + (uint32_t)from, begin + (uint32_t)to);
+        }, GRAIN);
+    }
+    memset(&dirty[first], 0, n - first);
+    shallowestDirty = CLEAN;
+    return updated;
+}
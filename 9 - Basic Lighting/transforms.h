@@ -0,0 +1,71 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include "job_system.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <stdint.h>
+#include <vector>
+
+// Local position, rotation and scale of every node in a scene with the world matrices they produce.
+// Each component lives in its own array, sorted by depth in the tree so parents always come before
+// their children and one pass front to back sees every parent's world matrix before it is needed.
+// Changing a node marks it dirty; update() recomputes only dirty nodes and everything below them.
+// Nodes are named by the id add() returns, which stays the same when the arrays are reordered
+class TransformHierarchy
+{
+public:
+    static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+    TransformHierarchy();
+    void reserve(size_t n);
+    // parent must have been added before, the new node starts out dirty
+    uint32_t add(uint32_t parent = NO_PARENT, const glm::vec3 &position = glm::vec3(0.0f),
+                 const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3 &scale = glm::vec3(1.0f));
+
+    void setPosition(uint32_t id, const glm::vec3 &position);
+    void setRotation(uint32_t id, const glm::quat &rotation);
+    void setScale(uint32_t id, const glm::vec3 &scale);
+    void setLocal(uint32_t id, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+    const glm::vec3& position(uint32_t id) const { return positions[slotOf[id]]; }
+    const glm::quat& rotation(uint32_t id) const { return rotations[slotOf[id]]; }
+    const glm::vec3& scale(uint32_t id) const { return scales[slotOf[id]]; }
+    // parent world * translation * rotation * scale, as of the last update()
+    const glm::mat4& world(uint32_t id) const { return worlds[slotOf[id]]; }
+
+    // Recomputes the world matrices of dirty nodes and their descendants, returns how many
+    size_t update();
+    // The same with each level of the tree split across the job system's threads, the calling one
+    // included, levels are done one after the other. Small levels stay on the calling thread
+    size_t update(JobSystem &jobs);
+
+    size_t size() const { return slotOf.size(); }
+    unsigned int depth() const { return (unsigned int)levels.size(); }
+
+private:
+    // per id
+    std::vector<uint32_t> slotOf;
+    std::vector<uint32_t> depthOf;
+    // per slot, sorted by depth
+    std::vector<uint32_t> parents;      // parent's slot or NO_PARENT
+    std::vector<uint32_t> ids;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;
+    // the slots of depth d are [levels[d], levels[d + 1]), the last level ends at size()
+    std::vector<uint32_t> levels;
+    bool sorted;                        // every add() so far went to the deepest level
+    uint32_t shallowestDirty;           // levels above it have nothing to do, past the last when nothing is dirty
+
+    void markDirty(uint32_t slot);
+    void sortByDepth();
+    size_t prepare();
+    // flags the slot dirty when its parent is, returns whether it is
+    bool propagateDirty(uint32_t slot);
+    // slots [first, last) of one level, dirty runs composed and multiplied with the batched matrix kernels
+    size_t updateSlots(uint32_t first, uint32_t last);
+};
+
+#endif
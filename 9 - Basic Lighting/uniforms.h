@@ -0,0 +1,47 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include "uniform_id.h"
+
+// Reflected information about one active uniform of a linked program
+struct UniformInfo
+{
+    std::string name;
+    uint32_t hash;  // uniformHash(name)
+    GLint location;
+    GLenum type;
+    GLint size;     // number of array elements, 1 for non-arrays
+};
+
+// Flat name -> location cache filled once after linking, so looking a uniform up never touches GL
+class UniformTable
+{
+public:
+    // enumerate the active uniforms of a linked program with glGetActiveUniform
+    void reflect(unsigned int program);
+    // add a single entry, reflect() calls this for every active uniform. Returns false if the name's
+    // hash collides with a different uniform, in which case the entry can only be found by name
+    bool add(const std::string &name, GLint location, GLenum type, GLint size);
+    // returns the location of the named uniform, or -1 when the program doesn't have it
+    GLint location(const char* name) const;
+    GLint location(const std::string &name) const { return location(name.c_str()); }
+    // returns the location of a uniform hashed at compile time, or -1
+    GLint location(UniformId id) const;
+    // reports every id the program doesn't have, returns true if all of them are present
+    bool check(const UniformId* ids, size_t count, unsigned int program) const;
+    // returns the cached entry for the named uniform, or NULL
+    const UniformInfo* find(const char* name) const;
+    const std::vector<UniformInfo>& entries() const { return uniforms; }
+
+private:
+    // sorted by name so lookups are a binary search
+    std::vector<UniformInfo> uniforms;
+    // (hash, location) pairs sorted by hash, searched by the UniformId lookups
+    std::vector<std::pair<uint32_t, GLint> > hashes;
+};
+
+#endif